@@ -0,0 +1,549 @@
+/************************************************************************************//*!
+\file           main.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Benchmark suite comparing the ObjectAllocator against its new/delete
+                bypass across allocation patterns and configurations.
+
+                Usage: benchmark [scenario...]
+                Runs every scenario unless some are named. Each measurement reports
+                nanoseconds per operation, the growth in resident memory and the
+                pages the allocator used. On POSIX systems every measurement runs in
+                its own process so memory kept by earlier runs doesn't hide growth.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Project Headers
+#include "ObjectAllocator.h"
+#include "ConcurrentObjectAllocator.h"
+// Standard Libraries
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+using Clock = std::chrono::steady_clock;
+
+/************************************************************************************//*!
+ @brief  The outcome of a single measurement.
+*//*************************************************************************************/
+struct Result
+{
+    double      NsPerOp_;   //!< average time per operation
+    size_t      RssKiB_;    //!< growth in resident memory at the peak of the run
+    unsigned    Pages_;     //!< pages in use at the peak of the run (0=bypass)
+};
+
+/************************************************************************************//*!
+ @brief  Tracks the growth in resident memory over a run.
+*//*************************************************************************************/
+struct RssProbe
+{
+    size_t  Base_;  //!< resident memory when the run started
+    size_t  Peak_;  //!< most resident memory seen since
+
+    RssProbe();
+    void Sample();
+};
+
+/************************************************************************************//*!
+ @brief  An allocation pattern to measure.
+*//*************************************************************************************/
+struct Scenario
+{
+    const char* Name_;                      //!< name to pick the scenario by
+    const char* Description_;               //!< what the scenario does
+    Result      (*Run_)(const OAConfig&);   //!< runs the pattern with an allocator configuration
+};
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+static const size_t     OBJECT_SIZE     = 48;       // bytes per object in every scenario
+static const unsigned   POPULATION      = 65536;    // objects alive at once in the free-order scenarios
+static const unsigned   ROUNDS          = 8;        // times each free-order scenario fills and empties
+static const unsigned   OPERATIONS      = 1 << 20;  // replacements in the churn and lifetime scenarios
+static const unsigned   THREADS         = 4;        // threads in the multithreaded scenario
+static const unsigned   SEED            = 280;      // every run sees the same random choices
+
+static const char* HEADER_NAMES[] = { "hbNone", "hbBasic", "hbExtended", "hbExternal" };
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Gets the resident memory of the process.
+
+ @return The resident memory in KiB, or 0 if the system doesn't report it.
+*//*************************************************************************************/
+static size_t residentKiB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.WorkingSetSize / 1024;
+#else
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm == nullptr)
+        return 0;
+
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    const int read = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+
+    return read == 2 ? resident * (static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024) : 0;
+#endif
+}
+
+/************************************************************************************//*!
+ @brief  Starts tracking from the resident memory now.
+*//*************************************************************************************/
+RssProbe::RssProbe()
+: Base_ (residentKiB())
+, Peak_ (Base_)
+{}
+
+/************************************************************************************//*!
+ @brief  Records the resident memory now if it is the most so far. Only called at the
+         peaks of a run, never in the timed loops.
+*//*************************************************************************************/
+void RssProbe::Sample()
+{
+    Peak_ = std::max(Peak_, residentKiB());
+}
+
+/************************************************************************************//*!
+ @brief  Gets the average time per operation.
+
+ @param  start
+    When the timed part began.
+ @param  end
+    When the timed part ended.
+ @param  operations
+    The number of operations timed.
+
+ @return The nanoseconds per operation.
+*//*************************************************************************************/
+static double nsPerOp(Clock::time_point start, Clock::time_point end, double operations)
+{
+    return std::chrono::duration<double, std::nano>(end - start).count() / operations;
+}
+
+/************************************************************************************//*!
+ @brief  Frees the objects of a fill in a given order, the same way in every round.
+
+ @param  config
+    The configuration of the allocator.
+ @param  order
+    The order to free the objects in, as indices into the fill.
+
+ @return Nanoseconds per Allocate or Free.
+*//*************************************************************************************/
+static Result runFreeOrder(const OAConfig& config, const std::vector<unsigned>& order)
+{
+    RssProbe probe;
+    ObjectAllocator oa { OBJECT_SIZE, config };
+    std::vector<void*> objects(POPULATION);
+    unsigned pages = 0;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned round = 0; round < ROUNDS; ++round)
+    {
+        for (void*& obj : objects)
+        {
+            obj = oa.Allocate();
+        }
+
+        if (round == 0)
+        {
+            probe.Sample();
+            pages = oa.GetStats().PagesInUse_;
+        }
+
+        for (unsigned index : order)
+        {
+            oa.Free(objects[index]);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return Result{ nsPerOp(start, end, 2.0 * ROUNDS * POPULATION), probe.Peak_ - probe.Base_, pages };
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Scenarios                                                                           */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Keeps a steady population and replaces a random object at every step.
+
+ @param  config
+    The configuration of the allocator.
+
+ @return Nanoseconds per Free and Allocate pair.
+*//*************************************************************************************/
+static Result runChurn(const OAConfig& config)
+{
+    static const unsigned LIVE = 4096;
+
+    std::mt19937 rng { SEED };
+    std::vector<unsigned> picks(OPERATIONS);
+    for (unsigned& pick : picks)
+    {
+        pick = rng() % LIVE;
+    }
+
+    RssProbe probe;
+    ObjectAllocator oa { OBJECT_SIZE, config };
+    std::vector<void*> live(LIVE);
+    for (void*& obj : live)
+    {
+        obj = oa.Allocate();
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned pick : picks)
+    {
+        oa.Free(live[pick]);
+        live[pick] = oa.Allocate();
+    }
+    const Clock::time_point end = Clock::now();
+
+    probe.Sample();
+    const Result result { nsPerOp(start, end, OPERATIONS), probe.Peak_ - probe.Base_, oa.GetStats().PagesInUse_ };
+
+    for (void* obj : live)
+    {
+        oa.Free(obj);
+    }
+    return result;
+}
+
+/************************************************************************************//*!
+ @brief  Fills and frees newest first.
+*//*************************************************************************************/
+static Result runLIFO(const OAConfig& config)
+{
+    std::vector<unsigned> order(POPULATION);
+    for (unsigned i = 0; i < POPULATION; ++i)
+    {
+        order[i] = POPULATION - 1 - i;
+    }
+    return runFreeOrder(config, order);
+}
+
+/************************************************************************************//*!
+ @brief  Fills and frees oldest first.
+*//*************************************************************************************/
+static Result runFIFO(const OAConfig& config)
+{
+    std::vector<unsigned> order(POPULATION);
+    for (unsigned i = 0; i < POPULATION; ++i)
+    {
+        order[i] = i;
+    }
+    return runFreeOrder(config, order);
+}
+
+/************************************************************************************//*!
+ @brief  Fills and frees in a random order.
+*//*************************************************************************************/
+static Result runRandom(const OAConfig& config)
+{
+    std::vector<unsigned> order(POPULATION);
+    for (unsigned i = 0; i < POPULATION; ++i)
+    {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937{ SEED });
+    return runFreeOrder(config, order);
+}
+
+/************************************************************************************//*!
+ @brief  Most objects die a few steps after they are born, while one in ten lives
+         until a random later step replaces it, which scatters the survivors across
+         pages.
+
+ @param  config
+    The configuration of the allocator.
+
+ @return Nanoseconds per step, each a Free and an Allocate once warmed up.
+*//*************************************************************************************/
+static Result runLifetimes(const OAConfig& config)
+{
+    static const unsigned SHORT_LIVED   = 64;
+    static const unsigned LONG_LIVED    = 16384;
+
+    // Below LONG_LIVED picks a long-lived slot, otherwise the step is short-lived
+    std::mt19937 rng { SEED };
+    std::vector<unsigned> picks(OPERATIONS);
+    for (unsigned& pick : picks)
+    {
+        pick = rng() % (LONG_LIVED * 10);
+    }
+
+    RssProbe probe;
+    ObjectAllocator oa { OBJECT_SIZE, config };
+    std::vector<void*> shortLived(SHORT_LIVED, nullptr);
+    std::vector<void*> longLived(LONG_LIVED, nullptr);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned step = 0; step < OPERATIONS; ++step)
+    {
+        void*& slot = picks[step] < LONG_LIVED ? longLived[picks[step]] : shortLived[step % SHORT_LIVED];
+        if (slot)
+        {
+            oa.Free(slot);
+        }
+        slot = oa.Allocate();
+    }
+    const Clock::time_point end = Clock::now();
+
+    probe.Sample();
+    const Result result { nsPerOp(start, end, OPERATIONS), probe.Peak_ - probe.Base_, oa.GetStats().PagesInUse_ };
+
+    for (void* obj : shortLived)
+    {
+        oa.Free(obj);
+    }
+    for (void* obj : longLived)
+    {
+        if (obj)
+            oa.Free(obj);
+    }
+    return result;
+}
+
+/************************************************************************************//*!
+ @brief  Several threads churn their own populations at once. Pools share one
+         ConcurrentObjectAllocator, while the bypass gives every thread its own
+         allocator, as new and delete need no locking.
+
+ @param  config
+    The configuration of the allocator.
+
+ @return Nanoseconds per Free and Allocate pair, over all threads together.
+*//*************************************************************************************/
+static Result runThreads(const OAConfig& config)
+{
+    static const unsigned LIVE = 1024;
+
+    RssProbe probe;
+    ConcurrentObjectAllocator concurrent { OBJECT_SIZE, config };
+
+    auto churn = [](auto& oa, unsigned thread)
+    {
+        std::mt19937 rng { SEED + thread };
+        std::vector<void*> live(LIVE);
+        for (void*& obj : live)
+        {
+            obj = oa.Allocate();
+        }
+        for (unsigned i = 0; i < OPERATIONS / THREADS; ++i)
+        {
+            void*& slot = live[rng() % LIVE];
+            oa.Free(slot);
+            slot = oa.Allocate();
+        }
+        for (void* obj : live)
+        {
+            oa.Free(obj);
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned t = 0; t < THREADS; ++t)
+    {
+        workers.emplace_back([&, t]()
+        {
+            if (config.UseCPPMemManager_)
+            {
+                ObjectAllocator own { OBJECT_SIZE, config };
+                churn(own, t);
+            }
+            else
+            {
+                churn(concurrent, t);
+                concurrent.Flush();
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    const Clock::time_point end = Clock::now();
+
+    probe.Sample();
+    return Result{ nsPerOp(start, end, OPERATIONS), probe.Peak_ - probe.Base_, concurrent.GetStats().PagesInUse_ };
+}
+
+static const Scenario SCENARIOS[] =
+{
+    { "churn",      "replace a random object of 4096, 1M times (ns per pair)",              runChurn },
+    { "lifo",       "fill 64K objects and free newest first, 8 rounds (ns per op)",         runLIFO },
+    { "fifo",       "fill 64K objects and free oldest first, 8 rounds (ns per op)",         runFIFO },
+    { "random",     "fill 64K objects and free in random order, 8 rounds (ns per op)",      runRandom },
+    { "lifetimes",  "1M steps, 9 in 10 objects short-lived, the rest long-lived (ns per step)", runLifetimes },
+    { "threads",    "4 threads replacing random objects of 1024 each (ns per pair)",        runThreads },
+};
+
+/************************************************************************************//*!
+ @brief  Runs a measurement in a process of its own where the system allows it, so the
+         resident memory it reports isn't affected by earlier runs.
+
+ @param  run
+    The scenario to run.
+ @param  config
+    The configuration of the allocator.
+
+ @return The result of the run. NsPerOp_ is negative if the run failed.
+*//*************************************************************************************/
+static Result runIsolated(Result (*run)(const OAConfig&), const OAConfig& config)
+{
+    const Result failed { -1.0, 0, 0 };
+
+#ifdef _WIN32
+    try
+    {
+        return run(config);
+    }
+    catch(const OAException&)
+    {
+        return failed;
+    }
+#else
+    int fds[2];
+    if (pipe(fds) != 0)
+        return run(config);
+
+    const pid_t child = fork();
+    if (child < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return run(config);
+    }
+
+    if (child == 0)
+    {
+        close(fds[0]);
+        try
+        {
+            const Result result = run(config);
+            const ssize_t written = write(fds[1], &result, sizeof(result));
+            _exit(written == sizeof(result) ? 0 : 1);
+        }
+        catch(const OAException&)
+        {
+            _exit(1);
+        }
+    }
+
+    close(fds[1]);
+    Result result = failed;
+    if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+    {
+        result = failed;
+    }
+    close(fds[0]);
+    waitpid(child, nullptr, 0);
+    return result;
+#endif
+}
+
+/************************************************************************************//*!
+ @brief  Prints a row of results.
+
+ @param  name
+    The configuration the row is for.
+ @param  result
+    The result of the run.
+*//*************************************************************************************/
+static void printRow(const std::string& name, const Result& result)
+{
+    std::cout << "  " << std::left << std::setw(36) << name << std::right << ": ";
+    if (result.NsPerOp_ < 0.0)
+    {
+        std::cout << "failed" << std::endl;
+        return;
+    }
+
+    std::cout << std::setw(9) << result.NsPerOp_ << " ns" << std::setw(10) << result.RssKiB_ << " KiB";
+    if (result.Pages_)
+    {
+        std::cout << std::setw(8) << result.Pages_ << " pages";
+    }
+    std::cout << std::endl;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Main                                                                                */
+/*-------------------------------------------------------------------------------------*/
+int main(int argc, char* argv[])
+{
+    static const unsigned PAGE_OBJECTS[]    = { 64, 1024 };
+    static const unsigned PAD_BYTES[]       = { 0, 8 };
+    static const unsigned ALIGNMENTS[]      = { 0, 16 };
+
+    std::cout << std::fixed << std::setprecision(1);
+
+    for (const Scenario& scenario : SCENARIOS)
+    {
+        bool picked = argc < 2;
+        for (int i = 1; i < argc; ++i)
+        {
+            picked = picked || strcmp(argv[i], scenario.Name_) == 0;
+        }
+        if (!picked)
+            continue;
+
+        std::cout << scenario.Name_ << ": " << scenario.Description_ << std::endl;
+        printRow("new/delete", runIsolated(scenario.Run_, OAConfig{ true }));
+
+        for (unsigned objects : PAGE_OBJECTS)
+        {
+            for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+            {
+                for (unsigned pad : PAD_BYTES)
+                {
+                    for (unsigned alignment : ALIGNMENTS)
+                    {
+                        // Extended headers carry two user-defined bytes
+                        const OAConfig::HeaderBlockInfo header { static_cast<OAConfig::HBLOCK_TYPE>(type), type == OAConfig::hbExtended ? 2u : 0u };
+                        const OAConfig config { false, objects, 0, false, pad, header, alignment };
+
+                        std::ostringstream name;
+                        name << objects << "/page " << HEADER_NAMES[type] << " pad " << pad << " align " << alignment;
+                        printRow(name.str(), runIsolated(scenario.Run_, config));
+                    }
+                }
+            }
+        }
+    }
+}
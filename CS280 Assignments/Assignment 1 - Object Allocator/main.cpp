@@ -1,5 +1,1496 @@
+/************************************************************************************//*!
+\file           main.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Driver for micro-benchmarks of the ObjectAllocator. Checks that the
+                debugging and storage modes behave first, and exits with a failure if
+                any of them doesn't.
 
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "src/ObjectAllocator.h"
+#include "src/ConcurrentObjectAllocator.h"
+#include "src/TypedObjectAllocator.h"
+#include "src/PageProvider.h"
+#include "src/SlabAllocator.h"
+#include "src/SlabResource.h"
+#include "src/PersistentObjectAllocator.h"
+#include "src/HandleAllocator.h"
+// Standard Libraries
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <list>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#ifndef _WIN32
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+using Clock = std::chrono::steady_clock;
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Measures the average latency of a debug-mode Free when the free list already
+         holds a given number of blocks.
+
+ @param  freeBlocks
+    The number of blocks sitting on the free list while timing.
+ @param  config
+    The configuration of the allocator. Debugging is always turned on.
+
+ @return The average number of nanoseconds per Free.
+*//*************************************************************************************/
+double BenchDebugFree(unsigned freeBlocks, OAConfig config)
+{
+    static const unsigned TIMED_FREES = 1024;
+
+    config.DebugOn_ = true;
+    ObjectAllocator oa { 32, config };
+
+    std::vector<void*> objects;
+    objects.reserve(freeBlocks + TIMED_FREES);
+    for (unsigned i = 0; i < freeBlocks + TIMED_FREES; ++i)
+    {
+        objects.emplace_back(oa.Allocate());
+    }
+
+    // Fill the free list before timing
+    for (unsigned i = 0; i < freeBlocks; ++i)
+    {
+        oa.Free(objects[i]);
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned i = freeBlocks; i < freeBlocks + TIMED_FREES; ++i)
+    {
+        oa.Free(objects[i]);
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / TIMED_FREES;
+}
+
+/************************************************************************************//*!
+ @brief  Measures allocating and freeing a tick's worth of objects, either one at a time
+         or through the batch functions.
+
+ @param  batched
+    Whether to use AllocateBatch and FreeBatch.
+ @param  config
+    The configuration of the allocator.
+
+ @return The average number of nanoseconds per object.
+*//*************************************************************************************/
+double BenchBatch(bool batched, const OAConfig& config)
+{
+    static const unsigned TICKS         = 200;
+    static const unsigned PER_TICK      = 4096;
+
+    ObjectAllocator oa { 32, config };
+    std::vector<void*> objects(PER_TICK);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < TICKS; ++tick)
+    {
+        if (batched)
+        {
+            oa.AllocateBatch(PER_TICK, objects.data());
+            oa.FreeBatch(objects.data(), PER_TICK);
+            continue;
+        }
+
+        for (void*& obj : objects)
+        {
+            obj = oa.Allocate();
+        }
+        for (void* obj : objects)
+        {
+            oa.Free(obj);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (TICKS * PER_TICK);
+}
+
+/************************************************************************************//*!
+ @brief  Measures allocating and freeing a tick's worth of objects with any allocator
+         that has Allocate and Free.
+
+ @param  oa
+    The allocator to measure.
+
+ @return The average number of nanoseconds per object.
+*//*************************************************************************************/
+template <typename Allocator>
+double BenchAllocateFree(Allocator& oa)
+{
+    static const unsigned TICKS         = 200;
+    static const unsigned PER_TICK      = 4096;
+
+    std::vector<void*> objects(PER_TICK);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < TICKS; ++tick)
+    {
+        for (void*& obj : objects)
+        {
+            obj = oa.Allocate();
+        }
+        for (void* obj : objects)
+        {
+            oa.Free(obj);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (TICKS * PER_TICK);
+}
+
+/************************************************************************************//*!
+ @brief  Measures walking every page of a debug allocator with ValidatePages.
+
+ @param  provider
+    Where the pages come from. nullptr uses operator new.
+
+ @return The average number of microseconds per walk.
+*//*************************************************************************************/
+double BenchPageWalk(PageProvider* provider)
+{
+    static const unsigned PAGES = 4096;
+    static const unsigned WALKS = 20;
+
+    OAConfig config { false, 64, 0, true, 2, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic } };
+    config.PageProvider_ = provider;
+    ObjectAllocator oa { 48, config };
+
+    std::vector<void*> objects(PAGES * config.ObjectsPerPage_);
+    for (void*& obj : objects)
+    {
+        obj = oa.Allocate();
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned walk = 0; walk < WALKS; ++walk)
+    {
+        oa.ValidatePages([](const void*, size_t) {});
+    }
+    const Clock::time_point end = Clock::now();
+
+    for (void* obj : objects)
+    {
+        oa.Free(obj);
+    }
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / WALKS;
+}
+
+/************************************************************************************//*!
+ @brief  Measures ValidatePages over a debug allocator with half of its blocks freed.
+
+ @param  padBytes
+    The number of pad bytes on each side of a block.
+ @param  checkFreed
+    Whether the freed blocks are validated too.
+ @param  threads
+    The number of threads for ValidatePagesParallel. 0 uses ValidatePages. Defaults
+    to 0.
+
+ @return The average number of microseconds per walk.
+*//*************************************************************************************/
+double BenchValidate(unsigned padBytes, bool checkFreed, unsigned threads = 0)
+{
+    static const unsigned PAGES = 1024;
+    static const unsigned WALKS = 20;
+
+    const OAConfig config { false, 64, 0, true, padBytes, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic } };
+    ObjectAllocator oa { 128, config };
+
+    std::vector<void*> objects(PAGES * config.ObjectsPerPage_);
+    for (void*& obj : objects)
+    {
+        obj = oa.Allocate();
+    }
+    for (size_t i = 0; i < objects.size(); i += 2)
+    {
+        oa.Free(objects[i]);
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned walk = 0; walk < WALKS; ++walk)
+    {
+        if (threads)
+        {
+            oa.ValidatePagesParallel([](const void*, size_t) {}, checkFreed, threads);
+        }
+        else
+        {
+            oa.ValidatePages([](const void*, size_t) {}, checkFreed);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    for (size_t i = 1; i < objects.size(); i += 2)
+    {
+        oa.Free(objects[i]);
+    }
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / WALKS;
+}
+
+/************************************************************************************//*!
+ @brief  Measures allocating and freeing objects of mixed small sizes.
+
+ @param  allocate
+    Allocates a number of bytes.
+ @param  free
+    Frees what allocate returned.
+
+ @return The average number of nanoseconds per object.
+*//*************************************************************************************/
+template <typename AllocateFn, typename FreeFn>
+double BenchMixedSizes(AllocateFn allocate, FreeFn free)
+{
+    static const unsigned TICKS         = 200;
+    static const unsigned PER_TICK      = 4096;
+
+    std::vector<void*> objects(PER_TICK);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < TICKS; ++tick)
+    {
+        for (unsigned i = 0; i < PER_TICK; ++i)
+        {
+            // Cheap spread of sizes from 8 to 512 bytes
+            objects[i] = allocate(8 + (i * 2654435761u >> 8) % 505);
+        }
+        for (void* obj : objects)
+        {
+            free(obj);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (TICKS * PER_TICK);
+}
+
+/************************************************************************************//*!
+ @brief  Measures the latency of each of the first allocations from a new allocator,
+         where pages are created as they are needed or reserved up front.
+
+ @param  config
+    The configuration of the allocator.
+ @param  reserve
+    Whether to Reserve every object before timing.
+ @param  mean
+    Receives the average allocation in nanoseconds.
+
+ @return The 99.9th percentile in nanoseconds.
+*//*************************************************************************************/
+double BenchFirstTouch(const OAConfig& config, bool reserve, double& mean)
+{
+    static const unsigned OBJECTS       = 65536;
+
+    ObjectAllocator oa { 64, config };
+    if (reserve)
+    {
+        oa.Reserve(OBJECTS);
+    }
+
+    std::vector<double> times(OBJECTS);
+    for (unsigned i = 0; i < OBJECTS; ++i)
+    {
+        const Clock::time_point start = Clock::now();
+        void* obj = oa.Allocate();
+        times[i] = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        // The client writes its object, which faults in memory that wasn't touched yet
+        static_cast<unsigned char*>(obj)[0] = 0;
+    }
+
+    mean = 0.0;
+    for (double time : times)
+    {
+        mean += time / OBJECTS;
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[OBJECTS - OBJECTS / 1000];
+}
+
+/************************************************************************************//*!
+ @brief  Measures filling an allocator with a large population and emptying it again.
+
+ @param  config
+    The configuration of the allocator.
+ @param  pages
+    Receives the number of pages needed for the population.
+
+ @return The average number of nanoseconds per object.
+*//*************************************************************************************/
+double BenchPopulation(const OAConfig& config, unsigned& pages)
+{
+    static const unsigned POPULATION = 1 << 20;
+
+    ObjectAllocator oa { 32, config };
+    std::vector<void*> objects(POPULATION);
+
+    const Clock::time_point start = Clock::now();
+    for (void*& obj : objects)
+    {
+        obj = oa.Allocate();
+    }
+    pages = oa.GetStats().PagesInUse_;
+    for (void* obj : objects)
+    {
+        oa.Free(obj);
+    }
+    oa.FreeEmptyPages();
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / POPULATION;
+}
+
+/************************************************************************************//*!
+ @brief  Measures allocating labelled objects and freeing them.
+
+ @param  config
+    The configuration of the allocator.
+
+ @return The average number of nanoseconds per object.
+*//*************************************************************************************/
+double BenchLabelled(const OAConfig& config)
+{
+    static const unsigned TICKS         = 200;
+    static const unsigned PER_TICK      = 4096;
+    static const char* LABELS[]         = { "Particle", "Projectile", "Enemy", "Pickup" };
+
+    ObjectAllocator oa { 32, config };
+    std::vector<void*> objects(PER_TICK);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < TICKS; ++tick)
+    {
+        for (unsigned i = 0; i < PER_TICK; ++i)
+        {
+            objects[i] = oa.Allocate(LABELS[i % 4]);
+        }
+        for (void* obj : objects)
+        {
+            oa.Free(obj);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (TICKS * PER_TICK);
+}
+
+/************************************************************************************//*!
+ @brief  Measures inserting keys into a map and erasing them again.
+
+ @param  map
+    The empty map to fill. It is empty again afterwards.
+
+ @return The average number of nanoseconds per insert and erase.
+*//*************************************************************************************/
+template <typename Map>
+double BenchMap(Map& map)
+{
+    static const unsigned ROUNDS        = 50;
+    static const unsigned KEYS          = 16384;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned round = 0; round < ROUNDS; ++round)
+    {
+        // Scatter the keys so nodes are freed in a different order to allocation
+        for (unsigned i = 0; i < KEYS; ++i)
+        {
+            map.emplace((i * 7919u) % KEYS, i);
+        }
+        for (unsigned i = 0; i < KEYS; ++i)
+        {
+            map.erase(i);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (ROUNDS * KEYS);
+}
+
+/************************************************************************************//*!
+ @brief  Measures appending to a list, erasing every other node and clearing it.
+
+ @param  list
+    The empty list to fill. It is empty again afterwards.
+
+ @return The average number of nanoseconds per node.
+*//*************************************************************************************/
+template <typename List>
+double BenchList(List& list)
+{
+    static const unsigned ROUNDS        = 50;
+    static const unsigned NODES         = 16384;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned round = 0; round < ROUNDS; ++round)
+    {
+        for (unsigned i = 0; i < NODES; ++i)
+        {
+            list.push_back(i);
+        }
+        for (auto it = list.begin(); it != list.end() && ++it != list.end(); )
+        {
+            it = list.erase(it);
+        }
+        list.clear();
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (ROUNDS * NODES);
+}
+
+/************************************************************************************//*!
+ @brief  Measures bursts of allocations where the empty pages are freed after every
+         tick on the allocating thread, or by the background reclaimer.
+
+ @param  background
+    Whether to use the reclaimer instead of FreeEmptyPages.
+ @param  pages
+    Receives the number of pages left once the reclaimer has caught up.
+
+ @return The average number of nanoseconds per object, including FreeEmptyPages.
+*//*************************************************************************************/
+double BenchReclaim(bool background, unsigned& pages)
+{
+    static const unsigned TICKS         = 400;
+    static const unsigned BURST         = 16384;
+    static const unsigned QUIET         = 512;
+
+    ConcurrentObjectAllocator oa { 32, OAConfig{ false, 256, 0 } };
+    if (background)
+    {
+        oa.StartReclaimer(BURST, std::chrono::milliseconds(5));
+    }
+
+    std::vector<void*> objects(BURST);
+    unsigned long long total = 0;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned tick = 0; tick < TICKS; ++tick)
+    {
+        // Every fourth tick is a burst
+        const unsigned count = tick % 4 ? QUIET : BURST;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            objects[i] = oa.Allocate();
+        }
+        for (unsigned i = 0; i < count; ++i)
+        {
+            oa.Free(objects[i]);
+        }
+        oa.Flush();
+        total += count;
+
+        if (!background)
+        {
+            oa.FreeEmptyPages();
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    oa.StopReclaimer();
+    pages = oa.GetStats().PagesInUse_;
+    return std::chrono::duration<double, std::nano>(end - start).count() / total;
+}
+
+/************************************************************************************//*!
+ @brief  Measures a pool of 4-byte ids, allocated and then freed in a shuffled order.
+
+ @param  config
+    The configuration of the allocator.
+ @param  bytes
+    Receives the bytes of page taken by each id.
+
+ @return The average number of nanoseconds per Allocate/Free pair.
+*//*************************************************************************************/
+double BenchTinyObjects(const OAConfig& config, double& bytes)
+{
+    static const unsigned ROUNDS    = 20;
+    static const unsigned IDS       = 1u << 18;
+
+    ObjectAllocator oa { sizeof(uint32_t), config };
+    std::vector<void*> objects(IDS);
+
+    // A fixed shuffle so every run frees in the same order
+    std::vector<unsigned> order(IDS);
+    for (unsigned i = 0; i < IDS; ++i)
+    {
+        order[i] = i;
+    }
+    uint32_t state = 12345;
+    for (unsigned i = IDS - 1; i > 0; --i)
+    {
+        state = state * 1664525u + 1013904223u;
+        std::swap(order[i], order[state % (i + 1)]);
+    }
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned round = 0; round < ROUNDS; ++round)
+    {
+        for (void*& obj : objects)
+        {
+            obj = oa.Allocate();
+        }
+        for (unsigned i : order)
+        {
+            oa.Free(objects[i]);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    const OAStats stats = oa.GetStats();
+    bytes = static_cast<double>(stats.PagesInUse_) * stats.PageSize_ / IDS;
+    return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(ROUNDS) * IDS);
+}
+
+/************************************************************************************//*!
+ @brief  Measures a frame that allocates a number of objects and then releases every one
+         of them, either with a Free for each or with ReleaseAll.
+
+ @param  config
+    The configuration of the allocator.
+ @param  bulk
+    Whether to release the objects with ReleaseAll.
+
+ @return The average number of nanoseconds per object, for allocating and releasing.
+*//*************************************************************************************/
+double BenchFrameRelease(const OAConfig& config, bool bulk)
+{
+    static const unsigned FRAMES    = 200;
+    static const unsigned OBJECTS   = 65536;
+
+    ObjectAllocator oa { 32, config };
+    std::vector<void*> objects(OBJECTS);
+
+    // Create the pages before timing
+    oa.Reserve(OBJECTS);
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned frame = 0; frame < FRAMES; ++frame)
+    {
+        for (void*& obj : objects)
+        {
+            obj = oa.Allocate();
+        }
+
+        if (bulk)
+        {
+            oa.ReleaseAll();
+            continue;
+        }
+
+        for (void* obj : objects)
+        {
+            oa.Free(obj);
+        }
+    }
+    const Clock::time_point end = Clock::now();
+
+    return std::chrono::duration<double, std::nano>(end - start).count() / (static_cast<double>(FRAMES) * OBJECTS);
+}
+
+/************************************************************************************//*!
+ @brief  Measures how long a linked cache of nodes takes to be ready again, either by
+         building it in an ObjectAllocator or by reopening a persistent file that
+         already holds it.
+
+ @param  persistent
+    Whether to reopen the file instead of building the nodes.
+
+ @return The number of milliseconds until the cache is ready.
+*//*************************************************************************************/
+double BenchWarmStart(bool persistent)
+{
+    static const unsigned   NODES   = 1u << 20;
+    static const char*      PATH    = "PersistentCache.bin";
+
+    struct Node
+    {
+        uint64_t    next;
+        unsigned    key;
+        unsigned    value;
+    };
+
+    const OAConfig config { false, 4096, 0 };
+
+    if (!persistent)
+    {
+        const Clock::time_point start = Clock::now();
+        ObjectAllocator oa { sizeof(Node), config };
+        Node* head = nullptr;
+        for (unsigned i = 0; i < NODES; ++i)
+        {
+            Node* node = static_cast<Node*>(oa.Allocate());
+            *node = Node{ reinterpret_cast<uint64_t>(head), i, i * 2 };
+            head = node;
+        }
+        const Clock::time_point end = Clock::now();
+
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Build the file once, outside the timing
+    std::remove(PATH);
+    {
+        PersistentObjectAllocator poa { PATH, sizeof(Node), config };
+        uint64_t head = 0;
+        for (unsigned i = 0; i < NODES; ++i)
+        {
+            Node* node = static_cast<Node*>(poa.Allocate());
+            *node = Node{ head, i, i * 2 };
+            head = poa.ToOffset(node);
+        }
+        poa.SetRoot(poa.FromOffset(head));
+    }
+
+    const Clock::time_point start = Clock::now();
+    double ready = 0.0;
+    {
+        PersistentObjectAllocator poa { PATH, sizeof(Node), config };
+        const Node* head = static_cast<const Node*>(poa.GetRoot());
+        ready = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        if (!poa.WasResumed() || !head || head->key != NODES - 1)
+            ready = -1.0;
+    }
+    std::remove(PATH);
+
+    return ready;
+}
+
+/************************************************************************************//*!
+ @brief  Measures how many pages a fragmented pool of handles keeps after 90% of its
+         objects are freed at random, and how long it takes to get there.
+
+ @param  compact
+    Whether to Compact the pool instead of only freeing its empty pages.
+ @param  budget
+    The time budget of Compact. 0 means no limit.
+ @param  pages
+    Set to the number of pages left.
+
+ @return The number of milliseconds spent freeing pages.
+*//*************************************************************************************/
+double BenchCompaction(bool compact, std::chrono::microseconds budget, unsigned& pages)
+{
+    static const unsigned OBJECTS = 1u << 16;
+
+    HandleAllocator ha { 48, OAConfig{ false, 64, 0 } };
+    std::vector<HandleAllocator::Handle> handles(OBJECTS);
+    for (HandleAllocator::Handle& handle : handles)
+    {
+        handle = ha.Allocate();
+    }
+
+    // A fixed shuffle so every run keeps the same objects
+    uint32_t state = 12345;
+    for (unsigned i = OBJECTS - 1; i > 0; --i)
+    {
+        state = state * 1664525u + 1013904223u;
+        std::swap(handles[i], handles[state % (i + 1)]);
+    }
+    for (unsigned i = OBJECTS / 10; i < OBJECTS; ++i)
+    {
+        ha.Free(handles[i]);
+    }
+
+    const Clock::time_point start = Clock::now();
+    if (compact)
+        ha.Compact(budget);
+    else
+        ha.FreeEmptyPages();
+    const Clock::time_point end = Clock::now();
+
+    pages = ha.GetAllocator().GetStats().PagesInUse_;
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/************************************************************************************//*!
+ @brief  Measures the throughput of several threads allocating and freeing objects.
+
+ @param  threads
+    The number of threads to run.
+ @param  allocate
+    Allocates a single object. Must be safe to call from any thread.
+ @param  free
+    Frees a single object. Must be safe to call from any thread.
+ @param  threadExit
+    Called by every thread once it is done.
+
+ @return The number of millions of Allocate/Free pairs per second.
+*//*************************************************************************************/
+template <typename AllocateFn, typename FreeFn, typename ExitFn>
+double BenchThroughput(unsigned threads, AllocateFn allocate, FreeFn free, ExitFn threadExit)
+{
+    static const unsigned ROUNDS        = 20000;
+    static const unsigned LIVE_OBJECTS  = 32;
+
+    std::vector<std::thread> workers;
+
+    const Clock::time_point start = Clock::now();
+    for (unsigned t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            void* objects[LIVE_OBJECTS];
+            for (unsigned round = 0; round < ROUNDS; ++round)
+            {
+                for (void*& obj : objects)
+                {
+                    obj = allocate();
+                }
+                for (void* obj : objects)
+                {
+                    free(obj);
+                }
+            }
+            threadExit();
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    const Clock::time_point end = Clock::now();
+
+    const double pairs = static_cast<double>(threads) * ROUNDS * LIVE_OBJECTS;
+    return pairs / std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Checks                                                                              */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Checks that a call throws an OAException with a given code.
+
+ @param  code
+    The code the exception should have.
+ @param  fn
+    The call to make.
+
+ @return True if it threw with that code.
+*//*************************************************************************************/
+template <typename Fn>
+bool Throws(OAException::OA_EXCEPTION code, Fn fn)
+{
+    try
+    {
+        fn();
+    }
+    catch(const OAException& e)
+    {
+        return e.code() == code;
+    }
+    return false;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that a debugging allocator reports a repeated free and frees that are
+         not on a block boundary, with pages found by search or by alignment, and
+         that the stats are left alone when it does.
+
+ @param  type
+    The kind of header blocks to use.
+
+ @return True if every invalid free was reported with the right code.
+*//*************************************************************************************/
+bool CheckInvalidFrees(OAConfig::HBLOCK_TYPE type)
+{
+    bool passed = true;
+    for (int aligned = 0; aligned < 2; ++aligned)
+    {
+        const OAConfig config { false, 16, 0, true, 4, OAConfig::HeaderBlockInfo{ type }, 0, aligned != 0 };
+        ObjectAllocator oa { 32, config };
+
+        unsigned char* first = static_cast<unsigned char*>(oa.Allocate());
+        unsigned char* second = static_cast<unsigned char*>(oa.Allocate());
+        unsigned char outside[32];
+
+        oa.Free(first);
+        passed = passed && Throws(OAException::E_MULTIPLE_FREE, [&]() { oa.Free(first); });
+        passed = passed && Throws(OAException::E_BAD_BOUNDARY, [&]() { oa.Free(second + 1); });
+        passed = passed && Throws(OAException::E_BAD_BOUNDARY, [&]() { oa.Free(outside); });
+        passed = passed && oa.GetStats().ObjectsInUse_ == 1 && oa.GetStats().Deallocations_ == 1;
+
+        oa.Free(second);
+    }
+    return passed;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that sampling picks about 1 in DebugSampleRate_ allocations, and that a
+         picked block still reports a repeated free.
+
+ @return True if the share of picked blocks is plausible and the free was reported.
+*//*************************************************************************************/
+bool CheckSampling()
+{
+    static const unsigned RATE      = 8;
+    static const unsigned OBJECTS   = 8192;
+    static const size_t   SIZE      = 32;
+
+    OAConfig config { false, 256, 0, true };
+    config.DebugSampleRate_ = RATE;
+    ObjectAllocator oa { SIZE, config };
+
+    // Only picked blocks get the allocated pattern. The start of a block held its link.
+    std::vector<unsigned char*> objects(OBJECTS);
+    unsigned char* picked = nullptr;
+    unsigned pickedCount = 0;
+    for (unsigned char*& obj : objects)
+    {
+        obj = static_cast<unsigned char*>(oa.Allocate());
+        if (obj[SIZE - 1] == ObjectAllocator::ALLOCATED_PATTERN)
+        {
+            picked = obj;
+            ++pickedCount;
+        }
+    }
+
+    bool passed = picked != nullptr && pickedCount > OBJECTS / (RATE * 2) && pickedCount < OBJECTS / (RATE / 2);
+    for (unsigned char* obj : objects)
+    {
+        oa.Free(obj);
+    }
+    passed = passed && Throws(OAException::E_MULTIPLE_FREE, [&]() { oa.Free(picked); });
+
+    return passed && oa.GetStats().ObjectsInUse_ == 0;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that writing past either end of a guarded object faults. The writes are
+         made in a child process, which the fault ends. Not run on Windows.
+
+ @return True if the child was ended by the fault.
+*//*************************************************************************************/
+bool CheckGuardPages()
+{
+#ifdef _WIN32
+    return true;
+#else
+    OAConfig config { false, 16, 0, true };
+    config.GuardedSlots_ = 4;
+    ObjectAllocator oa { 32, config };
+    void* obj = oa.Allocate();
+
+    std::cout.flush();
+    const pid_t child = fork();
+    if (child < 0)
+        return false;
+
+    if (child == 0)
+    {
+        // The report of the fault is expected, so keep it out of the results
+        const int null = open("/dev/null", O_WRONLY);
+        if (null >= 0)
+            dup2(null, STDERR_FILENO);
+
+        // Objects sit against the guard page before or after them, so one of these faults
+        volatile unsigned char* bytes = static_cast<volatile unsigned char*>(obj);
+        bytes[-1] = 0;
+        bytes[32] = 0;
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    oa.Free(obj);
+
+    return WIFSIGNALED(status) && (WTERMSIG(status) == SIGSEGV || WTERMSIG(status) == SIGBUS);
+#endif
+}
+
+/************************************************************************************//*!
+ @brief  Checks that a persistent file reopens with its objects, root and stats as they
+         were, and that a freed object is handed out again after reopening.
+
+ @return True if every object came back unchanged.
+*//*************************************************************************************/
+bool CheckPersistentReopen()
+{
+    static const unsigned   NODES   = 5000;
+    static const char*      PATH    = "PersistentCheck.bin";
+
+    struct Node
+    {
+        uint64_t    next;
+        unsigned    key;
+        unsigned    value;
+    };
+
+    const OAConfig config { false, 64, 0 };
+    bool passed = true;
+
+    std::remove(PATH);
+    try
+    {
+        uint64_t freed = 0;
+        {
+            PersistentObjectAllocator poa { PATH, sizeof(Node), config };
+            uint64_t head = 0;
+            for (unsigned i = 0; i < NODES; ++i)
+            {
+                Node* node = static_cast<Node*>(poa.Allocate());
+                *node = Node{ head, i, i * 3 };
+                head = poa.ToOffset(node);
+            }
+            poa.SetRoot(poa.FromOffset(head));
+
+            void* last = poa.Allocate();
+            freed = poa.ToOffset(last);
+            poa.Free(last);
+            passed = !poa.WasResumed();
+        }
+
+        PersistentObjectAllocator poa { PATH, sizeof(Node), config };
+        passed = passed && poa.WasResumed() && poa.GetStats().ObjectsInUse_ == NODES;
+
+        // Walk the list from the root, newest node first
+        unsigned expected = NODES;
+        for (const Node* node = static_cast<const Node*>(poa.GetRoot()); node != nullptr;
+             node = static_cast<const Node*>(poa.FromOffset(node->next)))
+        {
+            --expected;
+            passed = passed && node->key == expected && node->value == expected * 3;
+        }
+        passed = passed && expected == 0;
+
+        // Offsets are the same in every mapping, so the freed block is still the next one
+        passed = passed && poa.ToOffset(poa.Allocate()) == freed;
+    }
+    catch(const OAException&)
+    {
+        passed = false;
+    }
+    std::remove(PATH);
+
+    return passed;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that Compact frees pages without changing any object, that every handle
+         still leads to its object, and that freed handles stay stale.
+
+ @return True if every object kept its contents after being moved.
+*//*************************************************************************************/
+bool CheckCompaction()
+{
+    static const unsigned OBJECTS = 4096;
+
+    struct Payload
+    {
+        unsigned    id;
+        unsigned    words[11];
+    };
+
+    HandleAllocator ha { sizeof(Payload), OAConfig{ false, 64, 0 } };
+    std::vector<HandleAllocator::Handle> handles(OBJECTS);
+    for (unsigned i = 0; i < OBJECTS; ++i)
+    {
+        handles[i] = ha.Allocate();
+        Payload* payload = static_cast<Payload*>(ha.Get(handles[i]));
+        payload->id = i;
+        std::fill(std::begin(payload->words), std::end(payload->words), i * 7);
+    }
+
+    // Keep every ninth object, so every page is left sparse
+    std::vector<unsigned> kept;
+    for (unsigned i = 0; i < OBJECTS; ++i)
+    {
+        if (i % 9 == 0)
+            kept.push_back(i);
+        else
+            ha.Free(handles[i]);
+    }
+
+    const unsigned pagesBefore = ha.GetAllocator().GetStats().PagesInUse_;
+    const unsigned freed = ha.Compact(std::chrono::microseconds{ 0 });
+
+    bool passed = freed > 0 && ha.GetMovedObjects() > 0 && ha.GetAllocator().GetStats().PagesInUse_ == pagesBefore - freed;
+    for (unsigned i : kept)
+    {
+        const Payload* payload = static_cast<const Payload*>(ha.Get(handles[i]));
+        passed = passed && payload != nullptr && payload->id == i
+                 && std::all_of(std::begin(payload->words), std::end(payload->words), [i](unsigned word) { return word == i * 7; });
+    }
+    passed = passed && ha.Get(handles[1]) == nullptr;
+    passed = passed && Throws(OAException::E_MULTIPLE_FREE, [&]() { ha.Free(handles[1]); });
+
+    return passed;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that a way of tracking free blocks hands out every block once, keeps
+         the contents of live blocks and counts them right as blocks are reused.
+
+ @param  config
+    The configuration to check, for 4-byte objects.
+
+ @return True if no block was handed out twice or changed while in use.
+*//*************************************************************************************/
+bool CheckTracking(const OAConfig& config)
+{
+    static const unsigned OBJECTS = 2000;
+
+    ObjectAllocator oa { sizeof(unsigned), config };
+    std::vector<unsigned*> objects(OBJECTS);
+    for (unsigned i = 0; i < OBJECTS; ++i)
+    {
+        objects[i] = static_cast<unsigned*>(oa.Allocate());
+        *objects[i] = i;
+    }
+
+    // Free every other block in a scattered order, then take them back
+    for (unsigned i = 0; i < OBJECTS; i += 2)
+    {
+        oa.Free(objects[(i * 7919u) % OBJECTS]);
+    }
+    for (unsigned i = 0; i < OBJECTS; i += 2)
+    {
+        objects[i] = static_cast<unsigned*>(oa.Allocate());
+        *objects[i] = i;
+    }
+
+    bool passed = oa.GetStats().ObjectsInUse_ == OBJECTS;
+    for (unsigned i = 0; i < OBJECTS; ++i)
+    {
+        passed = passed && *objects[i] == i;
+    }
+
+    std::vector<unsigned*> sorted = objects;
+    std::sort(sorted.begin(), sorted.end());
+    passed = passed && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+
+    // Bitmaps know which blocks are free, so a repeated free is always caught
+    oa.Free(objects[0]);
+    if (config.BitmapTracking_)
+    {
+        passed = passed && Throws(OAException::E_MULTIPLE_FREE, [&]() { oa.Free(objects[0]); });
+    }
+    passed = passed && oa.GetStats().ObjectsInUse_ == OBJECTS - 1 && oa.GetStats().FreeObjects_ + OBJECTS - 1 == oa.GetStats().PagesInUse_ * config.ObjectsPerPage_;
+
+    return passed;
+}
+
+/************************************************************************************//*!
+ @brief  Checks that ReleaseAll, on pages that grew past their first size, leaves every
+         block free and untracked, and that the whole capacity can be allocated again
+         without a new page.
+
+ @param  config
+    The configuration to check. MaxObjectsPerPage_ should be above ObjectsPerPage_.
+
+ @return True if the pages were reset as new ones.
+*//*************************************************************************************/
+bool CheckReleaseAll(const OAConfig& config)
+{
+    static const unsigned OBJECTS = 3000;
+
+    ObjectAllocator oa { 64, config };
+    std::vector<void*> objects(OBJECTS);
+    for (void*& obj : objects)
+    {
+        obj = oa.Allocate();
+    }
+
+    const unsigned pages = oa.GetStats().PagesInUse_;
+    const unsigned capacity = oa.GetStats().FreeObjects_ + OBJECTS;
+    oa.ReleaseAll();
+
+    bool passed = oa.GetStats().PagesInUse_ == pages && oa.GetStats().ObjectsInUse_ == 0 && oa.GetStats().FreeObjects_ == capacity;
+
+    // A cleared allocation bitmap reports a free of a released object as repeated
+    if (config.BitmapTracking_ || (config.DebugOn_ && config.DebugSampleRate_ <= 1))
+    {
+        passed = passed && Throws(OAException::E_MULTIPLE_FREE, [&]() { oa.Free(objects[OBJECTS / 2]); });
+    }
+
+    // Every block is free again, and only once
+    objects.resize(capacity);
+    for (void*& obj : objects)
+    {
+        obj = oa.Allocate();
+    }
+    passed = passed && oa.GetStats().PagesInUse_ == pages && oa.GetStats().FreeObjects_ == 0;
+
+    std::vector<void*> sorted = objects;
+    std::sort(sorted.begin(), sorted.end());
+    passed = passed && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+
+    // Stale sample bits would check blocks that were never patterned
+    try
+    {
+        for (void* obj : objects)
+        {
+            oa.Free(obj);
+        }
+    }
+    catch(const OAException&)
+    {
+        passed = false;
+    }
+
+    return passed && oa.GetStats().FreeObjects_ == capacity;
+}
+
+/************************************************************************************//*!
+ @brief  Prints the result of a check.
+
+ @param  name
+    The name of the check.
+ @param  passed
+    Whether it passed.
+
+ @return 1 if it failed, 0 otherwise.
+*//*************************************************************************************/
+int Report(const char* name, bool passed)
+{
+    std::cout << std::setw(12) << name << ": " << (passed ? "pass" : "FAIL") << std::endl;
+    return passed ? 0 : 1;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Main                                                                                */
+/*-------------------------------------------------------------------------------------*/
 int main()
 {
-    
-}
\ No newline at end of file
+    const char* HEADER_NAMES[] = { "hbNone", "hbBasic", "hbExtended", "hbExternal" };
+
+    std::cout << std::fixed << std::setprecision(1);
+
+    int failures = 0;
+    std::cout << "Checks" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+    {
+        failures += Report(HEADER_NAMES[type], CheckInvalidFrees(static_cast<OAConfig::HBLOCK_TYPE>(type)));
+    }
+    failures += Report("sampling", CheckSampling());
+    failures += Report("guard pages", CheckGuardPages());
+    failures += Report("persistent", CheckPersistentReopen());
+    failures += Report("compaction", CheckCompaction());
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        static const char* MODE_NAMES[] = { "pointer", "index", "bitmap" };
+
+        OAConfig config { false, 64, 0 };
+        config.PageFreeLists_ = mode == 0;
+        config.IndexedLinks_ = mode == 1;
+        config.BitmapTracking_ = mode == 2;
+
+        failures += Report(MODE_NAMES[mode], CheckTracking(config));
+    }
+    for (int mode = 0; mode < 4; ++mode)
+    {
+        static const char* MODE_NAMES[] = { "reset list", "reset bitmap", "reset debug", "reset sample" };
+
+        OAConfig config { false, 8, 0 };
+        config.MaxObjectsPerPage_ = 512;
+        config.BitmapTracking_ = mode == 1;
+        config.DebugOn_ = mode >= 2;
+        config.AlignPages_ = mode >= 2;
+        config.DebugSampleRate_ = mode == 3 ? 4 : 0;
+
+        failures += Report(MODE_NAMES[mode], CheckReleaseAll(config));
+    }
+
+    std::cout << "Debug Free latency (ns/op) against free list length" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+    {
+        const OAConfig config { false, 1024, 0, true, 4, OAConfig::HeaderBlockInfo{ static_cast<OAConfig::HBLOCK_TYPE>(type) } };
+
+        std::cout << std::setw(12) << HEADER_NAMES[type];
+        for (unsigned freeBlocks = 1024; freeBlocks <= 256 * 1024; freeBlocks *= 4)
+        {
+            std::cout << std::setw(10) << freeBlocks << ": " << std::setw(8) << BenchDebugFree(freeBlocks, config);
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Debug Free latency (ns/op) against page count (16 objects per page)" << std::endl;
+    for (int aligned = 0; aligned < 2; ++aligned)
+    {
+        const OAConfig config { false, 16, 0, true, 4, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic }, 0, aligned != 0 };
+
+        std::cout << std::setw(12) << (aligned ? "aligned" : "indexed");
+        for (unsigned freeBlocks = 1024; freeBlocks <= 256 * 1024; freeBlocks *= 4)
+        {
+            std::cout << std::setw(10) << freeBlocks / 16 << ": " << std::setw(8) << BenchDebugFree(freeBlocks, config);
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), single vs batch" << std::endl;
+    for (int debug = 0; debug < 2; ++debug)
+    {
+        const OAConfig config { false, 1024, 0, debug != 0, 0, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic } };
+
+        std::cout << std::setw(12) << (debug ? "debug" : "release") << ": " << std::setw(8) << BenchBatch(false, config) << std::setw(8) << BenchBatch(true, config) << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), release vs 1-in-64 sampled vs full debug" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+    {
+        OAConfig config { false, 1024, 0, false, 8, OAConfig::HeaderBlockInfo{ static_cast<OAConfig::HBLOCK_TYPE>(type) } };
+        const double release = BenchBatch(false, config);
+        config.DebugOn_ = true;
+        config.DebugSampleRate_ = 64;
+        const double sampled = BenchBatch(false, config);
+        config.DebugSampleRate_ = 0;
+        const double debug = BenchBatch(false, config);
+
+        std::cout << std::setw(12) << HEADER_NAMES[type] << ": " << std::setw(8) << release << std::setw(8) << sampled << std::setw(8) << debug << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), 1-in-64 sampled without vs with 16 guarded slots" << std::endl;
+    {
+        OAConfig config { false, 1024, 0, true, 8, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic } };
+        config.DebugSampleRate_ = 64;
+        const double sampled = BenchBatch(false, config);
+        config.GuardedSlots_ = 16;
+        const double guarded = BenchBatch(false, config);
+
+        std::cout << std::setw(12) << "hbBasic" << ": " << std::setw(8) << sampled << std::setw(8) << guarded << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), free list vs page free lists vs bitmap tracking" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbBasic; ++type)
+    {
+        OAConfig config { false, 1024, 0, false, 0, OAConfig::HeaderBlockInfo{ static_cast<OAConfig::HBLOCK_TYPE>(type) } };
+        const double list = BenchBatch(false, config);
+        config.PageFreeLists_ = true;
+        const double pages = BenchBatch(false, config);
+        config.BitmapTracking_ = true;
+        const double bitmap = BenchBatch(false, config);
+
+        std::cout << std::setw(12) << HEADER_NAMES[type] << ": " << std::setw(8) << list << std::setw(8) << pages << std::setw(8) << bitmap << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), runtime vs compile-time configuration" << std::endl;
+    {
+        struct Object { char bytes[32]; };
+
+        ObjectAllocator runtime { sizeof(Object), OAConfig{ false, 1024, 0, false, 0, OAConfig::HeaderBlockInfo{ OAConfig::hbBasic } } };
+        TypedObjectAllocator<Object, OAStaticConfig<1024, 0, false, 0, OAConfig::hbBasic>> typed;
+
+        std::cout << std::setw(12) << "hbBasic" << ": " << std::setw(8) << BenchAllocateFree(runtime) << std::setw(8) << BenchAllocateFree(typed) << std::endl;
+    }
+
+    std::cout << "ValidatePages over 4096 pages (us), operator new vs mapped vs huge pages" << std::endl;
+    {
+        MappedPageProvider mapped;
+        MappedPageProvider huge { DEFAULT_RESERVE_SIZE, true };
+
+        std::cout << std::setw(12) << "walk" << ": " << std::setw(8) << BenchPageWalk(nullptr) << std::setw(8) << BenchPageWalk(&mapped) << std::setw(8) << BenchPageWalk(&huge) << std::endl;
+    }
+
+    std::cout << "ValidatePages over 1024 pages (us), pad bytes only vs freed blocks too" << std::endl;
+    for (unsigned padBytes = 4; padBytes <= 64; padBytes *= 4)
+    {
+        std::cout << std::setw(8) << padBytes << " pad: " << std::setw(8) << BenchValidate(padBytes, false) << std::setw(8) << BenchValidate(padBytes, true) << std::endl;
+    }
+
+    std::cout << "ValidatePages over 1024 pages with freed blocks (us), sequential vs 1, 2, 4 and 8 threads" << std::endl;
+    {
+        std::cout << std::setw(8) << 16 << " pad: " << std::setw(8) << BenchValidate(16, true);
+        for (unsigned threads = 1; threads <= 8; threads *= 2)
+        {
+            std::cout << std::setw(8) << BenchValidate(16, true, threads);
+        }
+        std::cout << std::endl;
+    }
+
+    std::cout << "Allocate + Free per object (ns), 8 to 512 bytes, new/delete vs slab" << std::endl;
+    {
+        SlabAllocator slab;
+        const double newRate = BenchMixedSizes([](size_t bytes) { return ::operator new(bytes); }, [](void* obj) { ::operator delete(obj); });
+        const double slabRate = BenchMixedSizes([&](size_t bytes) { return slab.Allocate(bytes); }, [&](void* obj) { slab.Free(obj); });
+
+        std::cout << std::setw(12) << "mixed" << ": " << std::setw(8) << newRate << std::setw(8) << slabRate << std::endl;
+    }
+
+    std::cout << "Insert + erase per node (ns), std::allocator vs pmr resource vs slab allocator" << std::endl;
+    {
+        SlabMemoryResource resource;
+        SlabAllocator slab;
+
+        std::map<unsigned, unsigned> defaultMap;
+        std::pmr::map<unsigned, unsigned> pmrMap { &resource };
+        std::map<unsigned, unsigned, std::less<unsigned>, SlabStlAllocator<std::pair<const unsigned, unsigned>>> slabMap { SlabStlAllocator<std::pair<const unsigned, unsigned>>{ slab } };
+        std::cout << std::setw(12) << "map" << ": " << std::setw(8) << BenchMap(defaultMap) << std::setw(8) << BenchMap(pmrMap) << std::setw(8) << BenchMap(slabMap) << std::endl;
+
+        std::list<unsigned> defaultList;
+        std::pmr::list<unsigned> pmrList { &resource };
+        std::list<unsigned, SlabStlAllocator<unsigned>> slabList { SlabStlAllocator<unsigned>{ slab } };
+        std::cout << std::setw(12) << "list" << ": " << std::setw(8) << BenchList(defaultList) << std::setw(8) << BenchList(pmrList) << std::setw(8) << BenchList(slabList) << std::endl;
+    }
+
+    std::cout << "Allocate + Free of 1M objects (ns/object, pages), fixed vs growing pages" << std::endl;
+    for (int growing = 0; growing < 2; ++growing)
+    {
+        OAConfig config { false, 16, 0 };
+        config.MaxObjectsPerPage_ = growing ? 4096 : 0;
+
+        unsigned pages = 0;
+        const double rate = BenchPopulation(config, pages);
+        std::cout << std::setw(12) << (growing ? "growing" : "fixed") << ": " << std::setw(8) << rate << std::setw(8) << pages << std::endl;
+    }
+
+    std::cout << "First 64K Allocates (p99.9 ns, mean ns), pages on demand vs reserved" << std::endl;
+    for (int bitmap = 0; bitmap < 2; ++bitmap)
+    {
+        OAConfig config { false, 256, 0 };
+        config.BitmapTracking_ = bitmap != 0;
+
+        double lazyMean = 0.0;
+        double reservedMean = 0.0;
+        const double lazy = BenchFirstTouch(config, false, lazyMean);
+        const double reserved = BenchFirstTouch(config, true, reservedMean);
+
+        std::cout << std::setw(12) << (bitmap ? "bitmap" : "free list") << ": " << std::setw(8) << lazy << std::setw(8) << lazyMean
+                  << std::setw(8) << reserved << std::setw(8) << reservedMean << std::endl;
+    }
+
+    std::cout << "Labelled Allocate + Free per object (ns) by header type" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+    {
+        const OAConfig config { false, 1024, 0, false, 0, OAConfig::HeaderBlockInfo{ static_cast<OAConfig::HBLOCK_TYPE>(type) } };
+
+        std::cout << std::setw(12) << HEADER_NAMES[type] << ": " << std::setw(8) << BenchLabelled(config) << std::endl;
+    }
+
+    std::cout << "Labelled Allocate + Free per object (ns) by header type, telemetry off vs on" << std::endl;
+    for (int type = OAConfig::hbNone; type <= OAConfig::hbExternal; ++type)
+    {
+        OAConfig config { false, 1024, 0, false, 0, OAConfig::HeaderBlockInfo{ static_cast<OAConfig::HBLOCK_TYPE>(type) } };
+        const double off = BenchLabelled(config);
+        config.Telemetry_ = true;
+        const double on = BenchLabelled(config);
+
+        std::cout << std::setw(12) << HEADER_NAMES[type] << ": " << std::setw(8) << off << std::setw(8) << on << std::endl;
+    }
+
+    std::cout << "Labelled Allocate + Free per object (ns), no call stacks vs 8 frames kept for leak reports" << std::endl;
+    {
+        OAConfig config { false, 1024, 0, false, 0, OAConfig::HeaderBlockInfo{ OAConfig::hbExternal } };
+        const double plain = BenchLabelled(config);
+        config.LeakStackDepth_ = 8;
+        const double stacks = BenchLabelled(config);
+
+        std::cout << std::setw(12) << "hbExternal" << ": " << std::setw(8) << plain << std::setw(8) << stacks << std::endl;
+    }
+
+    std::cout << "Bursty Allocate + Free per object (ns, pages kept), FreeEmptyPages every tick vs background reclaimer" << std::endl;
+    {
+        unsigned inlinePages = 0;
+        unsigned backgroundPages = 0;
+        const double inlineRate = BenchReclaim(false, inlinePages);
+        const double backgroundRate = BenchReclaim(true, backgroundPages);
+
+        std::cout << std::setw(12) << "bursts" << ": " << std::setw(8) << inlineRate << std::setw(8) << inlinePages
+                  << std::setw(8) << backgroundRate << std::setw(8) << backgroundPages << std::endl;
+    }
+
+    std::cout << "Pool of 256K 4-byte ids (bytes/id, ns per Allocate + Free), by free block link" << std::endl;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        static const char* MODE_NAMES[] = { "pointer", "index", "bitmap" };
+
+        OAConfig config { false, 4096, 0 };
+        config.PageFreeLists_ = mode == 0;
+        config.IndexedLinks_ = mode == 1;
+        config.BitmapTracking_ = mode == 2;
+
+        double bytes = 0.0;
+        const double rate = BenchTinyObjects(config, bytes);
+
+        std::cout << std::setw(12) << MODE_NAMES[mode] << ": " << std::setw(8) << bytes << std::setw(8) << rate << std::endl;
+    }
+
+    std::cout << "Pages left of 64K handles after freeing 90% at random (pages, ms), FreeEmptyPages vs Compact in 1 ms vs Compact" << std::endl;
+    {
+        unsigned emptyPages = 0;
+        unsigned budgetPages = 0;
+        unsigned fullPages = 0;
+        const double emptyTime = BenchCompaction(false, std::chrono::microseconds{ 0 }, emptyPages);
+        const double budgetTime = BenchCompaction(true, std::chrono::microseconds{ 1000 }, budgetPages);
+        const double fullTime = BenchCompaction(true, std::chrono::microseconds{ 0 }, fullPages);
+
+        std::cout << std::setw(12) << "handles" << ": " << std::setw(8) << emptyPages << std::setw(8) << emptyTime
+                  << std::setw(8) << budgetPages << std::setw(8) << budgetTime << std::setw(8) << fullPages << std::setw(8) << fullTime << std::endl;
+    }
+
+    std::cout << "Per-frame Allocate + release of 64K objects (ns/object), Free each vs ReleaseAll" << std::endl;
+    for (int mode = 0; mode < 3; ++mode)
+    {
+        static const char* MODE_NAMES[] = { "free list", "debug", "bitmap" };
+
+        OAConfig config { false, 1024, 0 };
+        config.DebugOn_ = mode == 1;
+        config.BitmapTracking_ = mode == 2;
+
+        const double each = BenchFrameRelease(config, false);
+        const double bulk = BenchFrameRelease(config, true);
+
+        std::cout << std::setw(12) << MODE_NAMES[mode] << ": " << std::setw(8) << each << std::setw(8) << bulk << std::endl;
+    }
+
+    std::cout << "Warm start of a 1M-node cache (ms), rebuild in an ObjectAllocator vs reopen a persistent file" << std::endl;
+    {
+        const double rebuild = BenchWarmStart(false);
+        const double reopen = BenchWarmStart(true);
+
+        std::cout << std::setw(12) << "1M nodes" << ": " << std::setw(8) << rebuild << std::setw(8) << reopen << std::endl;
+    }
+
+    std::cout << "Multithreaded throughput (M pairs/s), single lock vs per-thread magazines" << std::endl;
+    for (unsigned threads = 1; threads <= 8; threads *= 2)
+    {
+        const OAConfig config { false, 1024, 0 };
+
+        ObjectAllocator locked { 32, config };
+        std::mutex lock;
+        const double lockedRate = BenchThroughput(threads,
+            [&]() { std::lock_guard<std::mutex> guard { lock }; return locked.Allocate(); },
+            [&](void* obj) { std::lock_guard<std::mutex> guard { lock }; locked.Free(obj); },
+            []() {});
+
+        ConcurrentObjectAllocator concurrent { 32, config };
+        const double concurrentRate = BenchThroughput(threads,
+            [&]() { return concurrent.Allocate(); },
+            [&](void* obj) { concurrent.Free(obj); },
+            [&]() { concurrent.Flush(); });
+
+        std::cout << std::setw(12) << threads << " threads: " << std::setw(8) << lockedRate << std::setw(8) << concurrentRate << std::endl;
+    }
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,394 @@
+/************************************************************************************//*!
+\file           ConcurrentObjectAllocator.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the ConcurrentObjectAllocator class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "ConcurrentObjectAllocator.h"
+// Standard Libraries
+#include <algorithm>
+#include <unordered_set>
+
+#define TO_GENERIC_OBJECT_PTR(pointer) reinterpret_cast<GenericObject*>(pointer)
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+static std::atomic<unsigned long long> nextAllocatorId { 1 };
+
+static std::mutex                               liveAllocatorsLock;
+static std::unordered_set<unsigned long long>   liveAllocators;             // ids of the allocators not yet destroyed
+static std::atomic<unsigned long long>          destroyedAllocators { 0 };  // bumped by every destructor
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Creates the ConcurrentObjectAllocator per the specified values
+
+ @param  ObjectSize
+    The size of each object in a block. Objects freed by other threads are linked
+    through their first bytes, so it is rounded up to a pointer.
+ @param  config
+    The configuration properties for the central allocator.
+ @param  MagazineSize
+    The number of objects each thread can cache. Defaults to 64.
+
+ @throws An exception if the construction fails.
+*//*********************************************************************************/
+ConcurrentObjectAllocator::ConcurrentObjectAllocator(size_t objectSize, const OAConfig& config, unsigned size)
+: central       (objectSize < sizeof(GenericObject) ? sizeof(GenericObject) : objectSize, config)
+, centralLock   ()
+, shared        (nullptr)
+, magazineSize  (size ? size : 1)
+, debugging     (config.DebugOn_ && !config.UseCPPMemManager_)
+, id            (nextAllocatorId++)
+, stopReclaimer (false)
+{
+    std::lock_guard<std::mutex> lock { liveAllocatorsLock };
+    liveAllocators.insert(id);
+}
+
+/********************************************************************************//*!
+ @brief  Destructor for ConcurrentObjectAllocator. Stops the reclaimer, and lets every
+        thread drop its magazine for this allocator the next time it uses one.
+*//*********************************************************************************/
+ConcurrentObjectAllocator::~ConcurrentObjectAllocator()
+{
+    StopReclaimer();
+
+    {
+        std::lock_guard<std::mutex> lock { liveAllocatorsLock };
+        liveAllocators.erase(id);
+    }
+    destroyedAllocators.fetch_add(1, std::memory_order_release);
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Takes an object from the calling thread's magazine, or from the central
+        allocator while debugging.
+
+ @return Pointer to the allocated object.
+
+ @throws An exception from OAException if the object can't be allocated.
+*//*********************************************************************************/
+void* ConcurrentObjectAllocator::Allocate()
+{
+    if (debugging)
+    {
+        std::lock_guard<std::mutex> lock { centralLock };
+        return central.Allocate();
+    }
+
+    Magazine& magazine = localMagazine();
+    if (magazine.objects.empty())
+    {
+        refill(magazine);
+    }
+
+    void* obj = magazine.objects.back();
+    magazine.objects.pop_back();
+    return obj;
+}
+
+/********************************************************************************//*!
+ @brief  Returns an object to the calling thread's magazine. The object may have been
+        allocated by any thread. Outside debugging it is not checked, and a bad free
+        only surfaces when it is drained, from a later call on any thread, or not at
+        all from the reclaimer.
+
+ @param  Object
+    The object to return.
+
+ @throws An exception from OAException while debugging, if the central allocator
+        finds the free invalid.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::Free(void* Object)
+{
+    // Checked at once, so the error goes to the thread that made it
+    if (debugging)
+    {
+        std::lock_guard<std::mutex> lock { centralLock };
+        central.Free(Object);
+        return;
+    }
+
+    Magazine& magazine = localMagazine();
+
+    // Keep half so that alternating Allocate/Free does not bounce on the shared list
+    if (magazine.objects.size() >= magazineSize)
+    {
+        flush(magazine, magazine.objects.size() / 2 + 1);
+    }
+
+    magazine.objects.push_back(Object);
+}
+
+/********************************************************************************//*!
+ @brief  Moves every object cached by the calling thread onto the shared list.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::Flush()
+{
+    Magazine& magazine = localMagazine();
+    flush(magazine, magazine.objects.size());
+}
+
+/********************************************************************************//*!
+ @brief  Returns the objects on the shared list to the central allocator and frees
+        its empty pages.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned ConcurrentObjectAllocator::FreeEmptyPages()
+{
+    std::vector<void*> objects = takeShared();
+
+    std::lock_guard<std::mutex> lock { centralLock };
+    central.FreeBatch(objects.data(), static_cast<unsigned>(objects.size()));
+    return central.FreeEmptyPages();
+}
+
+/********************************************************************************//*!
+ @brief  Returns the objects on the shared list to the central allocator and frees its
+        empty pages that stayed idle since the last call.
+
+ @param  RetainObjects
+    The number of free objects to keep pages for.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned ConcurrentObjectAllocator::ReclaimIdlePages(unsigned RetainObjects)
+{
+    std::vector<void*> objects = takeShared();
+
+    std::lock_guard<std::mutex> lock { centralLock };
+    central.FreeBatch(objects.data(), static_cast<unsigned>(objects.size()));
+    return central.ReclaimIdlePages(RetainObjects);
+}
+
+/********************************************************************************//*!
+ @brief  Starts a thread that calls ReclaimIdlePages every interval.
+
+ @param  RetainObjects
+    The number of free objects to keep pages for.
+ @param  Interval
+    The time between scans.
+
+ @throws std::system_error if the thread can't be started.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::StartReclaimer(unsigned RetainObjects, std::chrono::milliseconds Interval)
+{
+    StopReclaimer();
+
+    stopReclaimer = false;
+    reclaimer = std::thread([this, RetainObjects, Interval]()
+    {
+        std::unique_lock<std::mutex> lock { reclaimerLock };
+        while (!reclaimerWake.wait_for(lock, Interval, [this]() { return stopReclaimer; }))
+        {
+            lock.unlock();
+            try
+            {
+                ReclaimIdlePages(RetainObjects);
+            }
+            catch(const OAException&)
+            {
+                // A bad free on the shared list has no caller to go to, ValidatePages still finds
+                // it. Debugging checks every Free at once, so none get this far then.
+            }
+            lock.lock();
+        }
+    });
+}
+
+/********************************************************************************//*!
+ @brief  Stops the reclaimer thread and waits for it.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::StopReclaimer()
+{
+    if (!reclaimer.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock { reclaimerLock };
+        stopReclaimer = true;
+    }
+    reclaimerWake.notify_one();
+    reclaimer.join();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets the statistics of the central allocator.
+
+ @return The statistics of the central allocator.
+*//*********************************************************************************/
+OAStats ConcurrentObjectAllocator::GetStats() const
+{
+    std::lock_guard<std::mutex> lock { centralLock };
+    return central.GetStats();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets the calling thread's magazine for this allocator, creating it if needed.
+        Magazines of allocators destroyed since the last call are dropped first.
+
+ @return The magazine.
+*//*********************************************************************************/
+ConcurrentObjectAllocator::Magazine& ConcurrentObjectAllocator::localMagazine()
+{
+    thread_local std::vector<Magazine>  magazines;
+    thread_local unsigned long long     prunedAt = 0;
+
+    // Drop the magazines of allocators destroyed since this thread last looked, so they
+    // neither keep their buffers nor slow down the search. Ids are never reused.
+    const unsigned long long destroyed = destroyedAllocators.load(std::memory_order_acquire);
+    if (destroyed != prunedAt)
+    {
+        std::lock_guard<std::mutex> lock { liveAllocatorsLock };
+        magazines.erase(std::remove_if(magazines.begin(), magazines.end(), [](const Magazine& magazine)
+        {
+            return liveAllocators.count(magazine.owner) == 0;
+        }), magazines.end());
+        prunedAt = destroyed;
+    }
+
+    for (Magazine& magazine : magazines)
+    {
+        if (magazine.owner == id)
+            return magazine;
+    }
+
+    magazines.emplace_back(Magazine{ id, {} });
+    magazines.back().objects.reserve(magazineSize);
+    return magazines.back();
+}
+/********************************************************************************//*!
+ @brief  Refills an empty magazine from the shared list, or the central allocator
+        if the shared list is empty.
+
+ @param  magazine
+    The magazine to refill.
+
+ @throws An exception from OAException if no object can be allocated.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::refill(Magazine& magazine)
+{
+    const size_t batch = magazineSize / 2 + 1;
+
+    // Taking the whole list at once means there is no ABA problem
+    GenericObject* obj = shared.exchange(nullptr, std::memory_order_acquire);
+    while (obj != nullptr && magazine.objects.size() < batch)
+    {
+        magazine.objects.push_back(obj);
+        obj = obj->Next;
+    }
+
+    // Pushing the rest back means walking it on every refill, so the central allocator
+    // takes it in one walk instead and later refills are batches from there
+    if (obj != nullptr)
+    {
+        std::vector<void*> rest;
+        for (; obj != nullptr; obj = obj->Next)
+        {
+            rest.push_back(obj);
+        }
+
+        std::lock_guard<std::mutex> lock { centralLock };
+        central.FreeBatch(rest.data(), static_cast<unsigned>(rest.size()));
+    }
+
+    if (!magazine.objects.empty())
+        return;
+
+    std::lock_guard<std::mutex> lock { centralLock };
+    magazine.objects.resize(batch);
+    try
+    {
+        central.AllocateBatch(static_cast<unsigned>(batch), magazine.objects.data());
+    }
+    catch(const OAException&)
+    {
+        // Not enough room for a whole batch, and none of it was taken, so settle for a
+        // single object
+        magazine.objects.clear();
+        magazine.objects.push_back(central.Allocate());
+    }
+}
+/********************************************************************************//*!
+ @brief  Moves objects from the end of a magazine onto the shared list.
+
+ @param  magazine
+    The magazine to flush.
+ @param  count
+    The number of objects to flush.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::flush(Magazine& magazine, size_t count)
+{
+    if (count == 0)
+        return;
+
+    // Chain the objects together through their own memory
+    GenericObject* first = nullptr;
+    GenericObject* last = TO_GENERIC_OBJECT_PTR(magazine.objects.back());
+    for (size_t i = 0; i < count; ++i)
+    {
+        GenericObject* obj = TO_GENERIC_OBJECT_PTR(magazine.objects.back());
+        magazine.objects.pop_back();
+
+        obj->Next = first;
+        first = obj;
+    }
+
+    pushShared(first, last);
+}
+/********************************************************************************//*!
+ @brief  Pushes a chain of objects onto the shared list.
+
+ @param  first
+    The first object of the chain.
+ @param  last
+    The last object of the chain.
+*//*********************************************************************************/
+void ConcurrentObjectAllocator::pushShared(GenericObject* first, GenericObject* last)
+{
+    GenericObject* head = shared.load(std::memory_order_relaxed);
+    do
+    {
+        last->Next = head;
+    }
+    while (!shared.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+}
+/********************************************************************************//*!
+ @brief  Takes every object off the shared list, to be returned to the central
+        allocator.
+
+ @return The objects.
+*//*********************************************************************************/
+std::vector<void*> ConcurrentObjectAllocator::takeShared()
+{
+    std::vector<void*> objects;
+    for (GenericObject* obj = shared.exchange(nullptr, std::memory_order_acquire); obj != nullptr; obj = obj->Next)
+    {
+        objects.push_back(obj);
+    }
+    return objects;
+}
@@ -0,0 +1,253 @@
+/************************************************************************************//*!
+ \file           ConcurrentObjectAllocator.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the ConcurrentObjectAllocator class, a
+                 thread-safe front end for the ObjectAllocator.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef CONCURRENTOBJECTALLOCATORH
+#define CONCURRENTOBJECTALLOCATORH
+
+// Standard Libraries
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+// Project Headers
+#include "ObjectAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+// If the client doesn't specify it:
+
+static const unsigned DEFAULT_MAGAZINE_SIZE = 64;
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  A thread-safe ObjectAllocator.
+
+         Every thread keeps a magazine of free objects for each allocator it uses, so
+         most calls to Allocate and Free touch no shared state at all. When a magazine
+         runs dry it is refilled in a batch from a lock-free shared list, and only when
+         that is empty as well is the central ObjectAllocator locked. A full magazine
+         flushes half of its objects back onto the shared list with a single
+         compare-and-swap, so frees are lock-free no matter which thread allocated the
+         object.
+
+         Objects sitting in magazines or on the shared list count as in use by the
+         central allocator until they are drained by FreeEmptyPages. A thread should
+         call Flush before it exits, otherwise its cached objects are only reclaimed
+         when the allocator is destroyed.
+
+         An optional reclaimer thread returns idle empty pages in the background, so
+         threads that allocate heavily never wait on a full scan, and keeps enough
+         pages for a burst so they aren't freed just to be created again.
+
+         While debugging (DebugOn_), magazines are bypassed and every Allocate and Free
+         locks the central allocator, so an invalid free is reported to the thread that
+         made it rather than later, from whichever call drains it.
+*//*************************************************************************************/
+class ConcurrentObjectAllocator
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the ConcurrentObjectAllocator per the specified values
+
+    @param  ObjectSize
+        The size of each object in a block. Objects freed by other threads are linked
+        through their first bytes, so it is rounded up to a pointer.
+    @param  config
+        The configuration properties for the central allocator.
+    @param  MagazineSize
+        The number of objects each thread can cache. Defaults to 64.
+
+    @throws An exception if the construction fails.
+    *//*********************************************************************************/
+    ConcurrentObjectAllocator(size_t ObjectSize, const OAConfig& config, unsigned MagazineSize = DEFAULT_MAGAZINE_SIZE);
+
+    // Prevent copy construction and assignment
+    ConcurrentObjectAllocator(const ConcurrentObjectAllocator &oa) = delete;            //!< Do not implement!
+    ConcurrentObjectAllocator &operator=(const ConcurrentObjectAllocator &oa) = delete; //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for ConcurrentObjectAllocator. Stops the reclaimer. No other
+            thread may be using the allocator at this point. Each thread drops its
+            magazine for this allocator the next time it uses any allocator.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~ConcurrentObjectAllocator();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Takes an object from the calling thread's magazine, or from the central
+            allocator while debugging.
+
+    @return Pointer to the allocated object.
+
+    @throws An exception from OAException if the object can't be allocated.
+    *//*********************************************************************************/
+    void* Allocate();
+
+    /********************************************************************************//*!
+    @brief  Returns an object to the calling thread's magazine. The object may have been
+            allocated by any thread. Outside debugging it is not checked, and a bad free
+            only surfaces when it is drained, from a later call on any thread, or not at
+            all from the reclaimer.
+
+    @param  Object
+        The object to return.
+
+    @throws An exception from OAException while debugging, if the central allocator
+            finds the free invalid.
+    *//*********************************************************************************/
+    void Free(void *Object);
+
+    /********************************************************************************//*!
+    @brief  Moves every object cached by the calling thread onto the shared list.
+    *//*********************************************************************************/
+    void Flush();
+
+    /********************************************************************************//*!
+    @brief  Returns the objects on the shared list to the central allocator and frees
+            its empty pages.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned FreeEmptyPages();
+
+    /********************************************************************************//*!
+    @brief  Returns the objects on the shared list to the central allocator and frees
+            its empty pages that stayed idle since the last call, as
+            ObjectAllocator::ReclaimIdlePages does.
+
+    @param  RetainObjects
+        The number of free objects to keep pages for.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned ReclaimIdlePages(unsigned RetainObjects);
+
+    /********************************************************************************//*!
+    @brief  Starts a thread that calls ReclaimIdlePages every interval, so empty pages
+            are freed once they have been idle for a whole interval. Restarts the
+            thread if it is already running.
+
+    @param  RetainObjects
+        The number of free objects to keep pages for.
+    @param  Interval
+        The time between scans.
+
+    @throws std::system_error if the thread can't be started.
+    *//*********************************************************************************/
+    void StartReclaimer(unsigned RetainObjects, std::chrono::milliseconds Interval);
+
+    /********************************************************************************//*!
+    @brief  Stops the reclaimer thread and waits for it. Does nothing if it isn't
+            running.
+    *//*********************************************************************************/
+    void StopReclaimer();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the statistics of the central allocator.
+
+    @return The statistics of the central allocator.
+    *//*********************************************************************************/
+    OAStats GetStats() const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  The objects a single thread has cached for a single allocator.
+    *//*********************************************************************************/
+    struct Magazine
+    {
+        unsigned long long  owner;      //!< The id of the allocator the objects belong to
+        std::vector<void*>  objects;    //!< The cached objects
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    ObjectAllocator                 central;        //!< the allocator that owns the pages
+    mutable std::mutex              centralLock;    //!< guards the central allocator
+    std::atomic<GenericObject*>     shared;         //!< lock-free list of objects flushed by threads
+    const unsigned                  magazineSize;   //!< the number of objects a thread can cache
+    const bool                      debugging;      //!< bypass the magazines so every Free is checked (DebugOn_)
+    const unsigned long long        id;             //!< unique id to find this allocator's magazines
+    std::thread                     reclaimer;      //!< the thread freeing idle pages, if started
+    std::mutex                      reclaimerLock;  //!< guards stopReclaimer
+    std::condition_variable         reclaimerWake;  //!< wakes the reclaimer early to stop it
+    bool                            stopReclaimer;  //!< set to make the reclaimer exit
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the calling thread's magazine for this allocator, creating it if needed.
+            Magazines of allocators destroyed since the last call are dropped first.
+
+    @return The magazine.
+    *//*********************************************************************************/
+    Magazine& localMagazine();
+    /********************************************************************************//*!
+    @brief  Refills an empty magazine from the shared list, or the central allocator
+            if the shared list is empty.
+
+    @param  magazine
+        The magazine to refill.
+
+    @throws An exception from OAException if no object can be allocated.
+    *//*********************************************************************************/
+    void refill(Magazine& magazine);
+    /********************************************************************************//*!
+    @brief  Moves objects from the end of a magazine onto the shared list.
+
+    @param  magazine
+        The magazine to flush.
+    @param  count
+        The number of objects to flush.
+    *//*********************************************************************************/
+    void flush(Magazine& magazine, size_t count);
+    /********************************************************************************//*!
+    @brief  Pushes a chain of objects onto the shared list.
+
+    @param  first
+        The first object of the chain.
+    @param  last
+        The last object of the chain.
+    *//*********************************************************************************/
+    void pushShared(GenericObject* first, GenericObject* last);
+    /********************************************************************************//*!
+    @brief  Takes every object off the shared list, to be returned to the central
+            allocator.
+
+    @return The objects.
+    *//*********************************************************************************/
+    std::vector<void*> takeShared();
+};
+
+#endif
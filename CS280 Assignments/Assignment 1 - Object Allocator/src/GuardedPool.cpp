@@ -0,0 +1,566 @@
+/************************************************************************************//*!
+\file           GuardedPool.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the GuardedPool class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "GuardedPool.h"
+// Standard Libraries
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#include <io.h>
+#else
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+// Pools the fault handler knows about. A pool that doesn't fit still works, its faults
+// just aren't explained.
+static const unsigned MAX_POOLS = 64;
+static std::atomic<GuardedPool*> pools[MAX_POOLS];
+
+static std::atomic<GuardedPool::FAULTCALLBACK> faultCallback { nullptr };
+static std::once_flag handlerInstalled;
+
+#ifndef _WIN32
+static struct sigaction previousSegv;
+static struct sigaction previousBus;
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Writes a string to stderr without allocating. Safe in a signal handler.
+
+ @param  text
+    The NUL-terminated string to write.
+*//*********************************************************************************/
+static void writeError(const char* text)
+{
+#ifdef _WIN32
+    _write(2, text, static_cast<unsigned>(strlen(text)));
+#else
+    ssize_t written = write(2, text, strlen(text));
+    (void)written;
+#endif
+}
+/********************************************************************************//*!
+ @brief  Writes an address to stderr in hex without allocating. Safe in a signal
+        handler.
+
+ @param  address
+    The address to write.
+*//*********************************************************************************/
+static void writeAddress(const void* address)
+{
+    char text[2 + 2 * sizeof(uintptr_t) + 1];
+    uintptr_t value = reinterpret_cast<uintptr_t>(address);
+
+    text[0] = '0';
+    text[1] = 'x';
+    for (size_t i = 0; i < 2 * sizeof(uintptr_t); ++i)
+    {
+        text[2 * sizeof(uintptr_t) + 1 - i] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    }
+    text[sizeof(text) - 1] = '\0';
+
+    writeError(text);
+}
+/********************************************************************************//*!
+ @brief  The default fault callback. Writes the code, object and address to stderr.
+
+ @param  code
+    The code of the fault.
+ @param  object
+    The object the fault is blamed on.
+ @param  address
+    The address that faulted.
+*//*********************************************************************************/
+static void reportFault(OAException::OA_EXCEPTION code, const void* object, const void* address)
+{
+    writeError(code == OAException::E_MULTIPLE_FREE ? "GuardedPool: E_MULTIPLE_FREE, use after free of "
+                                                    : "GuardedPool: E_CORRUPTED_BLOCK, out of bounds access next to ");
+    writeAddress(object);
+    writeError(" at ");
+    writeAddress(address);
+    writeError("\n");
+}
+/********************************************************************************//*!
+ @brief  Reports a fault if it is in a pool.
+
+ @param  address
+    The address that faulted.
+
+ @return True if the fault was in a pool and has been reported.
+*//*********************************************************************************/
+static bool handleFault(const void* address)
+{
+    OAException::OA_EXCEPTION code;
+    const void* object = nullptr;
+    if (!GuardedPool::DescribeFault(address, code, object))
+        return false;
+
+    GuardedPool::FAULTCALLBACK fn = faultCallback.load();
+    (fn ? fn : reportFault)(code, object, address);
+    return true;
+}
+
+#ifdef _WIN32
+/********************************************************************************//*!
+ @brief  Reports access violations in a pool, then lets the search go on.
+
+ @param  info
+    The exception.
+
+ @return Always EXCEPTION_CONTINUE_SEARCH.
+*//*********************************************************************************/
+static LONG CALLBACK onFault(PEXCEPTION_POINTERS info)
+{
+    if (info->ExceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION)
+    {
+        handleFault(reinterpret_cast<const void*>(info->ExceptionRecord->ExceptionInformation[1]));
+    }
+    return EXCEPTION_CONTINUE_SEARCH;
+}
+#else
+/********************************************************************************//*!
+ @brief  Puts back the default action for a signal, so the faulting instruction ends
+        the process when it runs again.
+
+ @param  signal
+    SIGSEGV or SIGBUS.
+*//*********************************************************************************/
+static void crashOnReturn(int signal)
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = SIG_DFL;
+    sigemptyset(&action.sa_mask);
+    sigaction(signal, &action, nullptr);
+}
+/********************************************************************************//*!
+ @brief  Reports faults in a pool and lets them end the process. Faults anywhere else
+        go to the handler that was installed before, which stays in charge of them,
+        so a handler that recovers from its own faults keeps working.
+
+ @param  signal
+    SIGSEGV or SIGBUS.
+ @param  info
+    Where the fault happened.
+ @param  context
+    The context of the fault, passed on to the previous handler.
+*//*********************************************************************************/
+static void onFault(int signal, siginfo_t* info, void* context)
+{
+    if (handleFault(info->si_addr))
+    {
+        crashOnReturn(signal);
+        return;
+    }
+
+    const struct sigaction& previous = signal == SIGBUS ? previousBus : previousSegv;
+    if (previous.sa_flags & SA_SIGINFO)
+    {
+        previous.sa_sigaction(signal, info, context);
+    }
+    else if (previous.sa_handler == SIG_DFL || previous.sa_handler == SIG_IGN)
+    {
+        // A fault can't be ignored, returning would only fault again
+        crashOnReturn(signal);
+    }
+    else
+    {
+        previous.sa_handler(signal);
+    }
+}
+#endif
+
+/********************************************************************************//*!
+ @brief  Installs the fault handler the first time it is called.
+*//*********************************************************************************/
+static void installFaultHandler()
+{
+    std::call_once(handlerInstalled, []()
+    {
+#ifdef _WIN32
+        AddVectoredExceptionHandler(1, onFault);
+#else
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_sigaction = onFault;
+        action.sa_flags = SA_SIGINFO;
+        sigemptyset(&action.sa_mask);
+
+        sigaction(SIGSEGV, &action, &previousSegv);
+        sigaction(SIGBUS, &action, &previousBus);
+#endif
+    });
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Creates the GuardedPool and reserves every slot and guard page.
+
+ @param  ObjectSize
+    The size of each object.
+ @param  Slots
+    The number of objects that can be guarded at once.
+ @param  Alignment
+    The alignment of each object. 0 uses the natural alignment of ObjectSize, up
+    to std::max_align_t.
+
+ @throws std::bad_alloc if the memory can't be reserved.
+*//*********************************************************************************/
+GuardedPool::GuardedPool(size_t size, unsigned count, unsigned align)
+: base          (nullptr)
+, mappedSize    (0)
+, osPageSize    (0)
+, slotSize      (0)
+, objectSize    (size)
+, alignment     (align)
+, slots         (count ? count : 1, Slot{ nullptr, false })
+, freeSlots     (slots.size())
+, freeHead      (0)
+, freeCount     (static_cast<unsigned>(slots.size()))
+, placeAtEnd    (true)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    osPageSize = info.dwPageSize;
+#else
+    osPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+    // Natural alignment: the largest power of two that divides the size
+    if (alignment <= 1)
+    {
+        alignment = objectSize & (~objectSize + 1);
+        if (alignment == 0 || alignment > alignof(std::max_align_t))
+            alignment = alignof(std::max_align_t);
+    }
+
+    slotSize = (objectSize + osPageSize - 1) / osPageSize * osPageSize;
+    if (slotSize == 0)
+        slotSize = osPageSize;
+
+    // A guard page in front of every slot, and one after the last
+    mappedSize = slots.size() * (slotSize + osPageSize) + osPageSize;
+
+#ifdef _WIN32
+    base = static_cast<unsigned char*>(VirtualAlloc(nullptr, mappedSize, MEM_RESERVE, PAGE_NOACCESS));
+    if (base == nullptr)
+        throw std::bad_alloc{};
+#else
+    void* mapped = mmap(nullptr, mappedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapped == MAP_FAILED)
+        throw std::bad_alloc{};
+    base = static_cast<unsigned char*>(mapped);
+#endif
+
+    for (unsigned i = 0; i < freeSlots.size(); ++i)
+    {
+        freeSlots[i] = i;
+    }
+
+    installFaultHandler();
+    for (std::atomic<GuardedPool*>& pool : pools)
+    {
+        GuardedPool* empty = nullptr;
+        if (pool.compare_exchange_strong(empty, this))
+            break;
+    }
+}
+
+/********************************************************************************//*!
+ @brief  Destructor for GuardedPool. Unmaps every slot.
+
+ @throws Never does.
+*//*********************************************************************************/
+GuardedPool::~GuardedPool()
+{
+    for (std::atomic<GuardedPool*>& pool : pools)
+    {
+        GuardedPool* self = this;
+        if (pool.compare_exchange_strong(self, nullptr))
+            break;
+    }
+
+#ifdef _WIN32
+    VirtualFree(base, 0, MEM_RELEASE);
+#else
+    munmap(base, mappedSize);
+#endif
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Takes the slot that has been free the longest and places an object in it.
+
+ @return The object, or a nullptr if every slot is in use.
+*//*********************************************************************************/
+void* GuardedPool::Allocate()
+{
+    if (freeCount == 0)
+        return nullptr;
+
+    const unsigned index = freeSlots[freeHead];
+    unsigned char* start = slotStart(index);
+
+#ifdef _WIN32
+    if (VirtualAlloc(start, slotSize, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+        return nullptr;
+#else
+    if (mprotect(start, slotSize, PROT_READ | PROT_WRITE) != 0)
+        return nullptr;
+#endif
+
+    freeHead = (freeHead + 1) % static_cast<unsigned>(freeSlots.size());
+    --freeCount;
+
+    // Alternate ends so both overflows and underflows hit a guard page
+    uintptr_t object = reinterpret_cast<uintptr_t>(start);
+    if (placeAtEnd)
+    {
+        object += slotSize - objectSize;
+        object &= ~(static_cast<uintptr_t>(alignment) - 1);
+    }
+    placeAtEnd = !placeAtEnd;
+
+    Slot& slot = slots[index];
+    slot.object = reinterpret_cast<unsigned char*>(object);
+    slot.inUse = true;
+
+    memset(slot.object, ObjectAllocator::ALLOCATED_PATTERN, objectSize);
+    return slot.object;
+}
+
+/********************************************************************************//*!
+ @brief  Frees an object and protects its slot.
+
+ @param  Object
+    The object to free. Must be owned by the pool.
+
+ @throws OAException with E_BAD_BOUNDARY if it isn't the object of its slot, or
+        E_MULTIPLE_FREE if the slot is already free.
+*//*********************************************************************************/
+void GuardedPool::Free(void* Object)
+{
+    unsigned char* object = static_cast<unsigned char*>(Object);
+    const size_t offset = static_cast<size_t>(object - base);
+    const unsigned index = static_cast<unsigned>(offset / (slotSize + osPageSize));
+
+    Slot& slot = slots[index < slots.size() ? index : slots.size() - 1];
+    if (slot.object != object)
+    {
+        throw OAException{OAException::E_BAD_BOUNDARY, "Object is not the start of a guarded block."};
+    }
+    if (!slot.inUse)
+    {
+        throw OAException{OAException::E_MULTIPLE_FREE, "Object has already been freed."};
+    }
+
+    // The memory goes back to the OS and any access from now on faults
+    unsigned char* start = slotStart(index);
+#ifdef _WIN32
+    VirtualFree(start, slotSize, MEM_DECOMMIT);
+#else
+    mprotect(start, slotSize, PROT_NONE);
+    madvise(start, slotSize, MADV_DONTNEED);
+#endif
+
+    slot.inUse = false;
+    freeSlots[(freeHead + freeCount) % freeSlots.size()] = index;
+    ++freeCount;
+}
+
+/********************************************************************************//*!
+ @brief  Frees every object in use and protects their slots.
+
+ @return The number of objects that were freed.
+*//*********************************************************************************/
+unsigned GuardedPool::FreeAll()
+{
+    unsigned freed = 0;
+    for (const Slot& slot : slots)
+    {
+        if (slot.inUse)
+        {
+            Free(slot.object);
+            ++freed;
+        }
+    }
+
+    return freed;
+}
+
+/********************************************************************************//*!
+ @brief  Checks if an address is within the pool. Runs in constant time.
+
+ @param  address
+    The address to check.
+
+ @return True if the address is on a slot or guard page of the pool.
+*//*********************************************************************************/
+bool GuardedPool::Owns(const void* address) const
+{
+    const unsigned char* cA = static_cast<const unsigned char*>(address);
+    return cA >= base && cA < base + mappedSize;
+}
+
+/********************************************************************************//*!
+ @brief  Calls the callback function for each object in use.
+
+ @param  fn
+    The callback function.
+
+ @return The number of objects in use.
+*//*********************************************************************************/
+unsigned GuardedPool::DumpInUse(ObjectAllocator::DUMPCALLBACK fn) const
+{
+    for (const Slot& slot : slots)
+    {
+        if (slot.inUse)
+        {
+            fn(slot.object, objectSize);
+        }
+    }
+
+    return static_cast<unsigned>(slots.size()) - freeCount;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Static Function Members                                                             */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Works out what a faulting address means for the pools that exist. Safe to
+        call from a signal handler.
+
+ @param  address
+    The address that faulted.
+ @param  code
+    Receives E_CORRUPTED_BLOCK or E_MULTIPLE_FREE.
+ @param  object
+    Receives the object the fault is blamed on.
+
+ @return True if the address is in a pool.
+*//*********************************************************************************/
+bool GuardedPool::DescribeFault(const void* address, OAException::OA_EXCEPTION& code, const void*& object)
+{
+    for (const std::atomic<GuardedPool*>& pool : pools)
+    {
+        const GuardedPool* gp = pool.load();
+        if (gp && gp->Owns(address))
+            return gp->describe(static_cast<const unsigned char*>(address), code, object);
+    }
+
+    return false;
+}
+
+/********************************************************************************//*!
+ @brief  Sets what is called when a guard page is hit. The default writes a line
+        to stderr.
+
+ @param  fn
+    The callback function, or a nullptr for the default.
+*//*********************************************************************************/
+void GuardedPool::SetFaultCallback(FAULTCALLBACK fn)
+{
+    faultCallback.store(fn);
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets the start of a slot.
+
+ @param  index
+    The index of the slot.
+
+ @return The start of the slot.
+*//*********************************************************************************/
+unsigned char* GuardedPool::slotStart(unsigned index) const
+{
+    return base + osPageSize + index * (slotSize + osPageSize);
+}
+/********************************************************************************//*!
+ @brief  Works out what a faulting address within this pool means.
+
+ @param  address
+    The address that faulted. Must be owned by the pool.
+ @param  code
+    Receives E_CORRUPTED_BLOCK or E_MULTIPLE_FREE.
+ @param  object
+    Receives the object the fault is blamed on.
+
+ @return True if the fault can be explained.
+*//*********************************************************************************/
+bool GuardedPool::describe(const unsigned char* address, OAException::OA_EXCEPTION& code, const void*& object) const
+{
+    const size_t stride = slotSize + osPageSize;
+    const size_t offset = static_cast<size_t>(address - base);
+
+    // Each stride is a guard page followed by a slot. The guard after the last slot
+    // counts as a stride of its own.
+    const size_t index = offset / stride;
+    if (offset % stride >= osPageSize)
+    {
+        const Slot& slot = slots[index];
+        if (slot.inUse)
+            return false;
+
+        code = OAException::E_MULTIPLE_FREE;
+        object = slot.object;
+        return true;
+    }
+
+    // A guard page: blame the object that ends right before it or the one that starts
+    // right after it, whichever is closer
+    const Slot* before = index > 0 ? &slots[index - 1] : nullptr;
+    const Slot* after = index < slots.size() ? &slots[index] : nullptr;
+    const bool overflow = before && before->inUse && before->object != slotStart(static_cast<unsigned>(index - 1));
+    const bool underflow = after && after->inUse && after->object == slotStart(static_cast<unsigned>(index));
+
+    if (overflow && underflow)
+    {
+        const size_t pastEnd = static_cast<size_t>(address - (before->object + objectSize));
+        const size_t beforeStart = static_cast<size_t>(after->object - address);
+        object = pastEnd < beforeStart ? before->object : after->object;
+    }
+    else if (overflow || underflow)
+    {
+        object = overflow ? before->object : after->object;
+    }
+    else
+    {
+        const Slot* nearest = before ? before : after;
+        object = nearest ? nearest->object : nullptr;
+    }
+
+    code = OAException::E_CORRUPTED_BLOCK;
+    return true;
+}
@@ -0,0 +1,213 @@
+/************************************************************************************//*!
+ \file           GuardedPool.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the GuardedPool class, which places sampled
+                 objects against protected guard pages.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef GUARDEDPOOLH
+#define GUARDEDPOOLH
+
+// Standard Libraries
+#include <cstddef>
+#include <vector>
+// Project Headers
+#include "ObjectAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  A fixed number of slots for objects, each on its own OS pages with a guard
+         page on either side that can't be read or written.
+
+         Objects alternate between the end of their slot, so an overflow faults on the
+         next guard page, and the start of it, so an underflow faults on the one
+         before. A freed slot can't be touched either and goes to the back of the
+         queue, so a use-after-free faults for as long as possible.
+
+         Faults are reported through a handler installed with the first pool. It
+         writes the OAException code of a fault in a pool and lets it end the
+         process. Faults anywhere else are passed to the handler that was there
+         before, and the handler stays installed for the life of the process.
+         Overflows and underflows are E_CORRUPTED_BLOCK and use-after-free is
+         E_MULTIPLE_FREE.
+*//*************************************************************************************/
+class GuardedPool
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    // Defined by the client (fault code, object next to the fault, faulting address).
+    // Called from a signal handler, so it may only do async-signal-safe things.
+
+    typedef void (*FAULTCALLBACK)(OAException::OA_EXCEPTION, const void *, const void *);  //!< Callback function when a guard page is hit
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the GuardedPool and reserves every slot and guard page.
+
+    @param  ObjectSize
+        The size of each object.
+    @param  Slots
+        The number of objects that can be guarded at once.
+    @param  Alignment
+        The alignment of each object. 0 uses the natural alignment of ObjectSize, up
+        to std::max_align_t.
+
+    @throws std::bad_alloc if the memory can't be reserved.
+    *//*********************************************************************************/
+    GuardedPool(size_t ObjectSize, unsigned Slots, unsigned Alignment = 0);
+
+    // Prevent copy construction and assignment
+    GuardedPool(const GuardedPool &gp) = delete;            //!< Do not implement!
+    GuardedPool &operator=(const GuardedPool &gp) = delete; //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for GuardedPool. Unmaps every slot.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~GuardedPool();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Takes the slot that has been free the longest and places an object in it.
+
+    @return The object, or a nullptr if every slot is in use.
+    *//*********************************************************************************/
+    void* Allocate();
+
+    /********************************************************************************//*!
+    @brief  Frees an object and protects its slot.
+
+    @param  Object
+        The object to free. Must be owned by the pool.
+
+    @throws OAException with E_BAD_BOUNDARY if it isn't the object of its slot, or
+            E_MULTIPLE_FREE if the slot is already free.
+    *//*********************************************************************************/
+    void Free(void* Object);
+
+    /********************************************************************************//*!
+    @brief  Frees every object in use and protects their slots.
+
+    @return The number of objects that were freed.
+    *//*********************************************************************************/
+    unsigned FreeAll();
+
+    /********************************************************************************//*!
+    @brief  Checks if an address is within the pool. Runs in constant time.
+
+    @param  address
+        The address to check.
+
+    @return True if the address is on a slot or guard page of the pool.
+    *//*********************************************************************************/
+    bool Owns(const void* address) const;
+
+    /********************************************************************************//*!
+    @brief  Calls the callback function for each object in use.
+
+    @param  fn
+        The callback function.
+
+    @return The number of objects in use.
+    *//*********************************************************************************/
+    unsigned DumpInUse(ObjectAllocator::DUMPCALLBACK fn) const;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Static Function Members                                                         */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Works out what a faulting address means for the pools that exist. Safe to
+            call from a signal handler.
+
+    @param  address
+        The address that faulted.
+    @param  code
+        Receives E_CORRUPTED_BLOCK or E_MULTIPLE_FREE.
+    @param  object
+        Receives the object the fault is blamed on.
+
+    @return True if the address is in a pool.
+    *//*********************************************************************************/
+    static bool DescribeFault(const void* address, OAException::OA_EXCEPTION& code, const void*& object);
+
+    /********************************************************************************//*!
+    @brief  Sets what is called when a guard page is hit. The default writes a line
+            to stderr.
+
+    @param  fn
+        The callback function, or a nullptr for the default.
+    *//*********************************************************************************/
+    static void SetFaultCallback(FAULTCALLBACK fn);
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  The state of a slot.
+    *//*********************************************************************************/
+    struct Slot
+    {
+        unsigned char*  object; //!< Where the object is or was last placed
+        bool            inUse;  //!< Is the object owned by the client?
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    unsigned char           *base;          //!< the start of the first guard page
+    size_t                  mappedSize;     //!< the size of every slot and guard page
+    size_t                  osPageSize;     //!< the size of a guard page
+    size_t                  slotSize;       //!< the size of a slot, a multiple of osPageSize
+    size_t                  objectSize;     //!< the size of each object
+    size_t                  alignment;      //!< the alignment of each object
+    std::vector<Slot>       slots;          //!< the state of every slot
+    std::vector<unsigned>   freeSlots;      //!< ring of free slots, longest free at the front
+    unsigned                freeHead;       //!< the front of the ring
+    unsigned                freeCount;      //!< the number of free slots
+    bool                    placeAtEnd;     //!< where the next object goes in its slot
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the start of a slot.
+
+    @param  index
+        The index of the slot.
+
+    @return The start of the slot.
+    *//*********************************************************************************/
+    unsigned char* slotStart(unsigned index) const;
+    /********************************************************************************//*!
+    @brief  Works out what a faulting address within this pool means.
+
+    @param  address
+        The address that faulted. Must be owned by the pool.
+    @param  code
+        Receives E_CORRUPTED_BLOCK or E_MULTIPLE_FREE.
+    @param  object
+        Receives the object the fault is blamed on.
+
+    @return True if the fault can be explained.
+    *//*********************************************************************************/
+    bool describe(const unsigned char* address, OAException::OA_EXCEPTION& code, const void*& object) const;
+};
+
+#endif
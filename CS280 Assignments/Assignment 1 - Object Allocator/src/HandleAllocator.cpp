@@ -0,0 +1,252 @@
+/************************************************************************************//*!
+\file           HandleAllocator.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the HandleAllocator class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "HandleAllocator.h"
+// Standard Libraries
+#include <cstring>
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets where a block keeps the index of its handle, just after the object.
+
+ @param  ObjectSize
+    The size of each object.
+
+ @return The offset of the index.
+*//*********************************************************************************/
+static size_t indexOffsetFor(size_t ObjectSize)
+{
+    return (ObjectSize + alignof(uint32_t) - 1) / alignof(uint32_t) * alignof(uint32_t);
+}
+
+/********************************************************************************//*!
+ @brief  Turns on the page free lists that compaction works with.
+
+ @param  config
+    The configuration from the client.
+
+ @return The configuration to use.
+*//*********************************************************************************/
+static OAConfig withPageFreeLists(OAConfig config)
+{
+    config.PageFreeLists_ = true;
+    return config;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Creates the HandleAllocator and the ObjectAllocator it owns.
+
+ @param  ObjectSize
+    The size of each object.
+ @param  config
+    The configuration of the ObjectAllocator. PageFreeLists_ is turned on.
+
+ @throws An exception if the construction fails.
+*//*********************************************************************************/
+HandleAllocator::HandleAllocator(size_t ObjectSize, const OAConfig& config)
+: allocator     (indexOffsetFor(ObjectSize) + sizeof(uint32_t), withPageFreeLists(config))
+, slots         ()
+, freeSlots     ()
+, indexOffset   (indexOffsetFor(ObjectSize))
+, movedObjects  (0)
+{}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Allocates an object and a handle for it.
+
+ @param  label
+    The label for external headers.
+
+ @return The handle of the object.
+
+ @throws An exception from OAException if the object can't be allocated.
+*//*********************************************************************************/
+HandleAllocator::Handle HandleAllocator::Allocate(const char *label)
+{
+    void* object = allocator.Allocate(label);
+
+    uint32_t index = 0;
+    try
+    {
+        if (freeSlots.empty())
+        {
+            index = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot{ nullptr, 0 });
+        }
+        else
+        {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+        }
+    }
+    catch(const std::bad_alloc&)
+    {
+        allocator.Free(object);
+        throw OAException{OAException::E_NO_MEMORY, "No system memory available."};
+    }
+
+    // The block remembers its handle so a move can find it
+    memcpy(static_cast<unsigned char*>(object) + indexOffset, &index, sizeof(index));
+    slots[index].object = object;
+
+    return (static_cast<Handle>(slots[index].generation) << 32) | (static_cast<Handle>(index) + 1);
+}
+
+/********************************************************************************//*!
+ @brief  Frees an object and its handle.
+
+ @param  handle
+    The handle of the object.
+
+ @throws An exception from OAException with E_MULTIPLE_FREE if the handle has already
+        been freed, E_BAD_BOUNDARY if it was never handed out, or what the
+        ObjectAllocator throws.
+*//*********************************************************************************/
+void HandleAllocator::Free(Handle handle)
+{
+    const uint32_t low = static_cast<uint32_t>(handle);
+    if (low == 0 || low > slots.size())
+    {
+        throw OAException{OAException::E_BAD_BOUNDARY, "Handle was not handed out by this allocator."};
+    }
+
+    Slot& slot = slots[low - 1];
+    if (!slotOf(handle))
+    {
+        throw OAException{OAException::E_MULTIPLE_FREE, "Handle has already been freed."};
+    }
+
+    allocator.Free(slot.object);
+
+    slot.object = nullptr;
+    ++slot.generation;
+    freeSlots.push_back(low - 1);
+}
+
+/********************************************************************************//*!
+ @brief  Gets the address of an object. It stays valid until the next Compact.
+
+ @param  handle
+    The handle of the object.
+
+ @return The address of the object, or a nullptr if the handle is stale or null.
+*//*********************************************************************************/
+void* HandleAllocator::Get(Handle handle) const
+{
+    const Slot* slot = slotOf(handle);
+    return slot ? slot->object : nullptr;
+}
+
+/********************************************************************************//*!
+ @brief  Moves objects out of the sparsest pages into the fullest ones, then frees
+        every empty page.
+
+ @param  Budget
+    The time to stop moving objects after, checked after each page. 0 means no limit.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned HandleAllocator::Compact(std::chrono::microseconds Budget)
+{
+    movedObjects += allocator.Compact(relocate, this, Budget);
+    return allocator.FreeEmptyPages();
+}
+
+/********************************************************************************//*!
+ @brief  Frees the pages with no objects in use, without moving any objects.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned HandleAllocator::FreeEmptyPages()
+{
+    return allocator.FreeEmptyPages();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the ObjectAllocator the objects come from.
+
+ @return The ObjectAllocator.
+*//*********************************************************************************/
+const ObjectAllocator& HandleAllocator::GetAllocator() const
+{
+    return allocator;
+}
+
+/********************************************************************************//*!
+ @brief  Gets the number of objects moved by Compact so far.
+
+ @return The number of objects moved.
+*//*********************************************************************************/
+unsigned long long HandleAllocator::GetMovedObjects() const
+{
+    return movedObjects;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the slot of a handle that is in use.
+
+ @param  handle
+    The handle.
+
+ @return The slot, or a nullptr if the handle is stale or null.
+*//*********************************************************************************/
+const HandleAllocator::Slot* HandleAllocator::slotOf(Handle handle) const
+{
+    const uint32_t low = static_cast<uint32_t>(handle);
+    if (low == 0 || low > slots.size())
+        return nullptr;
+
+    const Slot& slot = slots[low - 1];
+    if (slot.object == nullptr || slot.generation != static_cast<uint32_t>(handle >> 32))
+        return nullptr;
+
+    return &slot;
+}
+
+/********************************************************************************//*!
+ @brief  Points the handle of a moved object at its new address.
+
+ @param  context
+    The HandleAllocator.
+ @param  from
+    The old address of the object.
+ @param  to
+    The new address of the object.
+*//*********************************************************************************/
+void HandleAllocator::relocate(void* context, void* from, void* to)
+{
+    (void)from;
+    HandleAllocator* self = static_cast<HandleAllocator*>(context);
+
+    uint32_t index = 0;
+    memcpy(&index, static_cast<unsigned char*>(to) + self->indexOffset, sizeof(index));
+    self->slots[index].object = to;
+}
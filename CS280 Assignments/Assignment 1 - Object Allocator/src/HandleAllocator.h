@@ -0,0 +1,194 @@
+/************************************************************************************//*!
+ \file           HandleAllocator.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the HandleAllocator class, an ObjectAllocator
+                 that hands out handles so its objects can be moved to compact pages.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef HANDLEALLOCATORH
+#define HANDLEALLOCATORH
+
+// Standard Libraries
+#include <chrono>
+#include <cstdint>
+#include <vector>
+// Project Headers
+#include "ObjectAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  An ObjectAllocator whose objects are reached through handles, so they can be
+         moved. Compact moves the objects out of sparse pages into dense ones and frees
+         the pages it empties, which FreeEmptyPages alone can't do while a few objects
+         stay on every page.
+
+         A handle is an index into a table of addresses, with a generation that
+         changes whenever its slot is freed, so a stale handle is never mistaken for a
+         new one. Each block keeps the index of its handle after the object, so a
+         moved object finds its handle in constant time. Addresses from Get are only
+         valid until the next Compact.
+
+         PageFreeLists_ is always turned on, as compaction works page by page. Not
+         thread-safe.
+*//*************************************************************************************/
+class HandleAllocator
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    typedef uint64_t Handle;    //!< The generation in the high half and the index + 1 in the low half
+
+    /*---------------------------------------------------------------------------------*/
+    /* Static Data Members                                                             */
+    /*---------------------------------------------------------------------------------*/
+    static const Handle NULL_HANDLE = 0;    //!< Never refers to an object
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the HandleAllocator and the ObjectAllocator it owns.
+
+    @param  ObjectSize
+        The size of each object.
+    @param  config
+        The configuration of the ObjectAllocator. PageFreeLists_ is turned on.
+
+    @throws An exception if the construction fails.
+    *//*********************************************************************************/
+    HandleAllocator(size_t ObjectSize, const OAConfig& config);
+
+    // Prevent copy construction and assignment
+    HandleAllocator(const HandleAllocator &ha) = delete;            //!< Do not implement!
+    HandleAllocator &operator=(const HandleAllocator &ha) = delete; //!< Do not implement!
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Allocates an object and a handle for it.
+
+    @param  label
+        The label for external headers.
+
+    @return The handle of the object.
+
+    @throws An exception from OAException if the object can't be allocated.
+    *//*********************************************************************************/
+    Handle Allocate(const char *label = 0);
+
+    /********************************************************************************//*!
+    @brief  Frees an object and its handle.
+
+    @param  handle
+        The handle of the object.
+
+    @throws An exception from OAException with E_MULTIPLE_FREE if the handle has
+            already been freed, E_BAD_BOUNDARY if it was never handed out, or what
+            the ObjectAllocator throws.
+    *//*********************************************************************************/
+    void Free(Handle handle);
+
+    /********************************************************************************//*!
+    @brief  Gets the address of an object. It stays valid until the next Compact.
+
+    @param  handle
+        The handle of the object.
+
+    @return The address of the object, or a nullptr if the handle is stale or null.
+    *//*********************************************************************************/
+    void* Get(Handle handle) const;
+
+    /********************************************************************************//*!
+    @brief  Moves objects out of the sparsest pages into the fullest ones, then frees
+            every empty page.
+
+    @param  Budget
+        The time to stop moving objects after, checked after each page. 0 means no
+        limit.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned Compact(std::chrono::microseconds Budget);
+
+    /********************************************************************************//*!
+    @brief  Frees the pages with no objects in use, without moving any objects.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned FreeEmptyPages();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the ObjectAllocator the objects come from.
+
+    @return The ObjectAllocator.
+    *//*********************************************************************************/
+    const ObjectAllocator& GetAllocator() const;
+    /********************************************************************************//*!
+    @brief  Gets the number of objects moved by Compact so far.
+
+    @return The number of objects moved.
+    *//*********************************************************************************/
+    unsigned long long GetMovedObjects() const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  An entry of the handle table.
+    *//*********************************************************************************/
+    struct Slot
+    {
+        void*       object;     //!< The object, or a nullptr while the slot is free
+        uint32_t    generation; //!< Changes every time the slot is freed
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    ObjectAllocator         allocator;      //!< where the objects live
+    std::vector<Slot>       slots;          //!< the handle table
+    std::vector<uint32_t>   freeSlots;      //!< the slots not in use
+    size_t                  indexOffset;    //!< where a block keeps the index of its handle
+    unsigned long long      movedObjects;   //!< objects moved by Compact so far
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the slot of a handle that is in use.
+
+    @param  handle
+        The handle.
+
+    @return The slot, or a nullptr if the handle is stale or null.
+    *//*********************************************************************************/
+    const Slot* slotOf(Handle handle) const;
+    /********************************************************************************//*!
+    @brief  Points the handle of a moved object at its new address.
+
+    @param  context
+        The HandleAllocator.
+    @param  from
+        The old address of the object.
+    @param  to
+        The new address of the object.
+    *//*********************************************************************************/
+    static void relocate(void* context, void* from, void* to);
+};
+
+#endif
@@ -0,0 +1,271 @@
+/************************************************************************************//*!
+\file           OATelemetry.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the latency histograms and the exporters
+                of the telemetry snapshot.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "OATelemetry.h"
+// Standard Libraries
+#include <sstream>
+#include <cstring>
+#include <cstdio>
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+static const char* OCCUPANCY_NAMES[OATelemetry::OCCUPANCY_BUCKETS] =
+{
+    "empty", "10%", "20%", "30%", "40%", "50%", "60%", "70%", "80%", "90%", "100%"
+};
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Writes a string as a JSON string, escaping what JSON requires.
+
+ @param  os
+    The stream to write to.
+ @param  text
+    The string to write.
+*//*********************************************************************************/
+static void writeJSONString(std::ostream& os, const std::string& text)
+{
+    os << '"';
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+            os << escaped;
+        }
+        else
+        {
+            os << c;
+        }
+    }
+    os << '"';
+}
+/********************************************************************************//*!
+ @brief  Writes a one line summary of a histogram.
+
+ @param  os
+    The stream to write to.
+ @param  name
+    The name of the operation.
+ @param  histogram
+    The histogram to summarise.
+*//*********************************************************************************/
+static void writeText(std::ostream& os, const char* name, const OALatencyHistogram& histogram)
+{
+    os << name << ": " << histogram.Count_ << " ops";
+    if (histogram.Count_)
+    {
+        os << ", mean " << histogram.Mean() << " ns"
+           << ", p50 <= " << histogram.Percentile(0.5) << " ns"
+           << ", p99 <= " << histogram.Percentile(0.99) << " ns"
+           << ", max " << histogram.MaxNs_ << " ns";
+    }
+    os << '\n';
+}
+/********************************************************************************//*!
+ @brief  Writes a histogram as a JSON object.
+
+ @param  os
+    The stream to write to.
+ @param  histogram
+    The histogram to write.
+*//*********************************************************************************/
+static void writeJSON(std::ostream& os, const OALatencyHistogram& histogram)
+{
+    os << "{\"count\":" << histogram.Count_
+       << ",\"meanNs\":" << histogram.Mean()
+       << ",\"p50Ns\":" << histogram.Percentile(0.5)
+       << ",\"p99Ns\":" << histogram.Percentile(0.99)
+       << ",\"maxNs\":" << histogram.MaxNs_
+       << ",\"buckets\":[";
+
+    // Trailing empty buckets are left out, bucket i starts at 2^i ns
+    unsigned used = OALatencyHistogram::BUCKETS;
+    while (used > 0 && histogram.Counts_[used - 1] == 0)
+    {
+        --used;
+    }
+    for (unsigned i = 0; i < used; ++i)
+    {
+        os << (i ? "," : "") << histogram.Counts_[i];
+    }
+    os << "]}";
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* OALatencyHistogram                                                                  */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Default constructor for OALatencyHistogram
+*//*********************************************************************************/
+OALatencyHistogram::OALatencyHistogram()
+: Count_    (0)
+, TotalNs_  (0)
+, MaxNs_    (0)
+{
+    memset(Counts_, 0, sizeof(Counts_));
+}
+/********************************************************************************//*!
+ @brief  Records a number of operations that each took the same time.
+
+ @param  ns
+    The nanoseconds each operation took.
+ @param  count
+    The number of operations.
+*//*********************************************************************************/
+void OALatencyHistogram::Record(unsigned long long ns, unsigned count)
+{
+    unsigned bucket = 0;
+    while (bucket < BUCKETS - 1 && (ns >> (bucket + 1)) != 0)
+    {
+        ++bucket;
+    }
+
+    Counts_[bucket] += count;
+    Count_ += count;
+    TotalNs_ += ns * count;
+    MaxNs_ = ns > MaxNs_ ? ns : MaxNs_;
+}
+/********************************************************************************//*!
+ @brief  Gets an upper bound on a percentile.
+
+ @param  fraction
+    The percentile as a fraction, such as 0.99.
+
+ @return The top of the bucket the percentile falls in, in nanoseconds. 0 if nothing
+        was recorded.
+*//*********************************************************************************/
+unsigned long long OALatencyHistogram::Percentile(double fraction) const
+{
+    if (Count_ == 0)
+        return 0;
+
+    // The rank of the operation at the percentile, counting from 1
+    unsigned long long rank = static_cast<unsigned long long>(fraction * static_cast<double>(Count_) + 0.5);
+    rank = rank == 0 ? 1 : (rank > Count_ ? Count_ : rank);
+
+    unsigned long long seen = 0;
+    for (unsigned i = 0; i < BUCKETS; ++i)
+    {
+        seen += Counts_[i];
+        if (seen >= rank)
+        {
+            // The slowest operation is a tighter bound for the last bucket in use
+            const unsigned long long top = (1ULL << (i + 1)) - 1;
+            return top < MaxNs_ ? top : MaxNs_;
+        }
+    }
+
+    return MaxNs_;
+}
+/********************************************************************************//*!
+ @brief  Gets the mean.
+
+ @return The mean in nanoseconds. 0 if nothing was recorded.
+*//*********************************************************************************/
+double OALatencyHistogram::Mean() const
+{
+    return Count_ ? static_cast<double>(TotalNs_) / static_cast<double>(Count_) : 0.0;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* OATelemetry                                                                         */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Default constructor for OATelemetry
+*//*********************************************************************************/
+OATelemetry::OATelemetry()
+: ObjectSize_   (0)
+, ObjectsInUse_ (0)
+, PagesInUse_   (0)
+{
+    memset(PageOccupancy_, 0, sizeof(PageOccupancy_));
+}
+/********************************************************************************//*!
+ @brief  Formats the snapshot for people to read.
+
+ @return The snapshot as lines of text.
+*//*********************************************************************************/
+std::string OATelemetry::ToText() const
+{
+    std::ostringstream os;
+    os << "Objects: " << ObjectsInUse_ << " in use of " << ObjectSize_ << " bytes, on " << PagesInUse_ << " pages\n";
+
+    writeText(os, "Allocate", Allocate_);
+    writeText(os, "Free", Free_);
+    writeText(os, "CreatePage", CreatePage_);
+
+    os << "Page occupancy:";
+    for (unsigned i = 0; i < OCCUPANCY_BUCKETS; ++i)
+    {
+        os << ' ' << OCCUPANCY_NAMES[i] << '=' << PageOccupancy_[i];
+    }
+    os << '\n';
+
+    for (const Label& label : Labels_)
+    {
+        os << "Label \"" << label.Name_ << "\": " << label.Stats_.Allocations_ << " allocations, "
+           << label.Stats_.LiveObjects_ << " live, " << label.Stats_.LiveBytes_ << " bytes\n";
+    }
+
+    return os.str();
+}
+/********************************************************************************//*!
+ @brief  Formats the snapshot for tools to read.
+
+ @return The snapshot as a JSON object.
+*//*********************************************************************************/
+std::string OATelemetry::ToJSON() const
+{
+    std::ostringstream os;
+    os << "{\"objectSize\":" << ObjectSize_
+       << ",\"objectsInUse\":" << ObjectsInUse_
+       << ",\"pagesInUse\":" << PagesInUse_;
+
+    os << ",\"allocate\":";
+    writeJSON(os, Allocate_);
+    os << ",\"free\":";
+    writeJSON(os, Free_);
+    os << ",\"createPage\":";
+    writeJSON(os, CreatePage_);
+
+    os << ",\"pageOccupancy\":[";
+    for (unsigned i = 0; i < OCCUPANCY_BUCKETS; ++i)
+    {
+        os << (i ? "," : "") << PageOccupancy_[i];
+    }
+    os << "]";
+
+    os << ",\"labels\":[";
+    for (size_t i = 0; i < Labels_.size(); ++i)
+    {
+        os << (i ? "," : "") << "{\"name\":";
+        writeJSONString(os, Labels_[i].Name_);
+        os << ",\"allocations\":" << Labels_[i].Stats_.Allocations_
+           << ",\"liveObjects\":" << Labels_[i].Stats_.LiveObjects_
+           << ",\"liveBytes\":" << Labels_[i].Stats_.LiveBytes_ << "}";
+    }
+    os << "]}";
+
+    return os.str();
+}
@@ -0,0 +1,171 @@
+/************************************************************************************//*!
+ \file           OATelemetry.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the latency histograms, label counters and the snapshot that an
+                 ObjectAllocator reports when telemetry is on.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef OATELEMETRYH
+#define OATELEMETRYH
+
+// Standard Libraries
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  Counts how long an operation took in power-of-two buckets of nanoseconds.
+         Recording is a handful of adds and never allocates.
+*//*************************************************************************************/
+struct OALatencyHistogram
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Static Data Members                                                             */
+    /*---------------------------------------------------------------------------------*/
+    static const unsigned BUCKETS = 32;    //!< bucket i holds [2^i, 2^(i+1)) ns, bucket 0 also holds 0
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /****************************************************************************//*!
+    @brief  Default constructor for OALatencyHistogram
+    *//*****************************************************************************/
+    OALatencyHistogram();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Records a number of operations that each took the same time.
+
+    @param  ns
+        The nanoseconds each operation took.
+    @param  count
+        The number of operations. Defaults to 1.
+    *//*********************************************************************************/
+    void Record(unsigned long long ns, unsigned count = 1);
+
+    /********************************************************************************//*!
+    @brief  Gets an upper bound on a percentile.
+
+    @param  fraction
+        The percentile as a fraction, such as 0.99.
+
+    @return The top of the bucket the percentile falls in, in nanoseconds. 0 if
+            nothing was recorded.
+    *//*********************************************************************************/
+    unsigned long long Percentile(double fraction) const;
+
+    /********************************************************************************//*!
+    @brief  Gets the mean.
+
+    @return The mean in nanoseconds. 0 if nothing was recorded.
+    *//*********************************************************************************/
+    double Mean() const;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    unsigned long long  Counts_[BUCKETS];   //!< operations in each bucket
+    unsigned long long  Count_;             //!< operations recorded
+    unsigned long long  TotalNs_;           //!< time of every operation together
+    unsigned long long  MaxNs_;             //!< the slowest operation
+};
+
+/************************************************************************************//*!
+ @brief  Counters for the objects allocated with one label.
+*//*************************************************************************************/
+struct OALabelStats
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /****************************************************************************//*!
+    @brief  Default constructor for OALabelStats
+    *//*****************************************************************************/
+    OALabelStats()
+    : Allocations_  (0)
+    , LiveObjects_  (0)
+    , LiveBytes_    (0)
+    {};
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    unsigned long long  Allocations_;   //!< total requests with this label
+    unsigned            LiveObjects_;   //!< objects with this label in use (hbExternal only)
+    size_t              LiveBytes_;     //!< bytes of those objects (hbExternal only)
+};
+
+/************************************************************************************//*!
+ @brief  A snapshot of the telemetry of an ObjectAllocator.
+*//*************************************************************************************/
+struct OATelemetry
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Static Data Members                                                             */
+    /*---------------------------------------------------------------------------------*/
+    static const unsigned OCCUPANCY_BUCKETS = 11;  //!< empty, then up to 10%, 20%, ... 100% in use
+    static const unsigned TIMING_INTERVAL   = 16;  //!< one in this many Allocate and Free calls is timed
+
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  The counters of one label.
+    *//*********************************************************************************/
+    struct Label
+    {
+        std::string     Name_;      //!< the label, empty for objects without one
+        OALabelStats    Stats_;     //!< the counters
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /****************************************************************************//*!
+    @brief  Default constructor for OATelemetry
+    *//*****************************************************************************/
+    OATelemetry();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Formats the snapshot for people to read.
+
+    @return The snapshot as lines of text.
+    *//*********************************************************************************/
+    std::string ToText() const;
+
+    /********************************************************************************//*!
+    @brief  Formats the snapshot for tools to read.
+
+    @return The snapshot as a JSON object.
+    *//*********************************************************************************/
+    std::string ToJSON() const;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    OALatencyHistogram  Allocate_;                          //!< time per timed Allocate, and per object of AllocateBatch
+    OALatencyHistogram  Free_;                              //!< time per timed Free, and per object of FreeBatch
+    OALatencyHistogram  CreatePage_;                        //!< time per page created
+    std::vector<Label>  Labels_;                            //!< every label seen, by most allocations
+    unsigned            PageOccupancy_[OCCUPANCY_BUCKETS];  //!< pages by the share of their blocks in use
+    size_t              ObjectSize_;                        //!< size of each object
+    unsigned            ObjectsInUse_;                      //!< number of objects in use by client
+    unsigned            PagesInUse_;                        //!< number of pages allocated
+};
+
+#endif
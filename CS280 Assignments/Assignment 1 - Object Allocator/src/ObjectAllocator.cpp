@@ -12,9 +12,39 @@ consent of DigiPen Institute of Technology is prohibited.
 
 // Primary Header
 #include "ObjectAllocator.h"
+// Project Headers
+#include "PageProvider.h"
+#include "GuardedPool.h"
 // Standard Libraries
 #include <iostream>
 #include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <system_error>
+#ifdef _WIN32
+#include <malloc.h>
+#include <intrin.h>
+#include <Windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define OA_HAVE_BACKTRACE
+#endif
+// Wide compares for pattern validation, picked by what the compiler targets
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define OA_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OA_SIMD_SSE2
+#endif
 
 #define PTR_SIZE sizeof(unsigned char*)
 
@@ -23,6 +53,55 @@ consent of DigiPen Institute of Technology is prohibited.
 
 #define MAX(x, y) x > y ? x : y
 
+// Bits of the flag byte in basic and extended headers
+#define HEADER_IN_USE   0x1
+#define HEADER_SAMPLED  0x2
+
+// Smallest memory page of the systems we run on, the stride for prefaulting
+#define PREFAULT_STRIDE 4096
+
+// Scans a page must be found empty by before ReclaimIdlePages frees it, and the mark
+// it gets once it is picked
+#define IDLE_SCANS      2
+#define RECLAIM_MARK    0xFFFFFFFFu
+
+// The end of a free list linked by 16-bit or 32-bit indexes, never a block index
+#define INDEX_END16     0xFFFFu
+#define INDEX_END32     0xFFFFFFFFu
+
+typedef std::chrono::steady_clock TelemetryClock;
+
+/********************************************************************************//*!
+ @brief  Finds the lowest bit that is clear in a byte.
+
+ @param  bits
+    The byte to search. Must have a clear bit.
+
+ @return The index of the lowest clear bit.
+*//*********************************************************************************/
+static unsigned lowestClearBit(unsigned char bits)
+{
+#ifdef _MSC_VER
+    unsigned long index = 0;
+    _BitScanForward(&index, ~bits & 0xFFu);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(~bits & 0xFFu));
+#endif
+}
+/********************************************************************************//*!
+ @brief  Gets the time since a point in time.
+
+ @param  start
+    The point in time.
+
+ @return The nanoseconds since start.
+*//*********************************************************************************/
+static unsigned long long elapsedNs(TelemetryClock::time_point start)
+{
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(TelemetryClock::now() - start).count());
+}
+
 /*-------------------------------------------------------------------------------------*/
 /* Constructors & Destructors                                                          */
 /*-------------------------------------------------------------------------------------*/
@@ -31,7 +110,8 @@ consent of DigiPen Institute of Technology is prohibited.
  @brief  Creates the ObjectAllocator per the specified values
 
  @param  ObjectSize
-        The size of each object in a block.
+        The size of each object in a block. A size smaller than the link a free block
+        holds is rounded up to it.
  @param  config
         The configuration properties for the allocator.
 
@@ -43,7 +123,39 @@ ObjectAllocator::ObjectAllocator(size_t objectSize, const OAConfig& c)
 , config        (c)
 , stats         ()
 , blockSize     (0)
+, infoSize      (0)
+, linkSize      (PTR_SIZE)
+, pageSpan      (0)
+, maxPageSpan   (0)
+, nextObjects   (c.ObjectsPerPage_)
+, partialPages  (nullptr)
+, emptyPages    (nullptr)
+, freeInfos     (nullptr)
+, infoCapacity  (0)
+, sampleCountdown (1)
+, sampleState   (1)
+, allocateTimer (1)
+, freeTimer     (1)
 {
+    // Bitmaps find free blocks through the page lists, so free blocks hold no link.
+    // Indexes are relative to a page, so they need the page lists too.
+    if (config.BitmapTracking_)
+    {
+        config.PageFreeLists_ = true;
+        linkSize = 0;
+    }
+    else if (config.IndexedLinks_)
+    {
+        config.PageFreeLists_ = true;
+        linkSize = (MAX(c.MaxObjectsPerPage_, c.ObjectsPerPage_)) < INDEX_END16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // A free block has to hold its link
+    if (!config.UseCPPMemManager_ && objectSize < linkSize)
+    {
+        objectSize = linkSize;
+    }
+
     // Populate stats
     stats.ObjectSize_ = objectSize;
 
@@ -58,15 +170,45 @@ ObjectAllocator::ObjectAllocator(size_t objectSize, const OAConfig& c)
     blockSize += c.HBlockInfo_.size_ ;          // Add header
     blockSize += config.InterAlignSize_;        // Add alignment
     
-    stats.PageSize_ = PTR_SIZE;
-    stats.PageSize_ += config.LeftAlignSize_;
-    stats.PageSize_ += blockSize * c.ObjectsPerPage_;
-    // Remove one interAlignment
-    stats.PageSize_ -= config.InterAlignSize_;
+    stats.PageSize_ = pageSizeFor(c.ObjectsPerPage_);
+
+    // Growing pages never shrink below the configured size
+    if (config.MaxObjectsPerPage_ < c.ObjectsPerPage_)
+        config.MaxObjectsPerPage_ = c.ObjectsPerPage_;
+
+    // The allocation and sample bitmaps, then PageInfo, sit in front of each page. PageInfo
+    // is right before the page so it is found without knowing how big the bitmaps are.
+    const size_t maxAlign = alignof(std::max_align_t);
+    infoSize = (sizeof(PageInfo) + maxAlign - 1) / maxAlign * maxAlign;
+
+    // Seed the gaps so allocators don't all pick the same allocations
+    if (config.DebugSampleRate_ > 1)
+    {
+        sampleState = std::random_device{}() | 1u;
+        sampleCountdown = 1 + (sampleState >> 1) % config.DebugSampleRate_;
+    }
+
+    if (config.AlignPages_)
+    {
+        pageSpan = pageSpanFor(c.ObjectsPerPage_);
+        maxPageSpan = pageSpanFor(config.MaxObjectsPerPage_);
+    }
 
     if (config.UseCPPMemManager_)
         return;
 
+    if (config.GuardedSlots_)
+    {
+        try
+        {
+            guarded.reset(new GuardedPool{ objectSize, config.GuardedSlots_, config.Alignment_ });
+        }
+        catch(const std::bad_alloc&)
+        {
+            throw OAException {OAException::E_NO_MEMORY, "No system memory available."};
+        }
+    }
+
     createPage();
 }
 
@@ -80,9 +222,14 @@ ObjectAllocator::~ObjectAllocator()
     while(PageList_ != nullptr)
     {
         GenericObject* next = PageList_->Next;
-        delete[] TO_UCHAR_PTR(PageList_);
+        releasePage(PageList_);
         PageList_ = next;
     }
+
+    for (MemBlockInfo* chunk : infoChunks)
+    {
+        delete[] chunk;
+    }
 }
 
 /*-------------------------------------------------------------------------------------*/
@@ -101,36 +248,78 @@ ObjectAllocator::~ObjectAllocator()
 *//*********************************************************************************/
 void* ObjectAllocator::Allocate(const char* label)
 {
-    if (config.UseCPPMemManager_)
+    // Telemetry costs nothing more than this branch while it is off
+    if (!config.Telemetry_)
+        return allocateObject(label);
+
+    void* obj = nullptr;
+    if (--allocateTimer == 0)
     {
-        try
-        {
-            unsigned char* obj = new unsigned char[stats.ObjectSize_];
-            ++stats.Allocations_;
-            ++stats.ObjectsInUse_;
-            stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
-            return obj;
-        }
-        catch(const std::bad_alloc&)
-        {
-            throw OAException{OAException::E_NO_MEMORY, "No physical memory left."};
-        }
+        allocateTimer = OATelemetry::TIMING_INTERVAL;
+        const TelemetryClock::time_point start = TelemetryClock::now();
+        obj = allocateObject(label);
+        allocateTimes.Record(elapsedNs(start));
+    }
+    else
+    {
+        obj = allocateObject(label);
     }
 
-    // Take block from free list
-    if (FreeList_ == nullptr)
+    // Guarded blocks and new/delete have no external header to keep the label
+    const bool live = config.HBlockInfo_.type_ == OAConfig::hbExternal && !config.UseCPPMemManager_ && !(guarded && guarded->Owns(obj));
+    if (countLabel(label, 1, live ? 1 : 0) && live)
     {
-        createPage();
+        markCounted(obj);
     }
+    return obj;
+}
 
-    unsigned char* obj = TO_UCHAR_PTR(FreeList_);
-    FreeList_ = FreeList_->Next;
+/********************************************************************************//*!
+ @brief  Takes a number of objects from the free list and gives them to the client.
+        Pages that are needed are created up front, and the stats are updated once.
 
-    setPattern(obj, ALLOCATED_PATTERN);
-    incrementStats();
-    createHeader(obj, label);
+ @param  count
+    The number of objects to allocate.
+ @param  objects
+    Receives the allocated objects. Must have room for count pointers.
+ @param  label
+    The label for external headers.
 
-    return obj;
+ @throws An exception from OAException if the objects can't be allocated. No objects
+        are allocated in that case.
+*//*********************************************************************************/
+void ObjectAllocator::AllocateBatch(unsigned count, void** objects, const char* label)
+{
+    if (!config.Telemetry_ || count == 0)
+    {
+        allocateObjects(count, objects, label);
+        return;
+    }
+
+    const TelemetryClock::time_point start = TelemetryClock::now();
+    allocateObjects(count, objects, label);
+    allocateTimes.Record(elapsedNs(start) / count, count);
+
+    // Guarded blocks and new/delete have no external header to keep the label
+    unsigned live = 0;
+    if (config.HBlockInfo_.type_ == OAConfig::hbExternal && !config.UseCPPMemManager_)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            live += guarded && guarded->Owns(objects[i]) ? 0 : 1;
+        }
+    }
+
+    if (countLabel(label, count, live) && live)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            if (!(guarded && guarded->Owns(objects[i])))
+            {
+                markCounted(objects[i]);
+            }
+        }
+    }
 }
 
 /********************************************************************************//*!
@@ -143,33 +332,48 @@ void* ObjectAllocator::Allocate(const char* label)
 *//*********************************************************************************/
 void ObjectAllocator::Free(void* Object)
 {
-    if (config.UseCPPMemManager_)
+    if (!config.Telemetry_ || --freeTimer != 0)
     {
-        delete[] TO_UCHAR_PTR(Object);
-
-        ++stats.Deallocations_;
-        --stats.ObjectsInUse_;
-
+        freeObject(Object);
         return;
     }
 
-    checkForInvalidFree(Object);
+    freeTimer = OATelemetry::TIMING_INTERVAL;
+    const TelemetryClock::time_point start = TelemetryClock::now();
+    freeObject(Object);
+    freeTimes.Record(elapsedNs(start));
+}
 
-    GenericObject* temp = TO_GENERIC_OBJECT_PTR(Object);
-    temp->Next = FreeList_;
-    FreeList_ = temp;
+/********************************************************************************//*!
+ @brief  Returns a number of objects to the free list for the client. The stats are
+        updated once.
 
-    unsigned char* cFL = TO_UCHAR_PTR(FreeList_);
-    setPattern(cFL, FREED_PATTERN);
-    destroyHeader(cFL);
+ @param  objects
+    The objects to return to the free list.
+ @param  count
+    The number of objects.
 
-    decrementStats();
+ @throws An exception from OAException if an object can't be freed. The objects
+        before it have been freed in that case.
+*//*********************************************************************************/
+void ObjectAllocator::FreeBatch(void** objects, unsigned count)
+{
+    if (!config.Telemetry_ || count == 0)
+    {
+        freeObjects(objects, count);
+        return;
+    }
+
+    const TelemetryClock::time_point start = TelemetryClock::now();
+    freeObjects(objects, count);
+    freeTimes.Record(elapsedNs(start) / count, count);
 }
 
 /********************************************************************************//*!
  @brief  Calls the callback function for each block still in use.
         Returns the number of blocks in use by the client.
 
+
  @param  fn
     The callback function for dumping the memory in use.
 
@@ -177,15 +381,26 @@ void ObjectAllocator::Free(void* Object)
 *//*********************************************************************************/
 unsigned ObjectAllocator::DumpMemoryInUse(DUMPCALLBACK fn) const
 {
-    if (config.HBlockInfo_.type_ == OAConfig::hbNone)
+    if (config.HBlockInfo_.type_ == OAConfig::hbNone && !config.BitmapTracking_)
+        return stats.ObjectsInUse_;
+
+    if (guarded)
+    {
+        guarded->DumpInUse(fn);
+    }
+
+    if (config.BitmapTracking_)
+    {
+        dumpFromBitmaps(fn);
         return stats.ObjectsInUse_;
+    }
 
     // Traverse pages
     GenericObject* page = PageList_;
     for (size_t i = 0; i < stats.PagesInUse_; ++i)
     {
         unsigned char* block = firstBlock(page);
-        for (size_t j = 0; j < config.ObjectsPerPage_; ++j)
+        for (size_t j = 0; j < pageInfo(page)->objects; ++j)
         {
             switch (config.HBlockInfo_.type_)
             {
@@ -194,7 +409,7 @@ unsigned ObjectAllocator::DumpMemoryInUse(DUMPCALLBACK fn) const
                 {
                     // Check flag for each header
                     unsigned char* flag = block - config.PadBytes_ - sizeof(char);
-                    if (*flag)
+                    if (*flag & HEADER_IN_USE)
                     {
                         fn(block, stats.ObjectSize_);
                     }
@@ -220,27 +435,145 @@ unsigned ObjectAllocator::DumpMemoryInUse(DUMPCALLBACK fn) const
     return stats.ObjectsInUse_;
 }
 
+/********************************************************************************//*!
+ @brief  Like DumpMemoryInUse, but the pages are split between worker threads.
+
+ @param  fn
+    The callback function for dumping the memory in use.
+ @param  threads
+    The number of threads to walk the pages with, including the calling thread. 0
+    uses one per hardware thread.
+
+ @return Returns the number of blocks in use by the client.
+
+ @throws std::bad_alloc if there is no memory left for the buffers.
+*//*********************************************************************************/
+unsigned ObjectAllocator::DumpMemoryInUseParallel(DUMPCALLBACK fn, unsigned threads) const
+{
+    if (config.HBlockInfo_.type_ == OAConfig::hbNone && !config.BitmapTracking_)
+        return stats.ObjectsInUse_;
+
+    if (guarded)
+    {
+        guarded->DumpInUse(fn);
+    }
+
+    findBlocksParallel(threads, [this](GenericObject* page, unsigned char* block)
+    {
+        return isBlockAllocated(page, block);
+    }, fn);
+
+    return stats.ObjectsInUse_;
+}
+
+/********************************************************************************//*!
+ @brief  Groups the blocks still in use by where they were allocated.
+
+ @return The sites, by most bytes in use.
+
+ @throws std::bad_alloc if there is no memory left for the report.
+*//*********************************************************************************/
+std::vector<OALeakSite> ObjectAllocator::GetLeakReport() const
+{
+    std::vector<OALeakSite> sites;
+    std::map<std::pair<const char*, const void*>, size_t> siteIndex;
+    unsigned attributed = 0;
+
+    // Labels and stacks are interned, so their addresses tell sites apart
+    const OAConfig::HBLOCK_TYPE type = config.HBlockInfo_.type_;
+    if (!config.UseCPPMemManager_ && type != OAConfig::hbNone)
+    {
+        for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+        {
+            unsigned char* block = firstBlock(page);
+            for (unsigned j = 0; j < pageInfo(page)->objects; ++j, block += blockSize)
+            {
+                if (!isBlockAllocated(page, block))
+                    continue;
+
+                const char* label = nullptr;
+                const std::vector<void*>* stack = nullptr;
+                unsigned allocNum = 0;
+                if (type == OAConfig::hbExternal)
+                {
+                    const MemBlockInfo* info = *reinterpret_cast<MemBlockInfo**>(header(block));
+                    label = info->label;
+                    stack = info->stack;
+                    allocNum = info->alloc_num;
+                }
+                else
+                {
+                    memcpy(&allocNum, block - config.PadBytes_ - sizeof(char) - sizeof(unsigned), sizeof(unsigned));
+                }
+
+                auto found = siteIndex.emplace(std::make_pair(label, static_cast<const void*>(stack)), sites.size());
+                if (found.second)
+                {
+                    sites.emplace_back();
+                    sites.back().Label_ = label ? label : "";
+                    sites.back().Stack_ = stack ? *stack : std::vector<void*>();
+                    sites.back().OldestAllocation_ = allocNum;
+                }
+
+                OALeakSite& site = sites[found.first->second];
+                ++site.Objects_;
+                site.Bytes_ += stats.ObjectSize_;
+                site.OldestAllocation_ = allocNum < site.OldestAllocation_ ? allocNum : site.OldestAllocation_;
+                ++attributed;
+            }
+        }
+    }
+
+    // Blocks with nothing to tell them apart share one site, whose age is then unknown
+    if (stats.ObjectsInUse_ > attributed)
+    {
+        auto found = siteIndex.emplace(std::make_pair(nullptr, nullptr), sites.size());
+        if (found.second)
+        {
+            sites.emplace_back();
+        }
+
+        OALeakSite& site = sites[found.first->second];
+        site.Objects_ += stats.ObjectsInUse_ - attributed;
+        site.Bytes_ += (stats.ObjectsInUse_ - attributed) * stats.ObjectSize_;
+        site.OldestAllocation_ = 0;
+    }
+
+    std::sort(sites.begin(), sites.end(), [](const OALeakSite& lhs, const OALeakSite& rhs)
+    {
+        return lhs.Bytes_ > rhs.Bytes_;
+    });
+    return sites;
+}
+
 /********************************************************************************//*!
  @brief  Calls the callback fn for each block that is potentially corrupted.
 
  @param  fn
     The callback function for dumping the memory in use.
+ @param  checkFreed
+    Also reports free blocks whose FREED_PATTERN or UNALLOCATED_PATTERN has been
+    overwritten. Only done while debugging, and only for sampled blocks while
+    sampling. Defaults to false.
 
- @return Returns the number of blocks that are corrupted. Only pad bytes are validated.
+ @return Returns the number of blocks that are corrupted.
 *//*********************************************************************************/
-unsigned ObjectAllocator::ValidatePages(VALIDATECALLBACK fn) const
+unsigned ObjectAllocator::ValidatePages(VALIDATECALLBACK fn, bool checkFreed) const
 {
     unsigned int numCorrupted = 0;
 
+    // Patterns are only written while debugging
+    checkFreed = checkFreed && config.DebugOn_;
+
     // Traverse pages
     GenericObject* page = PageList_;
     for (size_t i = 0; i < stats.PagesInUse_; ++i)
     {
         unsigned char* block = firstBlock(page);
-        for (size_t j = 0; j < config.ObjectsPerPage_; ++j)
+        for (size_t j = 0; j < pageInfo(page)->objects; ++j)
         {
             // Check corruption in each block
-            if (checkCorruption(block))
+            if (isBlockCorrupted(page, block, checkFreed))
             {
                 ++numCorrupted;
                 fn(block, stats.ObjectSize_);
@@ -253,6 +586,33 @@ unsigned ObjectAllocator::ValidatePages(VALIDATECALLBACK fn) const
     return numCorrupted;
 }
 
+/********************************************************************************//*!
+ @brief  Like ValidatePages, but the pages are split between worker threads.
+
+ @param  fn
+    The callback function for dumping the memory in use.
+ @param  checkFreed
+    Also reports free blocks whose pattern has been overwritten, as with
+    ValidatePages.
+ @param  threads
+    The number of threads to walk the pages with, including the calling thread. 0
+    uses one per hardware thread.
+
+ @return Returns the number of blocks that are corrupted.
+
+ @throws std::bad_alloc if there is no memory left for the buffers.
+*//*********************************************************************************/
+unsigned ObjectAllocator::ValidatePagesParallel(VALIDATECALLBACK fn, bool checkFreed, unsigned threads) const
+{
+    // Patterns are only written while debugging
+    checkFreed = checkFreed && config.DebugOn_;
+
+    return findBlocksParallel(threads, [this, checkFreed](GenericObject* page, unsigned char* block)
+    {
+        return isBlockCorrupted(page, block, checkFreed);
+    }, fn);
+}
+
 /********************************************************************************//*!
  @brief  Returns the number of  pages that was freed
 *//*********************************************************************************/
@@ -261,239 +621,1920 @@ unsigned ObjectAllocator::FreeEmptyPages()
     if (PageList_ == nullptr)
         return 0; 
 
-    unsigned int numFreed = 0;
-    
-    // Traverse pages
-    GenericObject* page = PageList_;
-    GenericObject* prev = nullptr;
-
-    while (page != nullptr)
+    // Page free lists keep their counts up to date, otherwise count everything once
+    if (!config.PageFreeLists_)
     {
-        if (isPageEmpty(page))
-        {
-            GenericObject* next = page->Next;
-            freePage(page);
-            (prev ? prev->Next : PageList_) = next;
-            page = next;
-
-            ++numFreed;
-        }
-        else
-        {
-            prev = page;
-            page = page->Next;
-        }
+        countFreeBlocks();
+        unlinkEmptyPageBlocks();
     }
 
-    return numFreed;
+    return freeEmptyPages(false);
 }
 
-/*-------------------------------------------------------------------------------------*/
-/* Getter Functions                                                                    */
-/*-------------------------------------------------------------------------------------*/ 
 /********************************************************************************//*!
- @brief  Gets the free list.
+ @brief  Creates pages up front so that a number of objects can be allocated without
+         creating one, and touches every memory page of them so the first allocations
+         don't fault them in either. Does nothing when using new and delete.
 
- @return A pointer to the free list.
-*//*********************************************************************************/
-const void* ObjectAllocator::GetFreeList() const
-{
-    return FreeList_;
-}
-/********************************************************************************//*!
- @brief  Gets the page list.
+ @param  objectCount
+    The number of objects that need to be free.
 
- @return A pointer to the page list.
+ @throws An exception from OAException if the pages can't be created. No pages are
+        created if the maximum number of pages would be exceeded.
 *//*********************************************************************************/
-const void* ObjectAllocator::GetPageList() const
+void ObjectAllocator::Reserve(unsigned objectCount)
 {
-    return PageList_;
-}
-/********************************************************************************//*!
- @brief  Gets the configuration of the OA.
+    if (config.UseCPPMemManager_)
+        return;
 
- @return The configuration of the OA.
-*//*********************************************************************************/
-OAConfig ObjectAllocator::GetConfig() const
-{
-    return config;
+    ensureFreeObjects(objectCount, true);
 }
+
 /********************************************************************************//*!
- @brief  Gets the statistics of the OA.
+ @brief  Creates and prefaults pages until LowWatermark_ objects are free.
 
- @return The statistics for the OA.
+ @return The number of pages that were created.
+
+ @throws An exception from OAException if the pages can't be created. No pages are
+        created if the maximum number of pages would be exceeded.
 *//*********************************************************************************/
-OAStats ObjectAllocator::GetStats() const
+unsigned ObjectAllocator::Refill()
 {
-    return stats;
+    if (config.UseCPPMemManager_)
+        return 0;
+
+    return ensureFreeObjects(config.LowWatermark_, true);
 }
 
-/*-------------------------------------------------------------------------------------*/
-/* Setter Functions                                                                    */
-/*-------------------------------------------------------------------------------------*/
 /********************************************************************************//*!
- @brief  Sets the debug mode.
+ @brief  Frees the empty pages that stayed idle since the last call, keeping enough of
+         them for retainObjects objects to be free.
 
- @param  State
-    The state to set the debug mode to.
-*//*********************************************************************************/
-void ObjectAllocator::SetDebugState(bool state)
-{
-    config.DebugOn_ = state;
-}
+ @param  retainObjects
+    The number of free objects to keep pages for.
 
-/*-------------------------------------------------------------------------------------*/
-/* Private Function Members                                                            */
-/*-------------------------------------------------------------------------------------*/
-/********************************************************************************//*!
- @brief  Creates a new page.
+ @return The number of pages that were freed.
 *//*********************************************************************************/
-void ObjectAllocator::createPage()
+unsigned ObjectAllocator::ReclaimIdlePages(unsigned retainObjects)
 {
-    if (config.MaxPages_ && stats.PagesInUse_ == config.MaxPages_)
+    if (PageList_ == nullptr)
+        return 0;
+
+    if (!config.PageFreeLists_)
     {
-        throw OAException {OAException::E_NO_PAGES, "Maximum number of pages have been reached."};
+        countFreeBlocks();
     }
 
+    // Age the empty pages and mark the idle ones that aren't needed to stay above retainObjects
+    unsigned freeObjects = stats.FreeObjects_;
+    unsigned marked = 0;
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        PageInfo* info = pageInfo(page);
+        if (!isPageEmpty(page))
+        {
+            info->idleScans = 0;
+            continue;
+        }
+
+        if (info->idleScans < IDLE_SCANS)
+        {
+            ++info->idleScans;
+        }
+        if (info->idleScans >= IDLE_SCANS && freeObjects >= retainObjects + info->objects)
+        {
+            info->idleScans = RECLAIM_MARK;
+            freeObjects -= info->objects;
+            ++marked;
+        }
+    }
+
+    if (marked == 0)
+        return 0;
+
+    if (!config.PageFreeLists_)
+    {
+        unlinkEmptyPageBlocks(true);
+    }
+
+    return freeEmptyPages(true);
+}
+
+/********************************************************************************//*!
+ @brief  Frees every object in use at once, without a Free for each. The first
+         keepPages pages of the page list are set up again as new pages and the rest
+         are freed.
+
+ @param  keepPages
+    The number of pages to keep.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned ObjectAllocator::ReleaseAll(unsigned keepPages)
+{
+    if (config.UseCPPMemManager_)
+        return 0;
+
+    if (guarded)
+    {
+        guarded->FreeAll();
+    }
+
+    // Records are returned to the pool, including the ones kept by freed sampled blocks
+    if (config.HBlockInfo_.type_ == OAConfig::hbExternal)
+    {
+        for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+        {
+            unsigned char* block = firstBlock(page);
+            for (size_t i = 0; i < pageInfo(page)->objects; ++i, block += blockSize)
+            {
+                destroyHeader(block);
+            }
+        }
+    }
+
+    // Nothing is live any more, whatever label it was counted against
+    for (auto& counters : labelStats)
+    {
+        counters.second.LiveObjects_ = 0;
+        counters.second.LiveBytes_ = 0;
+    }
+
+    // Every list is rebuilt from the pages that are kept
+    FreeList_ = nullptr;
+    partialPages = nullptr;
+    emptyPages = nullptr;
+    stats.FreeObjects_ = 0;
+    if (!pageSpan)
+    {
+        pageIndex.clear();
+    }
+
+    unsigned kept = 0;
+    unsigned numFreed = 0;
+    GenericObject* page = PageList_;
+    GenericObject* prev = nullptr;
+    while (page != nullptr)
+    {
+        GenericObject* next = page->Next;
+        if (kept < keepPages)
+        {
+            resetPage(page);
+            if (!pageSpan)
+            {
+                pageIndex.push_back(TO_UCHAR_PTR(page));
+            }
+
+            prev = page;
+            ++kept;
+        }
+        else
+        {
+            if (pageSpan)
+            {
+                pageSpans.erase(reinterpret_cast<uintptr_t>(pageStart(page)));
+            }
+            (prev ? prev->Next : PageList_) = next;
+            releasePage(page);
+            --stats.PagesInUse_;
+
+            ++numFreed;
+        }
+        page = next;
+    }
+    std::sort(pageIndex.begin(), pageIndex.end());
+
+    stats.Deallocations_ += stats.ObjectsInUse_;
+    stats.ObjectsInUse_ = 0;
+
+    return numFreed;
+}
+
+/********************************************************************************//*!
+ @brief  Moves the objects out of the sparsest partially filled pages into the fullest
+         ones, so the pages they leave are empty and can be freed with FreeEmptyPages.
+
+ @param  fn
+    Called with context and the old and new address of each object moved.
+ @param  context
+    Passed to the callback.
+ @param  budget
+    The time to stop after, checked after each page is emptied. 0 means no limit.
+
+ @return The number of objects that were moved.
+*//*********************************************************************************/
+unsigned ObjectAllocator::Compact(RELOCATECALLBACK fn, void* context, std::chrono::microseconds budget)
+{
+    if (config.UseCPPMemManager_ || !config.PageFreeLists_)
+        return 0;
+
+    const TelemetryClock::time_point start = TelemetryClock::now();
+
+    // Sparsest pages first, so they are emptied into the fullest ones at the back
+    std::vector<PageInfo*> pages;
+    unsigned room = 0;
+    for (PageInfo* info = partialPages; info != nullptr; info = info->next)
+    {
+        pages.push_back(info);
+        room += info->freeCount;
+    }
+    std::sort(pages.begin(), pages.end(), [](const PageInfo* lhs, const PageInfo* rhs)
+    {
+        return lhs->objects - lhs->freeCount < rhs->objects - rhs->freeCount;
+    });
+
+    std::vector<unsigned char> isFree;
+    unsigned moved = 0;
+    size_t target = pages.size();
+    for (size_t source = 0; source + 1 < target; ++source)
+    {
+        PageInfo* info = pages[source];
+        const unsigned live = info->objects - info->freeCount;
+
+        // Only the pages after this one take its objects, and a page is moved whole
+        room -= info->freeCount;
+        if (live > room)
+            break;
+
+        // Blocks freed by the moves join the free list, so find the live ones first
+        GenericObject* page = TO_GENERIC_OBJECT_PTR(TO_UCHAR_PTR(info) + infoSize);
+        isFree.assign(info->objects, 0);
+        if (config.BitmapTracking_)
+        {
+            for (unsigned i = 0; i < info->objects; ++i)
+            {
+                isFree[i] = !((info->allocated[i / 8] >> (i % 8)) & 1u);
+            }
+        }
+        else
+        {
+            for (GenericObject* fL = info->freeList; fL != nullptr; fL = nextFree(page, fL))
+            {
+                isFree[blockIndex(page, TO_UCHAR_PTR(fL))] = 1;
+            }
+        }
+
+        unsigned char* block = firstBlock(page);
+        for (unsigned i = 0; i < info->objects; ++i, block += blockSize)
+        {
+            if (isFree[i])
+                continue;
+
+            // Pages at the back fill up one by one
+            while (pages[target - 1]->freeCount == 0)
+            {
+                --target;
+            }
+
+            unsigned char* object = moveBlock(page, block, pages[target - 1]);
+            fn(context, block, object);
+            --room;
+            ++moved;
+        }
+
+        if (budget.count() && TelemetryClock::now() - start >= budget)
+            break;
+    }
+
+    return moved;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/ 
+/********************************************************************************//*!
+ @brief  Gets the free list.
+
+ @return A pointer to the free list.
+*//*********************************************************************************/
+const void* ObjectAllocator::GetFreeList() const
+{
+    if (config.PageFreeLists_)
+    {
+        const PageInfo* info = partialPages ? partialPages : emptyPages;
+        return info ? info->freeList : nullptr;
+    }
+
+    return FreeList_;
+}
+/********************************************************************************//*!
+ @brief  Gets the page list.
+
+ @return A pointer to the page list.
+*//*********************************************************************************/
+const void* ObjectAllocator::GetPageList() const
+{
+    return PageList_;
+}
+/********************************************************************************//*!
+ @brief  Gets the configuration of the OA.
+
+ @return The configuration of the OA.
+*//*********************************************************************************/
+OAConfig ObjectAllocator::GetConfig() const
+{
+    return config;
+}
+/********************************************************************************//*!
+ @brief  Gets the statistics of the OA.
+
+ @return The statistics for the OA.
+*//*********************************************************************************/
+OAStats ObjectAllocator::GetStats() const
+{
+    return stats;
+}
+/********************************************************************************//*!
+ @brief  Gets a snapshot of the telemetry of the OA.
+
+ @return The telemetry of the OA.
+*//*********************************************************************************/
+OATelemetry ObjectAllocator::GetTelemetry() const
+{
+    OATelemetry telemetry;
+    telemetry.Allocate_     = allocateTimes;
+    telemetry.Free_         = freeTimes;
+    telemetry.CreatePage_   = pageTimes;
+    telemetry.ObjectSize_   = stats.ObjectSize_;
+    telemetry.ObjectsInUse_ = stats.ObjectsInUse_;
+    telemetry.PagesInUse_   = stats.PagesInUse_;
+
+    telemetry.Labels_.reserve(labelStats.size());
+    for (const auto& counters : labelStats)
+    {
+        telemetry.Labels_.push_back({ counters.first ? counters.first : "", counters.second });
+    }
+    std::sort(telemetry.Labels_.begin(), telemetry.Labels_.end(), [](const OATelemetry::Label& lhs, const OATelemetry::Label& rhs)
+    {
+        return lhs.Stats_.Allocations_ > rhs.Stats_.Allocations_;
+    });
+
+    // Without page free lists, the free blocks of each page are counted from the free list
+    std::unordered_map<const GenericObject*, unsigned> freeCounts;
+    if (!config.PageFreeLists_)
+    {
+        for (GenericObject* fL = FreeList_; fL != nullptr; fL = fL->Next)
+        {
+            ++freeCounts[findPage(TO_UCHAR_PTR(fL))];
+        }
+    }
+
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        const PageInfo* info = pageInfo(page);
+        const unsigned freeCount = config.PageFreeLists_ ? info->freeCount : freeCounts[page];
+        const unsigned inUse = info->objects - freeCount;
+
+        // Empty pages get a bucket of their own, the rest round up to the next tenth
+        const unsigned bucket = (inUse * 10 + info->objects - 1) / info->objects;
+        ++telemetry.PageOccupancy_[bucket];
+    }
+
+    return telemetry;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Setter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Sets the debug mode.
+
+ @param  State
+    The state to set the debug mode to.
+*//*********************************************************************************/
+void ObjectAllocator::SetDebugState(bool state)
+{
+    // Bitmaps are not maintained while debugging is off
+    if (state && !config.DebugOn_ && config.HBlockInfo_.type_ == OAConfig::hbNone)
+    {
+        syncAllocationState();
+    }
+
+    config.DebugOn_ = state;
+}
+/********************************************************************************//*!
+ @brief  Turns telemetry on or off.
+
+ @param  State
+    The state to set telemetry to.
+*//*********************************************************************************/
+void ObjectAllocator::SetTelemetryState(bool state)
+{
+    config.Telemetry_ = state;
+}
+/********************************************************************************//*!
+ @brief  Clears the latency histograms and the allocation count of every label.
+*//*********************************************************************************/
+void ObjectAllocator::ResetTelemetry()
+{
+    allocateTimes   = OALatencyHistogram();
+    freeTimes       = OALatencyHistogram();
+    pageTimes       = OALatencyHistogram();
+
+    for (auto& counters : labelStats)
+    {
+        counters.second.Allocations_ = 0;
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Allocates an object. The body of Allocate, without telemetry.
+
+ @param  label
+    The label for an external header.
+
+ @return Pointer to the allocated object.
+*//*********************************************************************************/
+void* ObjectAllocator::allocateObject(const char* label)
+{
+    if (config.UseCPPMemManager_)
+    {
+        try
+        {
+            unsigned char* obj = new unsigned char[stats.ObjectSize_];
+            ++stats.Allocations_;
+            ++stats.ObjectsInUse_;
+            stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
+            return obj;
+        }
+        catch(const std::bad_alloc&)
+        {
+            throw OAException{OAException::E_NO_MEMORY, "No physical memory left."};
+        }
+    }
+
+    // Sampled blocks go between guard pages while there is a slot for them
+    const bool sampled = config.DebugOn_ && takeSample();
+    if (sampled && guarded)
+    {
+        if (void* obj = guarded->Allocate())
+        {
+            ++stats.Allocations_;
+            ++stats.ObjectsInUse_;
+            stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
+            return obj;
+        }
+    }
+
+    unsigned char* obj = takeBlock();
+    incrementStats();
+    prepareBlock(obj, stats.Allocations_, label, sampled);
+
+    return obj;
+}
+/********************************************************************************//*!
+ @brief  Frees an object. The body of Free, without telemetry.
+
+ @param  Object
+    The object to free.
+*//*********************************************************************************/
+void ObjectAllocator::freeObject(void* Object)
+{
+    if (config.UseCPPMemManager_)
+    {
+        delete[] TO_UCHAR_PTR(Object);
+
+        ++stats.Deallocations_;
+        --stats.ObjectsInUse_;
+
+        return;
+    }
+
+    if (freeGuarded(Object))
+        return;
+
+    GenericObject* page = releaseBlock(Object);
+    pushFree(Object, page);
+    decrementStats();
+}
+/********************************************************************************//*!
+ @brief  Allocates a number of objects. The body of AllocateBatch, without telemetry.
+
+ @param  count
+    The number of objects to allocate.
+ @param  objects
+    Receives the allocated objects.
+ @param  label
+    The label for external headers.
+
+ @throws An exception from OAException if the objects can't be allocated. The blocks
+        taken so far are returned to their free lists first.
+*//*********************************************************************************/
+void ObjectAllocator::allocateObjects(unsigned count, void** objects, const char* label)
+{
+    if (count == 0)
+        return;
+
+    if (config.UseCPPMemManager_)
+    {
+        unsigned i = 0;
+        try
+        {
+            for (; i < count; ++i)
+            {
+                objects[i] = new unsigned char[stats.ObjectSize_];
+            }
+        }
+        catch(const std::bad_alloc&)
+        {
+            while (i--)
+            {
+                delete[] TO_UCHAR_PTR(objects[i]);
+            }
+            throw OAException{OAException::E_NO_MEMORY, "No physical memory left."};
+        }
+
+        stats.Allocations_ += count;
+        stats.ObjectsInUse_ += count;
+        stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
+        return;
+    }
+
+    ensureFreeObjects(count);
+
+    // Every block is now on a free list, so only the headers can fail from here on
+    const unsigned firstAllocNum = stats.Allocations_ + 1;
+    unsigned i = 0;
+    unsigned guardedCount = 0;
+    try
+    {
+        for (; i < count; ++i)
+        {
+            // Sampled blocks go between guard pages while there is a slot for them, as in Allocate
+            const bool sampled = config.DebugOn_ && takeSample();
+            if (sampled && guarded)
+            {
+                if (void* obj = guarded->Allocate())
+                {
+                    objects[i] = obj;
+                    ++guardedCount;
+                    continue;
+                }
+            }
+
+            unsigned char* obj = takeBlock();
+            objects[i] = obj;
+            prepareBlock(obj, firstAllocNum + i, label, sampled);
+        }
+    }
+    catch(const OAException&)
+    {
+        // Hand back every block taken so far, the last first so the free list is as it was
+        for (unsigned j = i + 1; j-- > 0;)
+        {
+            if (guarded && guarded->Owns(objects[j]))
+            {
+                guarded->Free(objects[j]);
+                continue;
+            }
+
+            unsigned char* obj = TO_UCHAR_PTR(objects[j]);
+            destroyHeader(obj);
+            if (config.DebugOn_ && config.HBlockInfo_.type_ == OAConfig::hbNone && !config.BitmapTracking_)
+            {
+                setBlockAllocated(findPage(obj), obj, false);
+            }
+            setPattern(obj, FREED_PATTERN);
+            pushFree(obj, nullptr);
+        }
+        throw;
+    }
+
+    // Guarded objects never came from the free list
+    incrementStats(count - guardedCount);
+    stats.Allocations_ += guardedCount;
+    stats.ObjectsInUse_ += guardedCount;
+    stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
+}
+/********************************************************************************//*!
+ @brief  Frees a number of objects. The body of FreeBatch, without telemetry.
+
+ @param  objects
+    The objects to free.
+ @param  count
+    The number of objects.
+*//*********************************************************************************/
+void ObjectAllocator::freeObjects(void** objects, unsigned count)
+{
+    if (config.UseCPPMemManager_)
+    {
+        for (unsigned i = 0; i < count; ++i)
+        {
+            delete[] TO_UCHAR_PTR(objects[i]);
+        }
+
+        stats.Deallocations_ += count;
+        stats.ObjectsInUse_ -= count;
+        return;
+    }
+
+    // Chain the blocks locally and splice them onto the free list in one go
+    GenericObject* first = nullptr;
+    GenericObject* last = nullptr;
+    unsigned i = 0;
+    unsigned guardedFrees = 0;
+    try
+    {
+        for (; i < count; ++i)
+        {
+            if (freeGuarded(objects[i]))
+            {
+                ++guardedFrees;
+                continue;
+            }
+
+            GenericObject* page = releaseBlock(objects[i]);
+            if (config.PageFreeLists_)
+            {
+                pushFree(objects[i], page);
+            }
+            else
+            {
+                GenericObject* obj = TO_GENERIC_OBJECT_PTR(objects[i]);
+                obj->Next = first;
+                first = obj;
+                last = last ? last : obj;
+            }
+        }
+    }
+    catch(const OAException&)
+    {
+        // Blocks released so far are still valid frees
+        if (last)
+        {
+            last->Next = FreeList_;
+            FreeList_ = first;
+        }
+        decrementStats(i - guardedFrees);
+        throw;
+    }
+
+    if (last)
+    {
+        last->Next = FreeList_;
+        FreeList_ = first;
+    }
+    decrementStats(count - guardedFrees);
+}
+/********************************************************************************//*!
+ @brief  Counts allocations against their label. Counters that can't be added for
+        lack of memory are dropped rather than failing the allocation.
+
+ @param  label
+    The label the objects were allocated with.
+ @param  count
+    The number of objects.
+ @param  live
+    How many of them are also counted as live, which needs an external header.
+
+ @return True if the counters were added.
+*//*********************************************************************************/
+bool ObjectAllocator::countLabel(const char* label, unsigned count, unsigned live)
+{
+    try
+    {
+        // Keyed by the interned copy, which is also what external headers hold
+        OALabelStats& counters = labelStats[label ? internLabel(label) : nullptr];
+        counters.Allocations_ += count;
+        counters.LiveObjects_ += live;
+        counters.LiveBytes_ += live * stats.ObjectSize_;
+        return true;
+    }
+    catch(const std::bad_alloc&)
+    {
+        return false;
+    }
+}
+/********************************************************************************//*!
+ @brief  Marks a block as counted in the live objects of its label, so it is
+        uncounted when freed. Only for blocks with an external header.
+
+ @param  block
+    The block that was counted.
+*//*********************************************************************************/
+void ObjectAllocator::markCounted(void* block)
+{
+    MemBlockInfo* info = *reinterpret_cast<MemBlockInfo**>(header(TO_UCHAR_PTR(block)));
+    info->counted = true;
+}
+/********************************************************************************//*!
+ @brief  Uncounts a block that is being freed from the live objects of its label, if
+        it was counted when allocated. MUST BE CALLED BEFORE destroyHeader
+
+ @param  block
+    The block being freed.
+*//*********************************************************************************/
+void ObjectAllocator::uncountLabel(unsigned char* block)
+{
+    if (config.HBlockInfo_.type_ != OAConfig::hbExternal)
+        return;
+
+    // Only blocks counted while telemetry was on are uncounted, whether or not it still is
+    MemBlockInfo* info = *reinterpret_cast<MemBlockInfo**>(header(block));
+    if (info == nullptr || !info->in_use || !info->counted)
+        return;
+
+    info->counted = false;
+    auto counters = labelStats.find(info->label);
+    if (counters != labelStats.end())
+    {
+        --counters->second.LiveObjects_;
+        counters->second.LiveBytes_ -= stats.ObjectSize_;
+    }
+}
+/********************************************************************************//*!
+ @brief  Takes a block from the free list, creating a page if it is empty.
+
+ @return The block taken.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::takeBlock()
+{
+    if (config.PageFreeLists_)
+        return takeFromPages();
+
+    if (FreeList_ == nullptr)
+    {
+        createPage();
+    }
+
+    unsigned char* obj = TO_UCHAR_PTR(FreeList_);
+    FreeList_ = FreeList_->Next;
+    return obj;
+}
+/********************************************************************************//*!
+ @brief  Prepares a block that was just taken from the free list for the client.
+
+ @param  block
+    The block to prepare.
+ @param  allocNum
+    The allocation number of the block.
+ @param  label
+    The label for an external header.
+ @param  sampled
+    Whether the block was picked for debug checks.
+*//*********************************************************************************/
+void ObjectAllocator::prepareBlock(unsigned char* block, unsigned allocNum, const char* label, bool sampled)
+{
+    // Blocks that aren't picked skip the pattern and all checks when freed
+    const bool marked = sampled && config.DebugSampleRate_ > 1;
+
+    // Both bits of a block share its index, so it is worked out once
+    if (config.DebugOn_ && config.HBlockInfo_.type_ == OAConfig::hbNone)
+    {
+        GenericObject* page = findPage(block);
+        const size_t index = blockIndex(page, block);
+        const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
+        PageInfo* info = pageInfo(page);
+
+        info->allocated[index / 8] |= mask;
+        if (config.DebugSampleRate_ > 1)
+        {
+            info->sampled[index / 8] = marked ? (info->sampled[index / 8] | mask) : (info->sampled[index / 8] & ~mask);
+        }
+    }
+
+    if (sampled)
+    {
+        setPattern(block, ALLOCATED_PATTERN);
+    }
+    createHeader(block, allocNum, label, marked);
+}
+/********************************************************************************//*!
+ @brief  Validates a block being freed and marks it as free, without putting it on a
+        free list.
+
+ @param  Object
+    The block being freed.
+
+ @return The page the block is in, or a nullptr if debugging and bitmap tracking are
+        off.
+
+ @throws OAException, based on the type of invalid free. A repeated free always
+        throws with bitmap tracking.
+*//*********************************************************************************/
+GenericObject* ObjectAllocator::releaseBlock(void* Object)
+{
+    unsigned char* block = TO_UCHAR_PTR(Object);
+    GenericObject* page = nullptr;
+    bool sampled = true;
+
+    // While sampling, only blocks picked when allocated are checked
+    const bool sampling = config.DebugOn_ && config.DebugSampleRate_ > 1;
+    if (sampling && config.HBlockInfo_.type_ == OAConfig::hbNone)
+    {
+        // Without a header, the page has to be found to see the mark. A block on no
+        // page is checked so the bad boundary is reported.
+        page = findPage(block);
+        if (page && !config.BitmapTracking_)
+        {
+            // A block that wasn't picked is done with here, reading and clearing its
+            // bits with one index
+            const size_t index = blockIndex(page, block);
+            const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
+            PageInfo* info = pageInfo(page);
+            if (!(info->sampled[index / 8] & mask))
+            {
+                info->allocated[index / 8] &= ~mask;
+                return page;
+            }
+        }
+        sampled = page == nullptr || isBlockSampled(page, block);
+    }
+    else if (sampling)
+    {
+        sampled = isBlockSampled(page, block);
+    }
+
+    if (sampled)
+    {
+        page = checkForInvalidFree(Object);
+        setPattern(block, FREED_PATTERN);
+    }
+
+    // The bitmap is always current, so a repeated free is caught even when the debug
+    // checks didn't run, before the header or the stats change
+    if (config.BitmapTracking_ && !(config.DebugOn_ && sampled))
+    {
+        page = page ? page : findPage(block);
+        if (page == nullptr)
+        {
+            throw OAException{OAException::E_BAD_BOUNDARY, "Object address is not within a page."};
+        }
+
+        const size_t index = blockIndex(page, block);
+        if (((pageInfo(page)->allocated[index / 8] >> (index % 8)) & 1u) == 0)
+        {
+            throw OAException{OAException::E_MULTIPLE_FREE, "Object has already been freed."};
+        }
+    }
+
+    uncountLabel(block);
+    destroyHeader(block, sampling && sampled);
+
+    // Page is only found while debugging. Bitmap tracking clears the bit in pushFree.
+    if (page && config.HBlockInfo_.type_ == OAConfig::hbNone && !config.BitmapTracking_)
+    {
+        setBlockAllocated(page, block, false);
+    }
+
+    return page;
+}
+/********************************************************************************//*!
+ @brief  Puts a released block onto its free list.
+
+ @param  Object
+    The block to put on the free list.
+ @param  page
+    The page the block is in, if already known.
+*//*********************************************************************************/
+void ObjectAllocator::pushFree(void* Object, GenericObject* page)
+{
+    if (config.BitmapTracking_)
+    {
+        unsigned char* block = TO_UCHAR_PTR(Object);
+        page = page ? page : findPage(block);
+
+        PageInfo* info = pageInfo(page);
+        const size_t index = blockIndex(page, block);
+        const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
+
+        info->allocated[index / 8] &= static_cast<unsigned char>(~mask);
+        info->firstFree = index / 8 < info->firstFree ? static_cast<unsigned>(index / 8) : info->firstFree;
+        movePage(info, info->freeCount++);
+        return;
+    }
+
+    GenericObject* temp = TO_GENERIC_OBJECT_PTR(Object);
+    if (config.PageFreeLists_)
+    {
+        page = page ? page : findPage(TO_UCHAR_PTR(Object));
+        PageInfo* info = pageInfo(page);
+        linkFree(page, temp, info->freeList);
+        info->freeList = temp;
+        movePage(info, info->freeCount++);
+    }
+    else
+    {
+        temp->Next = FreeList_;
+        FreeList_ = temp;
+    }
+}
+/********************************************************************************//*!
+ @brief  Frees a block if it is in a guarded slot.
+
+ @param  Object
+    The block being freed.
+
+ @return True if the block was guarded and is now free.
+
+ @throws OAException, based on the type of invalid free.
+*//*********************************************************************************/
+bool ObjectAllocator::freeGuarded(void* Object)
+{
+    if (!guarded || !guarded->Owns(Object))
+        return false;
+
+    guarded->Free(Object);
+    ++stats.Deallocations_;
+    --stats.ObjectsInUse_;
+    return true;
+}
+/********************************************************************************//*!
+ @brief  Creates enough pages up front for a number of objects to be free.
+
+ @param  count
+    The number of objects that need to be free.
+ @param  prefault
+    Whether to touch the memory of the pages created.
+
+ @return The number of pages that were created.
+
+ @throws OAException if the pages can't be created. No pages are created if the
+        maximum number of pages would be exceeded.
+*//*********************************************************************************/
+unsigned ObjectAllocator::ensureFreeObjects(unsigned count, bool prefault)
+{
+    if (stats.FreeObjects_ >= count)
+        return 0;
+
+    // Walk the growth of the coming pages to know how many are needed
+    unsigned pages = 0;
+    unsigned objects = nextObjects;
+    for (unsigned missing = count - stats.FreeObjects_; missing > 0; ++pages)
+    {
+        missing -= missing < objects ? missing : objects;
+        objects = objects > config.MaxObjectsPerPage_ / 2 ? config.MaxObjectsPerPage_ : objects * 2;
+    }
+
+    if (config.MaxPages_ && stats.PagesInUse_ + pages > config.MaxPages_)
+    {
+        throw OAException {OAException::E_NO_PAGES, "Maximum number of pages have been reached."};
+    }
+
+    for (unsigned i = 0; i < pages; ++i)
+    {
+        createPage();
+
+        // The new page is at the front of the page list
+        if (prefault)
+        {
+            prefaultPage(PageList_);
+        }
+    }
+
+    return pages;
+}
+/********************************************************************************//*!
+ @brief  Creates a new page.
+*//*********************************************************************************/
+void ObjectAllocator::createPage()
+{
+    if (config.MaxPages_ && stats.PagesInUse_ == config.MaxPages_)
+    {
+        throw OAException {OAException::E_NO_PAGES, "Maximum number of pages have been reached."};
+    }
+
+    const TelemetryClock::time_point start = config.Telemetry_ ? TelemetryClock::now() : TelemetryClock::time_point();
+
     try
     {
-        unsigned char* page = new unsigned char[stats.PageSize_];
-        GenericObject* p = TO_GENERIC_OBJECT_PTR(page);
-            
-        insertPage(p);
-        setUpBlocks(p);
+        const unsigned objects = nextObjects;
+        unsigned char* raw = allocatePage(objects);
+        const size_t prefix = prefixSizeFor(objects);
+        memset(raw, 0, prefix);
+
+        // Each page's bitmaps are only as big as its own blocks need
+        GenericObject* p = TO_GENERIC_OBJECT_PTR(raw + prefix);
+        pageInfo(p)->allocated = raw;
+        pageInfo(p)->sampled = raw + (objects + 7) / 8;
+        pageInfo(p)->objects = objects;
+        
+        try
+        {
+            insertPage(p);
+        }
+        catch(const std::bad_alloc&)
+        {
+            releasePage(p);
+            throw;
+        }
+
+        if (config.PageFreeLists_)
+        {
+            PageInfo* info = pageInfo(p);
+            setUpBlocks(p, info->freeList);
+            info->freeCount = objects;
+            movePage(info, 0);
+        }
+        else
+        {
+            setUpBlocks(p, FreeList_);
+        }
+
+        // Update stats
+        ++stats.PagesInUse_;
+        stats.FreeObjects_ += objects;
+
+        // The next page doubles, up to the cap
+        nextObjects = objects > config.MaxObjectsPerPage_ / 2 ? config.MaxObjectsPerPage_ : objects * 2;
+
+        if (config.Telemetry_)
+        {
+            pageTimes.Record(elapsedNs(start));
+        }
+    }
+    catch(const std::bad_alloc&)
+    {
+        throw OAException {OAException::E_NO_MEMORY, "No system memory available."};
+    }
+}
+/********************************************************************************//*!
+ @brief  Touches one byte in every memory page of a page so the system maps it now
+         rather than on first use. The contents are left as they are.
+
+ @param  page
+    The page to touch.
+*//*********************************************************************************/
+void ObjectAllocator::prefaultPage(GenericObject* page)
+{
+    unsigned char* start = pageStart(page);
+    const size_t size = prefixSizeFor(pageInfo(page)->objects) + pageSizeFor(pageInfo(page)->objects);
+
+    // Writing back what was read faults in a private page without changing it
+    volatile unsigned char* byte = start;
+    for (size_t offset = 0; offset < size; offset += PREFAULT_STRIDE)
+    {
+        byte[offset] = byte[offset];
+    }
+    byte[size - 1] = byte[size - 1];
+}
+/********************************************************************************//*!
+ @brief  Inserts a page into the page list.
+
+ @param  page
+    The page to insert.
+*//*********************************************************************************/
+void ObjectAllocator::insertPage(GenericObject* page)
+{
+    unsigned char* cP = TO_UCHAR_PTR(page);
+    if (pageSpan)
+    {
+        pageSpans.emplace(reinterpret_cast<uintptr_t>(pageStart(page)), page);
+    }
+    else
+    {
+        pageIndex.insert(std::upper_bound(pageIndex.begin(), pageIndex.end(), cP), cP);
+    }
+
+    // PageList points to new page, new page next points to previous page
+    GenericObject* currentPage = PageList_;
+    PageList_ = page;
+    PageList_->Next = stats.PagesInUse_ ? currentPage : nullptr;
+}
+/********************************************************************************//*!
+ @brief  Sets up the blocks in an empty page and puts them into a free list.
+
+ @param  page
+    The page to set up the blocks in.
+ @param  list
+    The free list to put the blocks into.
+*//*********************************************************************************/
+void ObjectAllocator::setUpBlocks(GenericObject* page, GenericObject*& list)
+{
+    unsigned char* cP = TO_UCHAR_PTR(page);
+    unsigned char* cFL = TO_UCHAR_PTR(list);
+
+    setLeftAlignment(cP);
+
+    // Prepare blocks and assign FreeList to point to the last block.
+    const unsigned objects = pageInfo(page)->objects;
+    for (size_t i = 0; i < objects; ++i)
+    {
+        size_t offset = i ? blockSize : PTR_SIZE + config.PadBytes_ + config.HBlockInfo_.size_ + config.LeftAlignSize_;
+
+        cFL = i ? cFL + offset : cP + offset;
+
+        // With bitmap tracking, free blocks are never written to
+        if (linkSize)
+        {
+            GenericObject* currentBlock = TO_GENERIC_OBJECT_PTR(cFL);
+            linkFree(page, currentBlock, list);
+            list = currentBlock;
+        }
+
+        // Set headers 
+        switch (config.HBlockInfo_.type_)
+        {
+            case OAConfig::hbBasic:
+            case OAConfig::hbExtended:
+            {
+                setHeaderFlag(cFL, false);
+                setHeaderAllocNumber(cFL, 0);
+
+                // Set use count and user-defined bytes for extended header
+                if (config.HBlockInfo_.type_ == OAConfig::hbExtended)
+                {
+                    size_t numBytes = config.HBlockInfo_.size_ - sizeof(unsigned char) - sizeof(int);
+                    memset(header(cFL), 0, numBytes);
+                }
+
+                break;
+            }
+            case OAConfig::hbExternal:
+            {
+                memset(header(cFL), 0, config.HBlockInfo_.size_);
+                break;
+            }
+            default: break;
+        } 
+
+        if (i != objects - 1)
+        {
+            setInterAlignment(cFL);
+        }
+        setPattern(cFL, PAD_PATTERN);
+        setPattern(cFL, UNALLOCATED_PATTERN);
+    }
+}
+
+/********************************************************************************//*!
+ @brief  Frees a single page.
+
+ @param  page
+    The page to free.
+*//*********************************************************************************/
+void ObjectAllocator::freePage(GenericObject* page)
+{
+    // Blocks are already off the free list, either with the page or by unlinkEmptyPageBlocks
+    PageInfo* info = pageInfo(page);
+
+    // Sampled blocks keep their records after being freed
+    if (config.HBlockInfo_.type_ == OAConfig::hbExternal)
+    {
+        unsigned char* block = firstBlock(page);
+        for (size_t i = 0; i < info->objects; ++i, block += blockSize)
+        {
+            destroyHeader(block);
+        }
+    }
+
+    if (config.PageFreeLists_)
+    {
+        PageInfo** list = pageListFor(info, info->freeCount);
+        (info->prev ? info->prev->next : *list) = info->next;
+        if (info->next)
+        {
+            info->next->prev = info->prev;
+        }
+    }
+    stats.FreeObjects_ -= info->freeCount;
+
+    unsigned char* cP = TO_UCHAR_PTR(page);
+    if (pageSpan)
+    {
+        pageSpans.erase(reinterpret_cast<uintptr_t>(pageStart(page)));
+    }
+    else
+    {
+        pageIndex.erase(std::lower_bound(pageIndex.begin(), pageIndex.end(), cP));
+    }
+
+    releasePage(page);
+    --stats.PagesInUse_;
+}
+/********************************************************************************//*!
+ @brief  Sets up a page again as if it were new, with every block free.
+
+ @param  page
+    The page to set up.
+*//*********************************************************************************/
+void ObjectAllocator::resetPage(GenericObject* page)
+{
+    PageInfo* info = pageInfo(page);
+    // Each bitmap is sized for this page's own blocks
+    memset(info->allocated, 0, (info->objects + 7) / 8);
+    memset(info->sampled, 0, (info->objects + 7) / 8);
+    info->freeList = nullptr;
+    info->freeCount = info->objects;
+    info->firstFree = 0;
+    info->idleScans = 0;
+    info->prev = nullptr;
+    info->next = nullptr;
+
+    // Free blocks tracked by a bitmap hold nothing unless there are headers or patterns
+    if (linkSize || config.HBlockInfo_.type_ != OAConfig::hbNone || config.DebugOn_)
+    {
+        setUpBlocks(page, config.PageFreeLists_ ? info->freeList : FreeList_);
+    }
+
+    if (config.PageFreeLists_)
+    {
+        movePage(info, 0);
+    }
+    stats.FreeObjects_ += info->objects;
+}
+/********************************************************************************//*!
+ @brief  Allocates the memory for a page, including its PageInfo.
+
+ @param  objects
+    The number of blocks the page holds.
+
+ @return The start of the memory, which is where the PageInfo goes.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::allocatePage(unsigned objects)
+{
+    const size_t span = pageSpan ? pageSpanFor(objects) : 0;
+    if (config.PageProvider_)
+    {
+        if (span)
+            return TO_UCHAR_PTR(config.PageProvider_->AllocatePage(span, span));
+
+        return TO_UCHAR_PTR(config.PageProvider_->AllocatePage(prefixSizeFor(objects) + pageSizeFor(objects), alignof(std::max_align_t)));
+    }
+
+    if (!span)
+        return new unsigned char[prefixSizeFor(objects) + pageSizeFor(objects)];
+
+#ifdef _WIN32
+    void* raw = _aligned_malloc(span, span);
+#else
+    void* raw = nullptr;
+    if (posix_memalign(&raw, span, span) != 0)
+    {
+        raw = nullptr;
+    }
+#endif
+
+    if (raw == nullptr)
+        throw std::bad_alloc{};
+
+    return TO_UCHAR_PTR(raw);
+}
+/********************************************************************************//*!
+ @brief  Gets the size of a page, not including its PageInfo.
+
+ @param  objects
+    The number of blocks the page holds.
+
+ @return The size of the page.
+*//*********************************************************************************/
+size_t ObjectAllocator::pageSizeFor(unsigned objects) const
+{
+    // Link, left alignment and every block, less the inter alignment of the last one
+    return PTR_SIZE + config.LeftAlignSize_ + blockSize * objects - config.InterAlignSize_;
+}
+/********************************************************************************//*!
+ @brief  Gets the size of the bitmaps and PageInfo in front of a page.
+
+ @param  objects
+    The number of blocks the page holds.
+
+ @return The size of the prefix, a multiple of the alignment of max_align_t.
+*//*********************************************************************************/
+size_t ObjectAllocator::prefixSizeFor(unsigned objects) const
+{
+    // Both bitmaps, rounded up so PageInfo and the page keep the alignment of operator new
+    const size_t maxAlign = alignof(std::max_align_t);
+    const size_t bitmaps = 2 * ((objects + 7) / 8);
+    return (bitmaps + maxAlign - 1) / maxAlign * maxAlign + infoSize;
+}
+/********************************************************************************//*!
+ @brief  Gets the power-of-two span of an aligned page, including its PageInfo.
+
+ @param  objects
+    The number of blocks the page holds.
+
+ @return The span of the page.
+*//*********************************************************************************/
+size_t ObjectAllocator::pageSpanFor(unsigned objects) const
+{
+    // Smallest power of two that fits the page and its info
+    size_t span = alignof(std::max_align_t);
+    while (span < prefixSizeFor(objects) + pageSizeFor(objects))
+    {
+        span <<= 1;
+    }
+    return span;
+}
+/********************************************************************************//*!
+ @brief  Counts the free blocks of every page in a single pass over the free list.
+*//*********************************************************************************/
+void ObjectAllocator::countFreeBlocks()
+{
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        pageInfo(page)->freeCount = 0;
+    }
 
-        // Update stats
-        ++stats.PagesInUse_;
-        stats.FreeObjects_ += config.ObjectsPerPage_;
+    for (GenericObject* fL = FreeList_; fL != nullptr; fL = fL->Next)
+    {
+        ++pageInfo(findPage(TO_UCHAR_PTR(fL)))->freeCount;
     }
-    catch(const std::bad_alloc&)
+}
+/********************************************************************************//*!
+ @brief  Removes the blocks of empty pages from the free list in a single pass.
+        MUST BE CALLED AFTER countFreeBlocks
+
+ @param  markedOnly
+    Only remove the blocks of pages marked by ReclaimIdlePages.
+*//*********************************************************************************/
+void ObjectAllocator::unlinkEmptyPageBlocks(bool markedOnly)
+{
+    GenericObject* fL = FreeList_;
+    GenericObject* prev = nullptr;
+
+    // Traverse freelist
+    while (fL != nullptr)
     {
-        throw OAException {OAException::E_NO_MEMORY, "No system memory available."};
+        if (isPageToFree(findPage(TO_UCHAR_PTR(fL)), markedOnly))
+        {
+            (prev ? prev->Next : FreeList_) = fL->Next;
+        }
+        else
+        {
+            prev = fL;
+        }
+        fL = fL->Next;
     }
 }
 /********************************************************************************//*!
- @brief  Inserts a page into the page list.
+ @brief  Frees empty pages. Without PageFreeLists_, their blocks must have been removed
+         from the free list by unlinkEmptyPageBlocks first.
+
+ @param  markedOnly
+    Only free the pages marked by ReclaimIdlePages.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned ObjectAllocator::freeEmptyPages(bool markedOnly)
+{
+    unsigned int numFreed = 0;
+
+    // Traverse pages
+    GenericObject* page = PageList_;
+    GenericObject* prev = nullptr;
+
+    while (page != nullptr)
+    {
+        if (isPageToFree(page, markedOnly))
+        {
+            GenericObject* next = page->Next;
+            freePage(page);
+            (prev ? prev->Next : PageList_) = next;
+            page = next;
+
+            ++numFreed;
+        }
+        else
+        {
+            prev = page;
+            page = page->Next;
+        }
+    }
+
+    return numFreed;
+}
+/********************************************************************************//*!
+ @brief  Takes a block from the page free lists, preferring partially filled pages.
+
+ @return The block taken.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::takeFromPages()
+{
+    // Filling partial pages first leaves more pages to be reclaimed
+    PageInfo* info = partialPages ? partialPages : emptyPages;
+    if (info == nullptr)
+    {
+        createPage();
+        info = emptyPages;
+    }
+
+    return takeFromPage(info);
+}
+/********************************************************************************//*!
+ @brief  Takes a block from the free list or bitmap of a page.
+
+ @param  info
+    The PageInfo of the page. Must have a free block.
+
+ @return The block taken.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::takeFromPage(PageInfo* info)
+{
+    if (config.BitmapTracking_)
+    {
+        const size_t index = takeFromBitmap(info);
+        info->idleScans = 0;
+        movePage(info, info->freeCount--);
+        return firstBlock(TO_GENERIC_OBJECT_PTR(TO_UCHAR_PTR(info) + infoSize)) + index * blockSize;
+    }
+
+    GenericObject* block = info->freeList;
+    info->freeList = nextFree(TO_GENERIC_OBJECT_PTR(TO_UCHAR_PTR(info) + infoSize), block);
+    info->idleScans = 0;
+    movePage(info, info->freeCount--);
+
+    return TO_UCHAR_PTR(block);
+}
+/********************************************************************************//*!
+ @brief  Moves an object to a free block of another page and frees the block it was
+        in. The stats don't change, as the object stays in use.
+
+ @param  from
+    The page the object is in.
+ @param  block
+    The object to move.
+ @param  to
+    The PageInfo of the page to move it to. Must have a free block.
+
+ @return The new address of the object.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::moveBlock(GenericObject* from, unsigned char* block, PageInfo* to)
+{
+    GenericObject* toPage = TO_GENERIC_OBJECT_PTR(TO_UCHAR_PTR(to) + infoSize);
+    unsigned char* target = takeFromPage(to);
+
+    // The header and both pads go with the object, so labels and allocation numbers stay
+    const size_t lead = config.HBlockInfo_.size_ + config.PadBytes_;
+    memcpy(target - lead, block - lead, lead + stats.ObjectSize_ + config.PadBytes_);
+
+    if (config.DebugOn_ && config.HBlockInfo_.type_ == OAConfig::hbNone)
+    {
+        setBlockAllocated(toPage, target, true);
+        if (config.DebugSampleRate_ > 1)
+        {
+            setBlockSampled(toPage, target, isBlockSampled(from, block));
+            setBlockSampled(from, block, false);
+        }
+
+        // Bitmap tracking clears the bit in pushFree
+        if (!config.BitmapTracking_)
+        {
+            setBlockAllocated(from, block, false);
+        }
+    }
+
+    // An external record now belongs to the new block, so the old one only forgets it
+    if (config.HBlockInfo_.type_ == OAConfig::hbExternal)
+    {
+        memset(header(block), 0, config.HBlockInfo_.size_);
+    }
+    else
+    {
+        destroyHeader(block);
+    }
+
+    setPattern(block, FREED_PATTERN);
+    pushFree(block, from);
+
+    return target;
+}
+/********************************************************************************//*!
+ @brief  Takes the lowest free block of a page from its bitmap.
+
+ @param  info
+    The PageInfo of the page. Must have a free block.
+
+ @return The index of the block taken.
+*//*********************************************************************************/
+size_t ObjectAllocator::takeFromBitmap(PageInfo* info)
+{
+    const size_t bytes = (info->objects + 7) / 8;
+    size_t byte = info->firstFree;
+
+    // Skip a word at a time while every block in it is in use
+    uint64_t word = 0;
+    while (byte + sizeof(word) <= bytes)
+    {
+        memcpy(&word, info->allocated + byte, sizeof(word));
+        if (word != ~0ULL)
+            break;
+        byte += sizeof(word);
+    }
+    while (info->allocated[byte] == 0xFF)
+    {
+        ++byte;
+    }
+
+    // Bits past the last block are clear, but a free block always comes before them
+    const unsigned bit = lowestClearBit(info->allocated[byte]);
+    info->allocated[byte] |= static_cast<unsigned char>(1u << bit);
+    info->firstFree = static_cast<unsigned>(byte);
+
+    return byte * 8 + bit;
+}
+/********************************************************************************//*!
+ @brief  Calls the callback function for each block set in the page bitmaps.
+
+ @param  fn
+    The callback function.
+*//*********************************************************************************/
+void ObjectAllocator::dumpFromBitmaps(DUMPCALLBACK fn) const
+{
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        const PageInfo* info = pageInfo(page);
+        const size_t bytes = (info->objects + 7) / 8;
+        unsigned char* first = firstBlock(page);
+
+        for (size_t byte = 0; byte < bytes; ++byte)
+        {
+            // Skip a word at a time while every block in it is free
+            uint64_t word = 0;
+            if (byte % sizeof(word) == 0 && byte + sizeof(word) <= bytes)
+            {
+                memcpy(&word, info->allocated + byte, sizeof(word));
+                if (word == 0)
+                {
+                    byte += sizeof(word) - 1;
+                    continue;
+                }
+            }
+
+            for (unsigned bits = info->allocated[byte]; bits != 0; bits &= bits - 1)
+            {
+                const unsigned bit = lowestClearBit(static_cast<unsigned char>(~bits));
+                fn(first + (byte * 8 + bit) * blockSize, stats.ObjectSize_);
+            }
+        }
+    }
+}
+/********************************************************************************//*!
+ @brief  Moves a page onto the partial or empty list to match its free count.
+
+ @param  info
+    The PageInfo of the page.
+ @param  oldCount
+    The free count of the page before it changed.
+*//*********************************************************************************/
+void ObjectAllocator::movePage(PageInfo* info, unsigned oldCount)
+{
+    PageInfo** from = pageListFor(info, oldCount);
+    PageInfo** to   = pageListFor(info, info->freeCount);
+    if (from == to)
+        return;
+
+    // Unlink from the old list
+    if (from)
+    {
+        (info->prev ? info->prev->next : *from) = info->next;
+        if (info->next)
+        {
+            info->next->prev = info->prev;
+        }
+    }
+
+    // Push onto the front of the new list
+    info->prev = nullptr;
+    info->next = to ? *to : nullptr;
+    if (to)
+    {
+        if (*to)
+        {
+            (*to)->prev = info;
+        }
+        *to = info;
+    }
+}
+/********************************************************************************//*!
+ @brief  Gets the list a page belongs on for a given free count.
+
+ @param  info
+    The PageInfo of the page.
+ @param  count
+    The free count of the page.
+
+ @return The head of the list, or a nullptr if the page is full.
+*//*********************************************************************************/
+PageInfo** ObjectAllocator::pageListFor(const PageInfo* info, unsigned count)
+{
+    if (count == 0)
+        return nullptr;
+
+    return count == info->objects ? &emptyPages : &partialPages;
+}
+/********************************************************************************//*!
+ @brief  Releases the memory of a page, including its PageInfo.
 
  @param  page
-    The page to insert.
+    The page to release.
 *//*********************************************************************************/
-void ObjectAllocator::insertPage(GenericObject* page)
+void ObjectAllocator::releasePage(GenericObject* page)
 {
-    // PageList points to new page, new page next points to previous page
-    GenericObject* currentPage = PageList_;
-    PageList_ = page;
-    PageList_->Next = stats.PagesInUse_ ? currentPage : nullptr;
+    unsigned char* raw = pageStart(page);
+    const unsigned objects = pageInfo(page)->objects;
+    if (config.PageProvider_)
+    {
+        if (pageSpan)
+            config.PageProvider_->ReleasePage(raw, pageSpanFor(objects), pageSpanFor(objects));
+        else
+            config.PageProvider_->ReleasePage(raw, prefixSizeFor(objects) + pageSizeFor(objects), alignof(std::max_align_t));
+        return;
+    }
+
+    if (!pageSpan)
+    {
+        delete[] raw;
+        return;
+    }
+
+#ifdef _WIN32
+    _aligned_free(raw);
+#else
+    free(raw);
+#endif
 }
 /********************************************************************************//*!
- @brief  Sets up the blocks in an empty page and puts them into the free list.
+ @brief  Gets the PageInfo stored in front of a page.
 
  @param  page
-    The page to set up the blocks in.
+    The page to get the info of.
+
+ @return The PageInfo of the page.
 *//*********************************************************************************/
-void ObjectAllocator::setUpBlocks(GenericObject* page)
+PageInfo* ObjectAllocator::pageInfo(GenericObject* page) const
 {
-    unsigned char* cP = TO_UCHAR_PTR(page);
-    unsigned char* cFL = TO_UCHAR_PTR(FreeList_);
+    return reinterpret_cast<PageInfo*>(TO_UCHAR_PTR(page) - infoSize);
+}
+/********************************************************************************//*!
+ @brief  Gets the start of the memory of a page, where its bitmaps are.
 
-    setLeftAlignment(cP);
+ @param  page
+    The page to get the start of.
 
-    // Prepare blocks and assign FreeList to point to the last block.
-    for (size_t i = 0; i < config.ObjectsPerPage_; ++i)
+ @return The address the page was allocated at.
+*//*********************************************************************************/
+unsigned char* ObjectAllocator::pageStart(GenericObject* page) const
+{
+    return TO_UCHAR_PTR(page) - prefixSizeFor(pageInfo(page)->objects);
+}
+/********************************************************************************//*!
+ @brief  Finds the page a block belongs to. Runs in constant time if pages are aligned
+        (a lookup for each size pages have grown through) or O(log pages) using the
+        sorted page index otherwise.
+
+ @param  block
+    The block to find the page of.
+
+ @return The page the block is in, or a nullptr if it is not within any page.
+*//*********************************************************************************/
+GenericObject* ObjectAllocator::findPage(unsigned char* block) const
+{
+    if (pageSpan)
     {
-        size_t offset = i ? blockSize : PTR_SIZE + config.PadBytes_ + config.HBlockInfo_.size_ + config.LeftAlignSize_;
+        // Mask down to the span the block would be in, then make sure we own that span.
+        // A smaller page found at the base of a larger span can't hold the block.
+        for (size_t span = pageSpan; span <= maxPageSpan; span <<= 1)
+        {
+            const uintptr_t base = reinterpret_cast<uintptr_t>(block) & ~(static_cast<uintptr_t>(span) - 1);
+            auto found = pageSpans.find(base);
+            if (found == pageSpans.end())
+                continue;
+
+            GenericObject* page = found->second;
+            if (isInPage(page, block))
+                return page;
+        }
+        return nullptr;
+    }
+
+    // Last page that starts before the block
+    auto it = std::upper_bound(pageIndex.begin(), pageIndex.end(), block);
+    if (it == pageIndex.begin())
+        return nullptr;
+
+    GenericObject* page = TO_GENERIC_OBJECT_PTR(*(it - 1));
+    return isInPage(page, block) ? page : nullptr;
+}
+/********************************************************************************//*!
+ @brief  Gets the index of a block within its page.
+
+ @param  page
+    The page the block is in.
+ @param  block
+    The block to get the index of.
+
+ @return The index of the block within the page.
+*//*********************************************************************************/
+size_t ObjectAllocator::blockIndex(GenericObject* page, unsigned char* block) const
+{
+    return static_cast<size_t>(block - firstBlock(page)) / blockSize;
+}
+/********************************************************************************//*!
+ @brief  Gets the block after a free block on the free list of its page, following a
+        pointer or an index as the links are stored.
+
+ @param  page
+    The page the block is in.
+ @param  block
+    The free block.
+
+ @return The next free block, or a nullptr at the end of the list.
+*//*********************************************************************************/
+GenericObject* ObjectAllocator::nextFree(GenericObject* page, GenericObject* block) const
+{
+    if (linkSize == PTR_SIZE)
+        return block->Next;
+
+    // Blocks smaller than a pointer may not be aligned for the index either
+    uint32_t index = 0;
+    if (linkSize == sizeof(uint16_t))
+    {
+        uint16_t shortIndex = 0;
+        memcpy(&shortIndex, block, sizeof(shortIndex));
+        index = shortIndex == INDEX_END16 ? INDEX_END32 : shortIndex;
+    }
+    else
+    {
+        memcpy(&index, block, sizeof(index));
+    }
+
+    return index == INDEX_END32 ? nullptr : TO_GENERIC_OBJECT_PTR(firstBlock(page) + index * blockSize);
+}
+/********************************************************************************//*!
+ @brief  Links a free block to the block after it on the free list of its page.
+
+ @param  page
+    The page the blocks are in.
+ @param  block
+    The free block to link.
+ @param  next
+    The next free block, or a nullptr at the end of the list.
+*//*********************************************************************************/
+void ObjectAllocator::linkFree(GenericObject* page, GenericObject* block, GenericObject* next)
+{
+    if (linkSize == PTR_SIZE)
+    {
+        block->Next = next;
+        return;
+    }
+
+    const uint32_t index = next ? static_cast<uint32_t>(blockIndex(page, TO_UCHAR_PTR(next))) : INDEX_END32;
+    if (linkSize == sizeof(uint16_t))
+    {
+        const uint16_t shortIndex = static_cast<uint16_t>(index);
+        memcpy(block, &shortIndex, sizeof(shortIndex));
+    }
+    else
+    {
+        memcpy(block, &index, sizeof(index));
+    }
+}
+/********************************************************************************//*!
+ @brief  Records a block as allocated or free in the bitmap of its page.
+        Only maintained for hbNone while debugging, as headers carry a flag.
+
+ @param  page
+    The page the block is in.
+ @param  block
+    The block to record the state of.
+ @param  flag
+    True if in use. False if not.
+*//*********************************************************************************/
+void ObjectAllocator::setBlockAllocated(GenericObject* page, unsigned char* block, bool flag)
+{
+    const size_t index = blockIndex(page, block);
+    unsigned char* bits = pageInfo(page)->allocated + index / 8;
+    const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
+
+    *bits = flag ? (*bits | mask) : (*bits & ~mask);
+}
+/********************************************************************************//*!
+ @brief  Records whether a block was picked for debug checks in the bitmap of its
+        page. Only maintained for hbNone while sampling, as headers carry a flag.
 
-        GenericObject* currentBlock = FreeList_;
-        GenericObject* nextBlock    = TO_GENERIC_OBJECT_PTR(cFL + offset);
+ @param  page
+    The page the block is in.
+ @param  block
+    The block to record the state of.
+ @param  flag
+    True if picked. False if not.
+*//*********************************************************************************/
+void ObjectAllocator::setBlockSampled(GenericObject* page, unsigned char* block, bool flag)
+{
+    const size_t index = blockIndex(page, block);
+    unsigned char* bits = pageInfo(page)->sampled + index / 8;
+    const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
 
-        FreeList_ = i ? nextBlock : TO_GENERIC_OBJECT_PTR(cP + offset);
-        FreeList_->Next = i ? currentBlock : nullptr;
+    *bits = flag ? (*bits | mask) : (*bits & ~mask);
+}
+/********************************************************************************//*!
+ @brief  Checks if a block was picked for debug checks when it was last allocated.
+        A freed block keeps the mark until it is allocated again.
 
-        cFL = TO_UCHAR_PTR(FreeList_);
+ @param  page
+    The page the block is in. Only needed for hbNone.
+ @param  block
+    The block to check.
 
-        // Set headers 
-        switch (config.HBlockInfo_.type_)
+ @return True if the block was picked.
+*//*********************************************************************************/
+bool ObjectAllocator::isBlockSampled(GenericObject* page, unsigned char* block) const
+{
+    switch (config.HBlockInfo_.type_)
+    {
+        case OAConfig::hbNone:
         {
-            case OAConfig::hbBasic:
-            case OAConfig::hbExtended:
-            {
-                setHeaderFlag(cFL, false);
-                setHeaderAllocNumber(cFL, 0);
-
-                // Set use count and user-defined bytes for extended header
-                if (config.HBlockInfo_.type_ == OAConfig::hbExtended)
-                {
-                    size_t numBytes = config.HBlockInfo_.size_ - sizeof(unsigned char) - sizeof(int);
-                    memset(header(cFL), 0, numBytes);
-                }
-
-                break;
-            }
-            case OAConfig::hbExternal:
-            {
-                memset(header(cFL), 0, config.HBlockInfo_.size_);
-                break;
-            }
-            default: break;
-        } 
-
-        if (i != config.ObjectsPerPage_ -1)
+            const size_t index = blockIndex(page, block);
+            return (pageInfo(page)->sampled[index / 8] >> (index % 8)) & 1u;
+        }
+        case OAConfig::hbBasic:
+        case OAConfig::hbExtended:
         {
-            setInterAlignment(cFL);
+            unsigned char* flag = block - config.PadBytes_ - sizeof(char);
+            return (*flag & HEADER_SAMPLED) != 0;
         }
-        setPattern(cFL, PAD_PATTERN);
-        setPattern(cFL, UNALLOCATED_PATTERN);
+        case OAConfig::hbExternal:
+        {
+            MemBlockInfo** info = reinterpret_cast<MemBlockInfo**>(header(block));
+            return *info && (*info)->sampled;
+        }
+        default: break;
     }
-}
 
+    return false;
+}
 /********************************************************************************//*!
- @brief  Frees a single page.
+ @brief  Decides whether the next allocation is picked for debug checks. The gaps
+        between picks are random and average DebugSampleRate_.
 
- @param  page
-    The page to free.
+ @return True if the allocation is picked. Always true without sampling.
 *//*********************************************************************************/
-void ObjectAllocator::freePage(GenericObject* page)
+bool ObjectAllocator::takeSample()
 {
-    GenericObject* fL = FreeList_;
-    GenericObject* prev = nullptr;
+    if (config.DebugSampleRate_ <= 1)
+        return true;
 
-    // Traverse freelist
-    while (fL != nullptr)
+    if (--sampleCountdown)
+        return false;
+
+    // xorshift32, then a gap between 1 and twice the rate so the mean is the rate
+    sampleState ^= sampleState << 13;
+    sampleState ^= sampleState >> 17;
+    sampleState ^= sampleState << 5;
+    sampleCountdown = 1 + sampleState % (2 * config.DebugSampleRate_ - 1);
+    return true;
+}
+/********************************************************************************//*!
+ @brief  Rebuilds the allocation bitmaps from the free list. Used when debugging is
+        turned on, as the bitmaps are not maintained while it is off.
+*//*********************************************************************************/
+void ObjectAllocator::syncAllocationState()
+{
+    // Everything is in use unless it is on the free list, and nothing live was sampled
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
     {
-        unsigned char* cFL = TO_UCHAR_PTR(fL);
-        if (isInPage(page, cFL))
+        memset(pageInfo(page)->sampled, 0, (pageInfo(page)->objects + 7) / 8);
+        if (!config.BitmapTracking_)
         {
-            GenericObject* next = fL->Next;
-            (prev ? prev->Next : FreeList_) = next;
-            --stats.FreeObjects_;
+            memset(pageInfo(page)->allocated, 0xFF, (pageInfo(page)->objects + 7) / 8);
         }
-        else
+    }
+
+    // Bitmap tracking keeps the bitmaps up to date all the time
+    if (config.BitmapTracking_)
+        return;
+
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        for (GenericObject* fL = pageInfo(page)->freeList; fL != nullptr; fL = nextFree(page, fL))
         {
-            prev = fL;
+            setBlockAllocated(page, TO_UCHAR_PTR(fL), false);
         }
-        fL = fL->Next;
     }
 
-    delete[] TO_UCHAR_PTR(page);
-    --stats.PagesInUse_;
+    for (GenericObject* fL = FreeList_; fL != nullptr; fL = fL->Next)
+    {
+        unsigned char* cFL = TO_UCHAR_PTR(fL);
+        setBlockAllocated(findPage(cFL), cFL, false);
+    }
 }
 /********************************************************************************//*!
  @brief  Creates a header for a given block. Only call this on Allocate.
 
  @param  block
     The block to create the header for.
+ @param  allocNum
+    The allocation number of the block.
  @param  label 
     The label for an external header. Defaults to a nullptr.
+ @param  sampled
+    Marks the block as picked for debug checks. Defaults to false.
 *//*********************************************************************************/
-void ObjectAllocator::createHeader(unsigned char* block, const char* label)
+void ObjectAllocator::createHeader(unsigned char* block, unsigned allocNum, const char* label, bool sampled)
 {
     switch (config.HBlockInfo_.type_)
     {
         case OAConfig::hbBasic:
         case OAConfig::hbExtended:
         {
-            setHeaderFlag(block, true);
-            setHeaderAllocNumber(block, stats.Allocations_);
+            setHeaderFlag(block, true, sampled);
+            setHeaderAllocNumber(block, allocNum);
             
             // Set use count for extended headers
             if (config.HBlockInfo_.type_ == OAConfig::hbExtended)
@@ -513,19 +2554,21 @@ void ObjectAllocator::createHeader(unsigned char* block, const char* label)
 
             try
             {
-                *info = new MemBlockInfo;
-                (*info)->alloc_num  = stats.Allocations_;
-                (*info)->in_use     = true;
-                
-                if (label)
-                {
-                    (*info)->label = new char[strlen(label) + 1];
-                    strcpy_s((*info)->label, strlen(label) + 1, label);
-                }
-                else
+                // Intern first, so a failure doesn't lose the record
+                char* interned = label ? internLabel(label) : nullptr;
+                const std::vector<void*>* stack = config.LeakStackDepth_ ? captureStack() : nullptr;
+
+                // A sampled block still has the record it was freed with
+                if (*info == nullptr)
                 {
-                    (*info)->label = nullptr;
+                    *info = takeInfo();
                 }
+                (*info)->alloc_num  = allocNum;
+                (*info)->in_use     = true;
+                (*info)->label      = interned;
+                (*info)->sampled    = sampled;
+                (*info)->counted    = false;
+                (*info)->stack      = stack;
             }
             catch(const std::bad_alloc&)
             {
@@ -544,12 +2587,14 @@ void ObjectAllocator::createHeader(unsigned char* block, const char* label)
     The block to set the header flag for.
  @param  flag 
     The flag to set. True if in use. False if not.
+ @param  sampled
+    Marks the block as picked for debug checks. Defaults to false.
 *//*********************************************************************************/
-void ObjectAllocator::setHeaderFlag(unsigned char* block, bool flag)
+void ObjectAllocator::setHeaderFlag(unsigned char* block, bool flag, bool sampled)
 {
     size_t offset = static_cast<size_t>(config.PadBytes_) + sizeof(char);
     unsigned char* pFlag = block - offset;
-    *pFlag = static_cast<unsigned char>(flag);
+    *pFlag = static_cast<unsigned char>((flag ? HEADER_IN_USE : 0) | (sampled ? HEADER_SAMPLED : 0));
 }
 /********************************************************************************//*!
  @brief  Sets the allocation number for a header. 
@@ -571,15 +2616,18 @@ void ObjectAllocator::setHeaderAllocNumber(unsigned char* block, int num)
 
  @param  block
     The block to destroy the header for.
+ @param  sampled
+    Keeps the mark of a block picked for debug checks, so freeing it again is
+    caught. Defaults to false.
 *//*********************************************************************************/
-void ObjectAllocator::destroyHeader(unsigned char* block)
+void ObjectAllocator::destroyHeader(unsigned char* block, bool sampled)
 {
     switch (config.HBlockInfo_.type_)
     {
         case OAConfig::hbBasic:
         case OAConfig::hbExtended:
         {
-            setHeaderFlag(block, false);
+            setHeaderFlag(block, false, sampled);
             setHeaderAllocNumber(block, 0);
 
             break;
@@ -590,11 +2638,19 @@ void ObjectAllocator::destroyHeader(unsigned char* block)
             unsigned char* header = block - static_cast<size_t>(config.PadBytes_) - config.HBlockInfo_.size_;
             MemBlockInfo** info = reinterpret_cast<MemBlockInfo**>(header);
 
-            // delete label & info
+            // A sampled block keeps its record to remember the mark
+            if (sampled)
+            {
+                (*info)->in_use = false;
+                break;
+            }
+
+            // Return info to the pool, labels stay interned
             if (*info)
             {
-                delete[] (*info)->label;
-                delete *info;
+                GenericObject* record = TO_GENERIC_OBJECT_PTR(*info);
+                record->Next = freeInfos;
+                freeInfos = record;
             }
 
             memset(header, 0, config.HBlockInfo_.size_);
@@ -603,24 +2659,146 @@ void ObjectAllocator::destroyHeader(unsigned char* block)
         default: break;
     }
 }
+/********************************************************************************//*!
+ @brief  Takes a MemBlockInfo record from the pool, adding an array of records if
+        it is empty.
+
+ @return The record taken.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+MemBlockInfo* ObjectAllocator::takeInfo()
+{
+    if (freeInfos == nullptr)
+    {
+        // Each array is as large as all the ones before it
+        size_t count = infoCapacity;
+        if (count == 0)
+            count = config.ObjectsPerPage_ ? config.ObjectsPerPage_ : 1;
+
+        infoChunks.reserve(infoChunks.size() + 1);
+        MemBlockInfo* chunk = new MemBlockInfo[count];
+        infoChunks.push_back(chunk);
+        infoCapacity += count;
+
+        // Free records are linked through their own memory, like free blocks
+        for (size_t i = count; i > 0; --i)
+        {
+            GenericObject* record = TO_GENERIC_OBJECT_PTR(chunk + i - 1);
+            record->Next = freeInfos;
+            freeInfos = record;
+        }
+    }
+
+    MemBlockInfo* info = reinterpret_cast<MemBlockInfo*>(freeInfos);
+    freeInfos = freeInfos->Next;
+    return info;
+}
+/********************************************************************************//*!
+ @brief  Gets the interned copy of a label, interning it the first time it is seen.
+
+ @param  label
+    The label to intern.
+
+ @return The interned copy of the label.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+char* ObjectAllocator::internLabel(const char* label)
+{
+    // Labels are nearly always literals, so the address is checked before the contents.
+    // The compare catches a buffer that has been reused for a different label.
+    auto cached = labelCache.find(label);
+    if (cached != labelCache.end() && strcmp(cached->second, label) == 0)
+        return cached->second;
+
+    // Strings in an unordered_set never move, so their buffers can be handed out
+    char* interned = const_cast<char*>(labels.insert(label).first->c_str());
+    labelCache[label] = interned;
+    return interned;
+}
+/********************************************************************************//*!
+ @brief  Captures the call stack of an allocation and interns it.
+
+ @return The interned stack, or a nullptr if the platform can't capture one.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+const std::vector<void*>* ObjectAllocator::captureStack()
+{
+    static const unsigned MAX_STACK_DEPTH = 64;
+
+    // One more frame is captured so this function can be dropped
+    void* frames[MAX_STACK_DEPTH];
+    const unsigned depth = config.LeakStackDepth_ < MAX_STACK_DEPTH ? config.LeakStackDepth_ + 1 : MAX_STACK_DEPTH;
+
+#if defined(_WIN32)
+    const unsigned captured = CaptureStackBackTrace(0, depth, frames, nullptr);
+#elif defined(OA_HAVE_BACKTRACE)
+    const int result = backtrace(frames, static_cast<int>(depth));
+    const unsigned captured = result > 0 ? static_cast<unsigned>(result) : 0;
+#else
+    const unsigned captured = 0;
+#endif
+
+    if (captured <= 1)
+        return nullptr;
+
+    // Nearly every stack has been seen before, so it is only copied when it is new
+    const size_t hash = hashStack(frames + 1, captured - 1);
+    auto range = stacks.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second.size() == captured - 1 && std::equal(it->second.begin(), it->second.end(), frames + 1))
+            return &it->second;
+    }
+
+    // Vectors in an unordered_multimap never move, so their addresses can be kept
+    return &stacks.emplace(hash, std::vector<void*>(frames + 1, frames + captured))->second;
+}
+/********************************************************************************//*!
+ @brief  Hashes a call stack, so a captured one can be looked up before it is copied.
+
+ @param  frames
+    The return addresses of the stack.
+ @param  count
+    The number of frames.
+
+ @return The hash of the stack.
+*//*********************************************************************************/
+size_t ObjectAllocator::hashStack(void* const* frames, size_t count)
+{
+    size_t hash = count;
+    for (size_t i = 0; i < count; ++i)
+    {
+        hash = hash * 31 + reinterpret_cast<uintptr_t>(frames[i]);
+    }
+    return hash;
+}
 /********************************************************************************//*!
  @brief  Increments the stats. Only to be called in Allocate.
+
+ @param  count
+    The number of objects allocated. Defaults to 1.
 *//*********************************************************************************/
-void ObjectAllocator::incrementStats()
+void ObjectAllocator::incrementStats(unsigned count)
 {
-    ++stats.Allocations_;
-    ++stats.ObjectsInUse_;
-    --stats.FreeObjects_;
+    stats.Allocations_ += count;
+    stats.ObjectsInUse_ += count;
+    stats.FreeObjects_ -= count;
     stats.MostObjects_ = MAX(stats.MostObjects_, stats.ObjectsInUse_);
 }
 /********************************************************************************//*!
  @brief  Decrements the stats. Only to be called in Free.
+
+ @param  count
+    The number of objects freed. Defaults to 1.
 *//*********************************************************************************/
-void ObjectAllocator::decrementStats()
+void ObjectAllocator::decrementStats(unsigned count)
 {
-    ++stats.Deallocations_;
-    ++stats.FreeObjects_;
-    --stats.ObjectsInUse_;
+    stats.Deallocations_ += count;
+    stats.FreeObjects_ += count;
+    stats.ObjectsInUse_ -= count;
 }
 /********************************************************************************//*!
  @brief  Computes the alignment for an offset with respect to an alignment value.
@@ -665,7 +2843,8 @@ unsigned char* ObjectAllocator::header(unsigned char* block) const
     return block - (config.PadBytes_ + config.HBlockInfo_.size_); 
 }
 /********************************************************************************//*!
- @brief  Checks if a page is empty.
+ @brief  Checks if a page is empty. Without PageFreeLists_, the free counts must have
+        been updated by countFreeBlocks first.
 
  @param  page
     The page to check.
@@ -674,20 +2853,21 @@ unsigned char* ObjectAllocator::header(unsigned char* block) const
 *//*********************************************************************************/
 bool ObjectAllocator::isPageEmpty(GenericObject* page) const
 {
-    GenericObject* fL = this->FreeList_;
-    unsigned int freeBlocks = 0;
+    return pageInfo(page)->freeCount >= pageInfo(page)->objects;
+}
+/********************************************************************************//*!
+ @brief  Checks if an empty page is to be freed.
 
-    while (fL)
-    {
-        unsigned char* cFL = TO_UCHAR_PTR(fL);
-        if (isInPage(page, cFL))
-        {
-            if (++freeBlocks >= config.ObjectsPerPage_)
-                return true;
-        }
-        fL = fL->Next;
-    }
-    return false;
+ @param  page
+    The page to check.
+ @param  markedOnly
+    Only pages marked by ReclaimIdlePages are to be freed.
+
+ @return True if the page is empty and, if markedOnly, marked.
+*//*********************************************************************************/
+bool ObjectAllocator::isPageToFree(GenericObject* page, bool markedOnly) const
+{
+    return isPageEmpty(page) && (!markedOnly || pageInfo(page)->idleScans == RECLAIM_MARK);
 }
 /********************************************************************************//*!
  @brief  Checks if a block is in a page.
@@ -702,38 +2882,39 @@ bool ObjectAllocator::isPageEmpty(GenericObject* page) const
 bool ObjectAllocator::isInPage(GenericObject* page, unsigned char* block) const
 {
     unsigned char* cP = TO_UCHAR_PTR(page);
-    return block > cP && block < (cP + stats.PageSize_);
+    return block > cP && block < (cP + pageSizeFor(pageInfo(page)->objects));
 }
 /********************************************************************************//*!
- @brief  Checks if a block as been allocated.
+ @brief  Checks if a block as been allocated. Runs in constant time.
 
+ @param  page
+    The page the block is in.
  @param  block
     The block to check for.
 
  @return True if the block has been allocated.
 *//*********************************************************************************/
-bool ObjectAllocator::isBlockAllocated(unsigned char* block) const
+bool ObjectAllocator::isBlockAllocated(GenericObject* page, unsigned char* block) const
 {
     switch (config.HBlockInfo_.type_)
     {
         case OAConfig::hbNone:
         {
-            GenericObject* b    = TO_GENERIC_OBJECT_PTR(block);
-            GenericObject* fL   = FreeList_;
-
-            // Iterate through free list and compare addresses
-            while (fL != nullptr)
-            {
-                // If block is on the free list, it is unallocated
-                if (fL == b)
-                    return false;
-                
-                fL = fL->Next;
-            }
-
-            // Block cannot be found on the free list, therefore it has been allocated
-            return true;
-        }   
+            // No header to look at, so check the bitmap of the page
+            const size_t index = blockIndex(page, block);
+            return (pageInfo(page)->allocated[index / 8] >> (index % 8)) & 1u;
+        }
+        case OAConfig::hbBasic:
+        case OAConfig::hbExtended:
+        {
+            unsigned char* flag = block - config.PadBytes_ - sizeof(char);
+            return (*flag & HEADER_IN_USE) != 0;
+        }
+        case OAConfig::hbExternal:
+        {
+            MemBlockInfo** info = reinterpret_cast<MemBlockInfo**>(header(block));
+            return *info && (*info)->in_use;
+        }
         default: break;
     }
 
@@ -759,8 +2940,11 @@ void ObjectAllocator::setPattern(unsigned char* block, unsigned char pattern)
         case UNALLOCATED_PATTERN:
         case FREED_PATTERN:
         {
-            unsigned char* patternHead = block + PTR_SIZE;
-            interval = stats.ObjectSize_ - PTR_SIZE;
+            if (stats.ObjectSize_ <= linkSize)
+                break;
+
+            unsigned char* patternHead = block + linkSize;
+            interval = stats.ObjectSize_ - linkSize;
 
             memset(patternHead, pattern, interval);
 
@@ -818,12 +3002,14 @@ void ObjectAllocator::setInterAlignment(unsigned char* block)
  @param  data
     The data to check for.
 
+ @return The page the data is in, or a nullptr if debugging is off.
+
  @throws OAException, based on the type of invalid free.
 *//*********************************************************************************/
-void ObjectAllocator::checkForInvalidFree(void* block) const
+GenericObject* ObjectAllocator::checkForInvalidFree(void* block) const
 {
     if (!config.DebugOn_)
-        return;
+        return nullptr;
 
     void* currentPage = nullptr;
     unsigned char* currentBlock = TO_UCHAR_PTR(block);
@@ -836,7 +3022,9 @@ void ObjectAllocator::checkForInvalidFree(void* block) const
         throw OAException{OAException::E_CORRUPTED_BLOCK, "Pad bytes have been overwritten."};
     }
 
-    checkMultipleFree(currentBlock);
+    checkMultipleFree(currentPage, currentBlock);
+
+    return TO_GENERIC_OBJECT_PTR(currentPage);
 }
 /********************************************************************************//*!
  @brief  Checks if the data is within any of the allocated pages. 
@@ -853,19 +3041,13 @@ void ObjectAllocator::checkForInvalidFree(void* block) const
 void ObjectAllocator::checkWithinPages(unsigned char* block, void*& currentPage) const
 {
     // Check if block is within a pages
-    GenericObject* page = PageList_;
-    while(page != nullptr)
+    GenericObject* page = findPage(block);
+    if (page == nullptr)
     {
-        if (isInPage(page, block))
-        {
-            currentPage = page;
-            return;
-        }
-
-        page = page->Next;
+        throw OAException{OAException::E_BAD_BOUNDARY, "Object address is not within a page."};
     }
-    // return false;
-    throw OAException{OAException::E_BAD_BOUNDARY, "Object address is not within a page."};
+
+    currentPage = page;
 }
 /********************************************************************************//*!
  @brief  Checks if the data is aligned within a page or to the specified alignment.
@@ -900,6 +3082,137 @@ void ObjectAllocator::checkAlignment(void* currentPage, unsigned char* block) co
         throw OAException{OAException::E_BAD_BOUNDARY, "Object that is trying to be freed is misaligned."};
     }
 }
+/********************************************************************************//*!
+ @brief  Checks a block the way ValidatePages does.
+
+ @param  page
+    The page the block is in.
+ @param  block
+    The block to check.
+ @param  checkFreed
+    Whether a free block is checked for writes since it was freed. Only pass true
+    while debugging.
+
+ @return True if corrupted.
+*//*********************************************************************************/
+bool ObjectAllocator::isBlockCorrupted(GenericObject* page, unsigned char* block, bool checkFreed) const
+{
+    // Only sampled blocks hold a pattern when sampling
+    const bool sampling = config.DebugSampleRate_ > 1;
+    const bool freeChecked = checkFreed && !isBlockAllocated(page, block) && (!sampling || isBlockSampled(page, block));
+    return checkCorruption(block) || (freeChecked && checkFreedBlock(block));
+}
+/********************************************************************************//*!
+ @brief  Finds blocks with worker threads and calls the callback for each one on the
+        calling thread, in page list order.
+
+ @param  threads
+    The number of threads to use, including the calling thread. 0 uses one per
+    hardware thread.
+ @param  match
+    Decides if a block is reported. Called from every worker at once.
+ @param  fn
+    The callback function for each block found.
+
+ @return The number of blocks found.
+
+ @throws std::bad_alloc if there is no memory left for the buffers.
+*//*********************************************************************************/
+template <typename Match>
+unsigned ObjectAllocator::findBlocksParallel(unsigned threads, const Match& match, VALIDATECALLBACK fn) const
+{
+    // Small enough to balance pages of different sizes, large enough to keep the
+    // workers off the shared counter
+    static const size_t PAGES_PER_CHUNK = 16;
+
+    std::vector<GenericObject*> pages;
+    pages.reserve(stats.PagesInUse_);
+    for (GenericObject* page = PageList_; page != nullptr; page = page->Next)
+    {
+        pages.push_back(page);
+    }
+
+    const size_t chunks = (pages.size() + PAGES_PER_CHUNK - 1) / PAGES_PER_CHUNK;
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(threads, chunks)));
+
+    // Every chunk has its own buffer, so merging keeps the page list order
+    std::vector<std::vector<const void*>> found(chunks);
+    std::atomic<size_t> nextChunk { 0 };
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    auto worker = [&]()
+    {
+        try
+        {
+            for (size_t chunk = nextChunk++; chunk < chunks; chunk = nextChunk++)
+            {
+                const size_t end = std::min(pages.size(), (chunk + 1) * PAGES_PER_CHUNK);
+                for (size_t i = chunk * PAGES_PER_CHUNK; i < end; ++i)
+                {
+                    unsigned char* block = firstBlock(pages[i]);
+                    for (unsigned j = 0; j < pageInfo(pages[i])->objects; ++j, block += blockSize)
+                    {
+                        if (match(pages[i], block))
+                        {
+                            found[chunk].push_back(block);
+                        }
+                    }
+                }
+            }
+        }
+        catch(...)
+        {
+            // Stop the other workers early and hand the failure to the calling thread
+            nextChunk = chunks;
+            std::lock_guard<std::mutex> guard { failureLock };
+            failure = failure ? failure : std::current_exception();
+        }
+    };
+
+    // The calling thread is a worker too, and carries on alone if no thread starts
+    std::vector<std::thread> workers;
+    try
+    {
+        workers.reserve(threads - 1);
+        for (unsigned i = 1; i < threads; ++i)
+        {
+            workers.emplace_back(worker);
+        }
+    }
+    catch(const std::system_error&)
+    {
+    }
+    catch(const std::bad_alloc&)
+    {
+    }
+
+    worker();
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+
+    unsigned count = 0;
+    for (const std::vector<const void*>& buffer : found)
+    {
+        for (const void* block : buffer)
+        {
+            fn(block, stats.ObjectSize_);
+            ++count;
+        }
+    }
+    return count;
+}
 /********************************************************************************//*!
  @brief  Checks if left or right padding has been corrupted.
 
@@ -924,33 +3237,84 @@ bool ObjectAllocator::checkCorruption(unsigned char* block) const
 *//*********************************************************************************/
 bool ObjectAllocator::checkPadding(unsigned char* padPtr) const
 {
-    for (size_t i = 0; i < config.PadBytes_; ++i)
-    { 
-        if (padPtr[i] != PAD_PATTERN)
+    return matchesPattern(padPtr, config.PadBytes_, PAD_PATTERN);
+}
+/********************************************************************************//*!
+ @brief  Checks if a free block has been written to since it was freed.
+
+ @param  block
+    The free block to check.
+
+ @return True if corrupted.
+*//*********************************************************************************/
+bool ObjectAllocator::checkFreedBlock(unsigned char* block) const
+{
+    if (stats.ObjectSize_ <= linkSize)
+        return false;
+
+    // The link is skipped. Blocks never handed out still hold the unallocated pattern.
+    unsigned char* patternHead = block + linkSize;
+    const unsigned char pattern = *patternHead == UNALLOCATED_PATTERN ? UNALLOCATED_PATTERN : FREED_PATTERN;
+    return !matchesPattern(patternHead, stats.ObjectSize_ - linkSize, pattern);
+}
+/********************************************************************************//*!
+ @brief  Checks if every byte in a range holds a pattern. Compares 32 or 16 bytes at
+        a time where AVX2 or SSE2 is available, and finishes the tail byte by byte.
+
+ @param  bytes
+    The start of the range.
+ @param  count
+    The number of bytes in the range.
+ @param  pattern
+    The pattern every byte should hold.
+
+ @return True if every byte matches.
+*//*********************************************************************************/
+bool ObjectAllocator::matchesPattern(const unsigned char* bytes, size_t count, unsigned char pattern)
+{
+    size_t i = 0;
+
+#if defined(OA_SIMD_AVX2)
+    const __m256i wide = _mm256_set1_epi8(static_cast<char>(pattern));
+    for (; i + 32 <= count; i += 32)
+    {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, wide)) != -1)
+            return false;
+    }
+#endif
+#if defined(OA_SIMD_AVX2) || defined(OA_SIMD_SSE2)
+    const __m128i narrow = _mm_set1_epi8(static_cast<char>(pattern));
+    for (; i + 16 <= count; i += 16)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, narrow)) != 0xFFFF)
+            return false;
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        if (bytes[i] != pattern)
             return false;
     }
     return true;
 }
 /********************************************************************************//*!
  @brief  Checks if the block has already been freed.
+        MUST BE CALLED AFTER checkWithinPages
 
+ @param  currentPage
+    The page to be check in.
  @param  block
     The block to check for.
     
  @throws OAException for multiple frees.
 *//*********************************************************************************/
-void ObjectAllocator::checkMultipleFree(unsigned char* block) const
+void ObjectAllocator::checkMultipleFree(void* currentPage, unsigned char* block) const
 {
-    // Compare against all items in the free list
-    GenericObject* b = TO_GENERIC_OBJECT_PTR(block);
-    GenericObject* fL = FreeList_;
-
-    while(fL != nullptr)
+    if (!isBlockAllocated(TO_GENERIC_OBJECT_PTR(currentPage), block))
     {
-        if (b == fL)
-        {
-            throw OAException{OAException::E_MULTIPLE_FREE, "Object has already been freed."};
-        }
-        fL = fL->Next;
+        throw OAException{OAException::E_MULTIPLE_FREE, "Object has already been freed."};
     }
 }
\ No newline at end of file
@@ -15,7 +15,15 @@
 #define OBJECTALLOCATORH
 
 // Standard Libraries
+#include <chrono>
 #include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
+#include <memory>
+// Project Headers
+#include "OATelemetry.h"
 
 /*-------------------------------------------------------------------------------------*/
 /* Global Variables                                                                    */
@@ -26,10 +34,17 @@
 static const int DEFAULT_OBJECTS_PER_PAGE   = 4;  
 static const int DEFAULT_MAX_PAGES          = 3;
 
+// Passed to ReleaseAll to keep every page
+
+static const unsigned KEEP_ALL_PAGES        = static_cast<unsigned>(-1);
+
 /*-------------------------------------------------------------------------------------*/
 /* Type  Definitions                                                                   */
 /*-------------------------------------------------------------------------------------*/ 
 
+class PageProvider;
+class GuardedPool;
+
 /************************************************************************************//*!
  @brief  Exception Class.
 *//*************************************************************************************/
@@ -188,9 +203,22 @@ struct OAConfig
         Information about the header blocks used. 
     @param  Alignment
         The number of bytes to align on. Defaults to 0.
+    @param  AlignPages
+        Places every page on a power-of-two aligned address so the page owning a block
+        is found in constant time. Defaults to false.
+
+    PageFreeLists_, PageProvider_, MaxObjectsPerPage_, DebugSampleRate_,
+    GuardedSlots_, Telemetry_, LeakStackDepth_, BitmapTracking_, LowWatermark_ and
+    IndexedLinks_ are set on the members directly.
+
+    Sampling with DebugSampleRate_ is cheapest with a header, which carries the mark
+    of a block. With hbNone, every Allocate and Free still finds the page of its block
+    to keep the allocation and sample bits, in O(log pages) unless AlignPages is set,
+    so blocks that aren't picked cost about 1.5x a release build rather than nothing.
     *//*********************************************************************************/
     OAConfig(bool UseCPPMemManager = false, unsigned ObjectsPerPage = DEFAULT_OBJECTS_PER_PAGE, unsigned MaxPages = DEFAULT_MAX_PAGES, 
-             bool DebugOn = false, unsigned PadBytes = 0, const HeaderBlockInfo &HBInfo = HeaderBlockInfo(), unsigned Alignment = 0) 
+             bool DebugOn = false, unsigned PadBytes = 0, const HeaderBlockInfo &HBInfo = HeaderBlockInfo(), unsigned Alignment = 0,
+             bool AlignPages = false) 
     : UseCPPMemManager_ (UseCPPMemManager)
     , ObjectsPerPage_   (ObjectsPerPage)
     , MaxPages_         (MaxPages)
@@ -198,6 +226,17 @@ struct OAConfig
     , PadBytes_         (PadBytes)
     , HBlockInfo_       (HBInfo)
     , Alignment_        (Alignment)
+    , AlignPages_       (AlignPages)
+    , PageFreeLists_    (false)
+    , PageProvider_     (nullptr)
+    , MaxObjectsPerPage_(0)
+    , DebugSampleRate_  (0)
+    , GuardedSlots_     (0)
+    , Telemetry_        (false)
+    , LeakStackDepth_   (0)
+    , BitmapTracking_   (false)
+    , LowWatermark_     (0)
+    , IndexedLinks_     (false)
     {
         HBlockInfo_     = HBInfo;
         LeftAlignSize_  = 0;  
@@ -214,6 +253,17 @@ struct OAConfig
     unsigned        PadBytes_;          //!< size of the left/right padding for each block
     HeaderBlockInfo HBlockInfo_;        //!< size of the header for each block (0=no headers)
     unsigned        Alignment_;         //!< address alignment of each block
+    bool            AlignPages_;        //!< place pages on power-of-two boundaries for O(1) page lookup
+    bool            PageFreeLists_;     //!< keep a free list per page and allocate from partial pages first
+    PageProvider*   PageProvider_;      //!< where the memory for pages comes from (nullptr=operator new)
+    unsigned        MaxObjectsPerPage_; //!< each new page doubles its objects up to this (0=no growth)
+    unsigned        DebugSampleRate_;   //!< when debugging, check about 1 in this many allocations (0/1=all)
+    unsigned        GuardedSlots_;      //!< sampled allocations placed against guard pages at once (0=none)
+    bool            Telemetry_;         //!< record latencies and label counters for GetTelemetry
+    unsigned        LeakStackDepth_;    //!< return addresses kept per block for GetLeakReport, the allocator's own included, hbExternal only (0=none)
+    bool            BitmapTracking_;    //!< track free blocks in the page bitmaps instead of a list through them (implies PageFreeLists_)
+    unsigned        LowWatermark_;      //!< free objects that Refill tops the allocator back up to (0=none)
+    bool            IndexedLinks_;      //!< link free blocks by their 16-bit (or 32-bit for pages over 65534 blocks) index in the page instead of a pointer, so objects smaller than a pointer pack densely (implies PageFreeLists_)
     unsigned        LeftAlignSize_;     //!< number of alignment bytes required to align first block
     unsigned        InterAlignSize_;    //!< number of alignment bytes required between remaining blocks
 };
@@ -244,7 +294,7 @@ struct OAStats
     /* Data Members                                                                    */
     /*---------------------------------------------------------------------------------*/
     size_t      ObjectSize_;    //!< size of each object
-    size_t      PageSize_;      //!< size of a page including all headers, padding, etc.
+    size_t      PageSize_;      //!< size of a page including all headers, padding, etc. (the first page when growing)
     unsigned    FreeObjects_;   //!< number of objects on the free list
     unsigned    ObjectsInUse_;  //!< number of objects in use by client
     unsigned    PagesInUse_;    //!< number of pages allocated
@@ -253,6 +303,33 @@ struct OAStats
     unsigned    Deallocations_; //!< total requests to free memory
 };
 
+/************************************************************************************//*!
+ @brief  The blocks in use that were allocated from one place
+*//*************************************************************************************/
+struct OALeakSite
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /****************************************************************************//*!
+    @brief  Default constructor for OALeakSite
+    *//*****************************************************************************/
+    OALeakSite()
+    : Objects_          (0)
+    , Bytes_            (0)
+    , OldestAllocation_ (0)
+    {};
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    std::string         Label_;             //!< the label of the blocks, empty if none or not kept
+    std::vector<void*>  Stack_;             //!< return addresses of the allocation, innermost first (LeakStackDepth_ only)
+    unsigned            Objects_;           //!< number of blocks in use
+    size_t              Bytes_;             //!< bytes of those blocks
+    unsigned            OldestAllocation_;  //!< lowest allocation number of those blocks (0=unknown)
+};
+
 /************************************************************************************//*!
  @brief  Allows us to easily treat raw objects as nodes in a linked list
 *//*************************************************************************************/
@@ -273,8 +350,32 @@ struct MemBlockInfo
     /* Data Members                                                                    */
     /*---------------------------------------------------------------------------------*/
     bool in_use;        //!< Is the block free or in use?
-    char *label;        //!< A dynamically allocated NUL-terminated string
+    char *label;        //!< An interned NUL-terminated string, owned by the allocator
     unsigned alloc_num; //!< The allocation number (count) of this block
+    bool sampled;       //!< Was the block picked for debug checks? (DebugSampleRate_ only)
+    bool counted;       //!< Is the block in the live objects of its label? (Telemetry_ only)
+    const std::vector<void*> *stack;    //!< The interned call stack of the allocation (LeakStackDepth_ only)
+};
+
+/************************************************************************************//*!
+ @brief  Bookkeeping that lives immediately in front of every page. The page itself
+         (and therefore PageSize_) starts right after it, so the page layout seen by the
+         client is unchanged.
+*//*************************************************************************************/
+struct PageInfo
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    unsigned char *allocated;   //!< One bit per block, set while the client owns the block (hbNone while debugging, or BitmapTracking_)
+    unsigned char *sampled;     //!< One bit per block, set if it was picked for debug checks (DebugSampleRate_ only)
+    GenericObject *freeList;    //!< The free blocks on this page (PageFreeLists_ only)
+    unsigned       freeCount;   //!< Number of free blocks on this page
+    unsigned       objects;     //!< Number of blocks on this page
+    unsigned       firstFree;   //!< No byte of allocated before this one has a free block (BitmapTracking_ only)
+    unsigned       idleScans;   //!< Scans by ReclaimIdlePages in a row that found the page empty
+    PageInfo      *prev;        //!< Previous page in the partial or empty list (PageFreeLists_ only)
+    PageInfo      *next;        //!< Next page in the partial or empty list (PageFreeLists_ only)
 };
 
 /************************************************************************************//*!
@@ -290,6 +391,7 @@ public:
 
     typedef void (*DUMPCALLBACK)(const void *, size_t);     //!< Callback function when dumping memory leaks
     typedef void (*VALIDATECALLBACK)(const void *, size_t); //!< Callback function when validating blocks
+    typedef void (*RELOCATECALLBACK)(void *, void *, void *);   //!< Callback function when an object is moved (context, from, to)
 
     /*---------------------------------------------------------------------------------*/
     /* Static Data Members                                                             */
@@ -308,7 +410,8 @@ public:
     @brief  Creates the ObjectAllocator per the specified values
 
     @param  ObjectSize
-        The size of each object in a block.
+        The size of each object in a block. A size smaller than the link a free block
+        holds is rounded up to it.
     @param  config
         The configuration properties for the allocator.
 
@@ -352,9 +455,40 @@ public:
     *//*********************************************************************************/
     void Free(void *Object);
 
+    /********************************************************************************//*!
+    @brief  Takes a number of objects from the free list and gives them to the client.
+            Pages that are needed are created up front, and the stats are updated once.
+
+    @param  count
+        The number of objects to allocate.
+    @param  objects
+        Receives the allocated objects. Must have room for count pointers.
+    @param  label
+        The label for external headers.
+
+    @throws An exception from OAException if the objects can't be allocated. No objects
+            are allocated in that case.
+    *//*********************************************************************************/
+    void AllocateBatch(unsigned count, void** objects, const char *label = 0);
+
+    /********************************************************************************//*!
+    @brief  Returns a number of objects to the free list for the client. The stats are
+            updated once.
+
+    @param  objects
+        The objects to return to the free list.
+    @param  count
+        The number of objects.
+
+    @throws An exception from OAException if an object can't be freed. The objects
+            before it have been freed in that case.
+    *//*********************************************************************************/
+    void FreeBatch(void** objects, unsigned count);
+
     /********************************************************************************//*!
     @brief  Calls the callback function for each block still in use.
-            Returns the number of blocks in use by the client.
+            Returns the number of blocks in use by the client. Blocks without
+            headers can only be listed with BitmapTracking_.
 
     @param  fn
         The callback function for dumping the memory in use.
@@ -363,27 +497,165 @@ public:
     *//*********************************************************************************/
     unsigned DumpMemoryInUse(DUMPCALLBACK fn) const;
 
+    /********************************************************************************//*!
+    @brief  Like DumpMemoryInUse, but the pages are split between worker threads.
+            Each worker buffers the blocks it finds and the callback is called on
+            the calling thread afterwards, in the same order as DumpMemoryInUse.
+
+    @param  fn
+        The callback function for dumping the memory in use.
+    @param  threads
+        The number of threads to walk the pages with, including the calling
+        thread. 0 uses one per hardware thread. Defaults to 0.
+
+    @return Returns the number of blocks in use by the client.
+
+    @throws std::bad_alloc if there is no memory left for the buffers.
+    *//*********************************************************************************/
+    unsigned DumpMemoryInUseParallel(DUMPCALLBACK fn, unsigned threads = 0) const;
+
+    /********************************************************************************//*!
+    @brief  Groups the blocks still in use by where they were allocated. Blocks are
+            told apart by label and call stack with hbExternal, and their allocation
+            numbers are read with hbBasic and hbExtended. Blocks that carry neither,
+            such as those without headers or in guarded slots, share a site with an
+            empty label and an oldest allocation of 0.
+
+    @return The sites, by most bytes in use.
+
+    @throws std::bad_alloc if there is no memory left for the report.
+    *//*********************************************************************************/
+    std::vector<OALeakSite> GetLeakReport() const;
+
     /********************************************************************************//*!
     @brief  Calls the callback fn for each block that is potentially corrupted.
 
     @param  fn
         The callback function for dumping the memory in use.
+    @param  checkFreed
+        Also reports free blocks whose FREED_PATTERN or UNALLOCATED_PATTERN has been
+        overwritten. Only done while debugging. Blocks freed while debugging was off
+        hold no pattern and are reported too. Defaults to false.
 
-    @return Returns the number of blocks that are corrupted. Only pad bytes are validated.
+    @return Returns the number of blocks that are corrupted.
     *//*********************************************************************************/
-    unsigned ValidatePages(VALIDATECALLBACK fn) const;
+    unsigned ValidatePages(VALIDATECALLBACK fn, bool checkFreed = false) const;
+
+    /********************************************************************************//*!
+    @brief  Like ValidatePages, but the pages are split between worker threads. Each
+            worker buffers the blocks it finds and the callback is called on the
+            calling thread afterwards, in the same order as ValidatePages.
+
+    @param  fn
+        The callback function for dumping the memory in use.
+    @param  checkFreed
+        Also reports free blocks whose pattern has been overwritten, as with
+        ValidatePages. Defaults to false.
+    @param  threads
+        The number of threads to walk the pages with, including the calling
+        thread. 0 uses one per hardware thread. Defaults to 0.
+
+    @return Returns the number of blocks that are corrupted.
+
+    @throws std::bad_alloc if there is no memory left for the buffers.
+    *//*********************************************************************************/
+    unsigned ValidatePagesParallel(VALIDATECALLBACK fn, bool checkFreed = false, unsigned threads = 0) const;
 
     /********************************************************************************//*!
     @brief  Returns the number of  pages that was freed
     *//*********************************************************************************/
     unsigned FreeEmptyPages();
 
+    /********************************************************************************//*!
+    @brief  Creates pages up front so that a number of objects can be allocated
+            without creating one, and touches every memory page of them so the first
+            allocations don't fault them in either. Does nothing when using new and
+            delete.
+
+    @param  objectCount
+        The number of objects that need to be free.
+
+    @throws An exception from OAException if the pages can't be created. No pages are
+            created if the maximum number of pages would be exceeded.
+    *//*********************************************************************************/
+    void Reserve(unsigned objectCount);
+
+    /********************************************************************************//*!
+    @brief  Creates and prefaults pages until LowWatermark_ objects are free. Meant to
+            be called at a quiet point, such as between frames, so the pages are ready
+            before the allocations that would otherwise create them.
+
+    @return The number of pages that were created.
+
+    @throws An exception from OAException if the pages can't be created. No pages are
+            created if the maximum number of pages would be exceeded.
+    *//*********************************************************************************/
+    unsigned Refill();
+
+    /********************************************************************************//*!
+    @brief  Frees the empty pages that stayed idle since the last call, keeping enough
+            of them for retainObjects objects to be free. A page must be found empty by
+            two calls in a row, so calling this on a timer frees only pages idle for a
+            whole interval. With PageFreeLists_, a page that was used in between starts
+            over; without it, the free list is counted as in FreeEmptyPages and reuse
+            in between is not seen.
+
+    @param  retainObjects
+        The number of free objects to keep pages for.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned ReclaimIdlePages(unsigned retainObjects);
+
+    /********************************************************************************//*!
+    @brief  Frees every object in use at once, as at the end of a frame or request,
+            without a Free for each. The first keepPages pages of the page list are
+            set up again as new pages, in one pass over each page, and the rest are
+            freed. Pointers to the objects are invalid afterwards, and the headers and
+            patterns of the blocks are reset as for a new page. With BitmapTracking_,
+            no headers and debugging off, only the bitmaps are cleared, so it runs in
+            O(pages). Does nothing when using new and delete, as the objects aren't
+            tracked.
+
+    @param  keepPages
+        The number of pages to keep. Defaults to KEEP_ALL_PAGES.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned ReleaseAll(unsigned keepPages = KEEP_ALL_PAGES);
+
+    /********************************************************************************//*!
+    @brief  Moves the objects out of the sparsest partially filled pages into the
+            fullest ones, so the pages they leave are empty and can be freed with
+            FreeEmptyPages. A page is only emptied if the fuller pages have room for
+            all of its objects. Headers and padding move with the objects. Every
+            pointer to a moved object is invalid afterwards, so the client must be
+            able to find and fix them from the callback, as HandleAllocator does.
+            Needs PageFreeLists_, or an option that implies it, and does nothing
+            otherwise or when using new and delete. Objects in guarded slots are
+            never moved.
+
+    @param  fn
+        Called with context and the old and new address of each object moved, after
+        it has been copied.
+    @param  context
+        Passed to the callback.
+    @param  budget
+        The time to stop after. It is checked after each page is emptied, so at least
+        one page is emptied if any can be. 0 means no limit.
+
+    @return The number of objects that were moved.
+    *//*********************************************************************************/
+    unsigned Compact(RELOCATECALLBACK fn, void* context, std::chrono::microseconds budget);
+
     /*---------------------------------------------------------------------------------*/
     /* Getter Functions                                                                */
     /*---------------------------------------------------------------------------------*/
 
     /********************************************************************************//*!
-    @brief  Gets the free list.
+    @brief  Gets the free list. With PageFreeLists_, this is the free list of the page
+            that the next allocation is taken from. There is none with
+            BitmapTracking_.
 
     @return A pointer to the free list.
     *//*********************************************************************************/
@@ -406,6 +678,18 @@ public:
     @return The statistics for the OA.
     *//*********************************************************************************/
     OAStats GetStats() const;
+    /********************************************************************************//*!
+    @brief  Gets a snapshot of the telemetry of the OA. The latencies and label
+            counters are only recorded while Telemetry_ is on. Reading the clock costs
+            more than an allocation, so only one in OATelemetry::TIMING_INTERVAL calls
+            to Allocate and Free is timed, while every batch is. Live objects and bytes
+            per label need hbExternal, as other headers don't keep the label. The page
+            occupancy is worked out here and costs a pass over the free list without
+            PageFreeLists_.
+
+    @return The telemetry of the OA.
+    *//*********************************************************************************/
+    OATelemetry GetTelemetry() const;
 
     /*---------------------------------------------------------------------------------*/
     /* Setter Functions                                                                */
@@ -417,6 +701,20 @@ public:
         The state to set the debug mode to.
     *//*********************************************************************************/
     void SetDebugState(bool State);
+    /********************************************************************************//*!
+    @brief  Turns telemetry on or off. Objects allocated while it is off are not
+            counted against their label. Objects counted while it was on are still
+            uncounted when freed after it is turned off.
+
+    @param  State
+        The state to set telemetry to.
+    *//*********************************************************************************/
+    void SetTelemetryState(bool State);
+    /********************************************************************************//*!
+    @brief  Clears the latency histograms and the allocation count of every label.
+            Live objects and bytes are kept, as those objects are still in use.
+    *//*********************************************************************************/
+    void ResetTelemetry();
 
 private:
     /*---------------------------------------------------------------------------------*/
@@ -428,15 +726,189 @@ private:
     OAConfig        config;     //!< the properties of the allocator
     OAStats         stats;      //!< the statistics of the allocator
     size_t          blockSize;  //!< the size of a block in a page
+    size_t          infoSize;   //!< the size of the PageInfo right in front of a page, rounded up to keep the page aligned
+    size_t          linkSize;   //!< the bytes at the start of a free block taken by its link (0=BitmapTracking_, 2 or 4=IndexedLinks_)
+    size_t          pageSpan;   //!< the power-of-two size and alignment of the first page (0=not aligned)
+    size_t          maxPageSpan;    //!< the span of the largest page, when aligned
+    unsigned        nextObjects;    //!< the number of blocks the next page will hold
+
+    std::vector<unsigned char*>     pageIndex;  //!< the start of every page, sorted by address
+    std::unordered_map<uintptr_t, GenericObject*>   pageSpans;  //!< the page at the base of every page span, when aligned
+
+    PageInfo        *partialPages;  //!< pages with some blocks free (PageFreeLists_ only)
+    PageInfo        *emptyPages;    //!< pages with every block free (PageFreeLists_ only)
+
+    std::vector<MemBlockInfo*>                          infoChunks;     //!< the arrays MemBlockInfo records are served from
+    GenericObject                                       *freeInfos;     //!< MemBlockInfo records not in use
+    size_t                                              infoCapacity;   //!< the number of records in every array together
+    std::unordered_set<std::string>                     labels;         //!< every label seen, interned
+    std::unordered_map<const char*, char*>              labelCache;     //!< the interned copy of each label address seen
+    std::unordered_multimap<size_t, std::vector<void*>> stacks;         //!< every call stack seen by its hash, interned (LeakStackDepth_ only)
+
+    unsigned        sampleCountdown;    //!< allocations left until the next sampled one
+    uint32_t        sampleState;        //!< state of the generator for the sampling gaps
+
+    std::unique_ptr<GuardedPool>    guarded;    //!< slots for sampled blocks between guard pages (GuardedSlots_ only)
+
+    OALatencyHistogram                              allocateTimes;  //!< time per allocation (Telemetry_ only)
+    OALatencyHistogram                              freeTimes;      //!< time per free (Telemetry_ only)
+    OALatencyHistogram                              pageTimes;      //!< time per page created (Telemetry_ only)
+    unsigned                                        allocateTimer;  //!< Allocate calls until the next one is timed
+    unsigned                                        freeTimer;      //!< Free calls until the next one is timed
+    std::unordered_map<const char*, OALabelStats>   labelStats;     //!< the counters of each interned label (Telemetry_ only)
 
     /*---------------------------------------------------------------------------------*/
     /* Function Members                                                                */
     /*---------------------------------------------------------------------------------*/
     /********************************************************************************//*!
+    @brief  Allocates an object. The body of Allocate, without telemetry.
+
+    @param  label
+        The label for an external header.
+
+    @return Pointer to the allocated object.
+    *//*********************************************************************************/
+    void* allocateObject(const char* label);
+    /********************************************************************************//*!
+    @brief  Frees an object. The body of Free, without telemetry.
+
+    @param  Object
+        The object to free.
+    *//*********************************************************************************/
+    void freeObject(void* Object);
+    /********************************************************************************//*!
+    @brief  Allocates a number of objects. The body of AllocateBatch, without telemetry.
+
+    @param  count
+        The number of objects to allocate.
+    @param  objects
+        Receives the allocated objects.
+    @param  label
+        The label for external headers.
+
+    @throws An exception from OAException if the objects can't be allocated. The
+            blocks taken so far are returned to their free lists first.
+    *//*********************************************************************************/
+    void allocateObjects(unsigned count, void** objects, const char* label);
+    /********************************************************************************//*!
+    @brief  Frees a number of objects. The body of FreeBatch, without telemetry.
+
+    @param  objects
+        The objects to free.
+    @param  count
+        The number of objects.
+    *//*********************************************************************************/
+    void freeObjects(void** objects, unsigned count);
+    /********************************************************************************//*!
+    @brief  Counts allocations against their label. Counters that can't be added for
+            lack of memory are dropped rather than failing the allocation.
+
+    @param  label
+        The label the objects were allocated with.
+    @param  count
+        The number of objects.
+    @param  live
+        How many of them are also counted as live, which needs an external header.
+
+    @return True if the counters were added.
+    *//*********************************************************************************/
+    bool countLabel(const char* label, unsigned count, unsigned live);
+    /********************************************************************************//*!
+    @brief  Marks a block as counted in the live objects of its label, so it is
+            uncounted when freed. Only for blocks with an external header.
+
+    @param  block
+        The block that was counted.
+    *//*********************************************************************************/
+    void markCounted(void* block);
+    /********************************************************************************//*!
+    @brief  Uncounts a block that is being freed from the live objects of its label,
+            if it was counted when allocated. MUST BE CALLED BEFORE destroyHeader
+
+    @param  block
+        The block being freed.
+    *//*********************************************************************************/
+    void uncountLabel(unsigned char* block);
+    /********************************************************************************//*!
+    @brief  Takes a block from the free list, creating a page if it is empty.
+
+    @return The block taken.
+    *//*********************************************************************************/
+    unsigned char* takeBlock();
+    /********************************************************************************//*!
+    @brief  Prepares a block that was just taken from the free list for the client.
+
+    @param  block
+        The block to prepare.
+    @param  allocNum
+        The allocation number of the block.
+    @param  label
+        The label for an external header.
+    @param  sampled
+        Whether the block was picked for debug checks.
+    *//*********************************************************************************/
+    void prepareBlock(unsigned char* block, unsigned allocNum, const char* label, bool sampled);
+    /********************************************************************************//*!
+    @brief  Validates a block being freed and marks it as free, without putting it on a
+            free list.
+
+    @param  Object
+        The block being freed.
+
+    @return The page the block is in, or a nullptr if debugging and bitmap tracking
+            are off.
+
+    @throws OAException, based on the type of invalid free. A repeated free always
+            throws with bitmap tracking.
+    *//*********************************************************************************/
+    GenericObject* releaseBlock(void* Object);
+    /********************************************************************************//*!
+    @brief  Puts a released block onto its free list.
+
+    @param  Object
+        The block to put on the free list.
+    @param  page
+        The page the block is in, if already known.
+    *//*********************************************************************************/
+    void pushFree(void* Object, GenericObject* page);
+    /********************************************************************************//*!
+    @brief  Frees a block if it is in a guarded slot.
+
+    @param  Object
+        The block being freed.
+
+    @return True if the block was guarded and is now free.
+
+    @throws OAException, based on the type of invalid free.
+    *//*********************************************************************************/
+    bool freeGuarded(void* Object);
+    /********************************************************************************//*!
+    @brief  Creates enough pages up front for a number of objects to be free.
+
+    @param  count
+        The number of objects that need to be free.
+    @param  prefault
+        Whether to touch the memory of the pages created. Defaults to false.
+
+    @return The number of pages that were created.
+
+    @throws OAException if the pages can't be created. No pages are created if the
+            maximum number of pages would be exceeded.
+    *//*********************************************************************************/
+    unsigned ensureFreeObjects(unsigned count, bool prefault = false);
+    /********************************************************************************//*!
     @brief  Creates a new page.
     *//*********************************************************************************/
     void createPage();
     /********************************************************************************//*!
+    @brief  Touches one byte in every memory page of a page so the system maps it now
+            rather than on first use. The contents are left as they are.
+
+    @param  page
+        The page to touch.
+    *//*********************************************************************************/
+    void prefaultPage(GenericObject* page);
+    /********************************************************************************//*!
     @brief  Inserts a page into the page list.
 
     @param  page
@@ -444,12 +916,14 @@ private:
     *//*********************************************************************************/
     void insertPage(GenericObject* page);
     /********************************************************************************//*!
-    @brief  Sets up the blocks in an empty page and puts them into the free list.
+    @brief  Sets up the blocks in an empty page and puts them into a free list.
 
     @param  page
         The page to set up the blocks in.
+    @param  list
+        The free list to put the blocks into.
     *//*********************************************************************************/
-    void setUpBlocks(GenericObject* page);
+    void setUpBlocks(GenericObject* page, GenericObject*& list);
     /********************************************************************************//*!
     @brief  Frees a single page.
 
@@ -458,14 +932,271 @@ private:
     *//*********************************************************************************/
     void freePage(GenericObject* page);
     /********************************************************************************//*!
+    @brief  Sets up a page again as if it were new, with every block free. The headers
+            of hbExternal blocks must have been destroyed first.
+
+    @param  page
+        The page to set up.
+    *//*********************************************************************************/
+    void resetPage(GenericObject* page);
+    /********************************************************************************//*!
+    @brief  Allocates the memory for a page, including its PageInfo.
+
+    @param  objects
+        The number of blocks the page holds.
+
+    @return The start of the memory, which is where the PageInfo goes.
+
+    @throws std::bad_alloc if there is no memory left.
+    *//*********************************************************************************/
+    unsigned char* allocatePage(unsigned objects);
+    /********************************************************************************//*!
+    @brief  Gets the size of a page, not including its PageInfo.
+
+    @param  objects
+        The number of blocks the page holds.
+
+    @return The size of the page.
+    *//*********************************************************************************/
+    size_t pageSizeFor(unsigned objects) const;
+    /********************************************************************************//*!
+    @brief  Gets the size of the bitmaps and PageInfo in front of a page.
+
+    @param  objects
+        The number of blocks the page holds.
+
+    @return The size of the prefix, a multiple of the alignment of max_align_t.
+    *//*********************************************************************************/
+    size_t prefixSizeFor(unsigned objects) const;
+    /********************************************************************************//*!
+    @brief  Gets the power-of-two span of an aligned page, including its PageInfo.
+
+    @param  objects
+        The number of blocks the page holds.
+
+    @return The span of the page.
+    *//*********************************************************************************/
+    size_t pageSpanFor(unsigned objects) const;
+    /********************************************************************************//*!
+    @brief  Counts the free blocks of every page in a single pass over the free list.
+    *//*********************************************************************************/
+    void countFreeBlocks();
+    /********************************************************************************//*!
+    @brief  Removes the blocks of empty pages from the free list in a single pass.
+            MUST BE CALLED AFTER countFreeBlocks
+
+    @param  markedOnly
+        Only remove the blocks of pages marked by ReclaimIdlePages. Defaults to false.
+    *//*********************************************************************************/
+    void unlinkEmptyPageBlocks(bool markedOnly = false);
+    /********************************************************************************//*!
+    @brief  Frees empty pages. Without PageFreeLists_, their blocks must have been
+            removed from the free list by unlinkEmptyPageBlocks first.
+
+    @param  markedOnly
+        Only free the pages marked by ReclaimIdlePages.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned freeEmptyPages(bool markedOnly);
+    /********************************************************************************//*!
+    @brief  Takes a block from the page free lists, preferring partially filled pages.
+
+    @return The block taken.
+    *//*********************************************************************************/
+    unsigned char* takeFromPages();
+    /********************************************************************************//*!
+    @brief  Takes a block from the free list or bitmap of a page.
+
+    @param  info
+        The PageInfo of the page. Must have a free block.
+
+    @return The block taken.
+    *//*********************************************************************************/
+    unsigned char* takeFromPage(PageInfo* info);
+    /********************************************************************************//*!
+    @brief  Moves an object to a free block of another page and frees the block it was
+            in. The stats don't change, as the object stays in use.
+
+    @param  from
+        The page the object is in.
+    @param  block
+        The object to move.
+    @param  to
+        The PageInfo of the page to move it to. Must have a free block.
+
+    @return The new address of the object.
+    *//*********************************************************************************/
+    unsigned char* moveBlock(GenericObject* from, unsigned char* block, PageInfo* to);
+    /********************************************************************************//*!
+    @brief  Takes the lowest free block of a page from its bitmap. Whole words that
+            are in use are skipped, starting from where the last free block was found.
+            BitmapTracking_ only.
+
+    @param  info
+        The PageInfo of the page. Must have a free block.
+
+    @return The index of the block taken.
+    *//*********************************************************************************/
+    size_t takeFromBitmap(PageInfo* info);
+    /********************************************************************************//*!
+    @brief  Calls the callback function for each block set in the page bitmaps,
+            skipping whole words that are free. BitmapTracking_ only.
+
+    @param  fn
+        The callback function.
+    *//*********************************************************************************/
+    void dumpFromBitmaps(DUMPCALLBACK fn) const;
+    /********************************************************************************//*!
+    @brief  Moves a page onto the partial or empty list to match its free count.
+
+    @param  info
+        The PageInfo of the page.
+    @param  oldCount
+        The free count of the page before it changed.
+    *//*********************************************************************************/
+    void movePage(PageInfo* info, unsigned oldCount);
+    /********************************************************************************//*!
+    @brief  Gets the list a page belongs on for a given free count.
+
+    @param  info
+        The PageInfo of the page.
+    @param  count
+        The free count of the page.
+
+    @return The head of the list, or a nullptr if the page is full.
+    *//*********************************************************************************/
+    PageInfo** pageListFor(const PageInfo* info, unsigned count);
+    /********************************************************************************//*!
+    @brief  Releases the memory of a page, including its PageInfo.
+
+    @param  page
+        The page to release.
+    *//*********************************************************************************/
+    void releasePage(GenericObject* page);
+    /********************************************************************************//*!
+    @brief  Gets the PageInfo stored in front of a page.
+
+    @param  page
+        The page to get the info of.
+
+    @return The PageInfo of the page.
+    *//*********************************************************************************/
+    PageInfo* pageInfo(GenericObject* page) const;
+    /********************************************************************************//*!
+    @brief  Gets the start of the memory of a page, where its bitmaps are.
+
+    @param  page
+        The page to get the start of.
+
+    @return The address the page was allocated at.
+    *//*********************************************************************************/
+    unsigned char* pageStart(GenericObject* page) const;
+    /********************************************************************************//*!
+    @brief  Finds the page a block belongs to. Runs in constant time if pages are aligned
+            or O(log pages) using the sorted page index otherwise.
+
+    @param  block
+        The block to find the page of.
+
+    @return The page the block is in, or a nullptr if it is not within any page.
+    *//*********************************************************************************/
+    GenericObject* findPage(unsigned char* block) const;
+    /********************************************************************************//*!
+    @brief  Gets the index of a block within its page.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The block to get the index of.
+
+    @return The index of the block within the page.
+    *//*********************************************************************************/
+    size_t blockIndex(GenericObject* page, unsigned char* block) const;
+    /********************************************************************************//*!
+    @brief  Gets the block after a free block on the free list of its page, following
+            a pointer or an index as the links are stored.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The free block.
+
+    @return The next free block, or a nullptr at the end of the list.
+    *//*********************************************************************************/
+    GenericObject* nextFree(GenericObject* page, GenericObject* block) const;
+    /********************************************************************************//*!
+    @brief  Links a free block to the block after it on the free list of its page.
+
+    @param  page
+        The page the blocks are in.
+    @param  block
+        The free block to link.
+    @param  next
+        The next free block, or a nullptr at the end of the list.
+    *//*********************************************************************************/
+    void linkFree(GenericObject* page, GenericObject* block, GenericObject* next);
+    /********************************************************************************//*!
+    @brief  Records a block as allocated or free in the bitmap of its page.
+            Only maintained for hbNone while debugging, as headers carry a flag.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The block to record the state of.
+    @param  flag
+        True if in use. False if not.
+    *//*********************************************************************************/
+    void setBlockAllocated(GenericObject* page, unsigned char* block, bool flag);
+    /********************************************************************************//*!
+    @brief  Records whether a block was picked for debug checks in the bitmap of its
+            page. Only maintained for hbNone while sampling, as headers carry a flag.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The block to record the state of.
+    @param  flag
+        True if picked. False if not.
+    *//*********************************************************************************/
+    void setBlockSampled(GenericObject* page, unsigned char* block, bool flag);
+    /********************************************************************************//*!
+    @brief  Checks if a block was picked for debug checks when it was last allocated.
+            A freed block keeps the mark until it is allocated again.
+
+    @param  page
+        The page the block is in. Only needed for hbNone.
+    @param  block
+        The block to check.
+
+    @return True if the block was picked.
+    *//*********************************************************************************/
+    bool isBlockSampled(GenericObject* page, unsigned char* block) const;
+    /********************************************************************************//*!
+    @brief  Decides whether the next allocation is picked for debug checks. The gaps
+            between picks are random and average DebugSampleRate_.
+
+    @return True if the allocation is picked. Always true without sampling.
+    *//*********************************************************************************/
+    bool takeSample();
+    /********************************************************************************//*!
+    @brief  Rebuilds the allocation bitmaps from the free list. Used when debugging is
+            turned on, as the bitmaps are not maintained while it is off.
+    *//*********************************************************************************/
+    void syncAllocationState();
+    /********************************************************************************//*!
     @brief  Creates a header for a given block. Only call this on Allocate.
 
     @param  block
         The block to create the header for.
+    @param  allocNum
+        The allocation number of the block.
     @param  label 
         The label for an external header. Defaults to a nullptr.
+    @param  sampled
+        Marks the block as picked for debug checks. Defaults to false.
     *//*********************************************************************************/
-    void createHeader(unsigned char* block, const char* label = nullptr);
+    void createHeader(unsigned char* block, unsigned allocNum, const char* label = nullptr, bool sampled = false);
     /********************************************************************************//*!
     @brief  Sets the flag for a header. This is only used for basic and extended headers.
 
@@ -473,8 +1204,10 @@ private:
         The block to set the header flag for.
     @param  flag 
         The flag to set. True if in use. False if not.
+    @param  sampled
+        Marks the block as picked for debug checks. Defaults to false.
     *//*********************************************************************************/
-    void setHeaderFlag(unsigned char* block, bool flag);
+    void setHeaderFlag(unsigned char* block, bool flag, bool sampled = false);
     /********************************************************************************//*!
     @brief  Sets the allocation number for a header. 
             This is only used for basic and extended headers.
@@ -490,16 +1223,64 @@ private:
 
     @param  block
         The block to destroy the header for.
+    @param  sampled
+        Keeps the mark of a block picked for debug checks, so freeing it again is
+        caught. Defaults to false.
+    *//*********************************************************************************/
+    void destroyHeader(unsigned char* block, bool sampled = false);
+    /********************************************************************************//*!
+    @brief  Takes a MemBlockInfo record from the pool, adding an array of records if
+            it is empty.
+
+    @return The record taken.
+
+    @throws std::bad_alloc if there is no memory left.
+    *//*********************************************************************************/
+    MemBlockInfo* takeInfo();
+    /********************************************************************************//*!
+    @brief  Gets the interned copy of a label, interning it the first time it is seen.
+
+    @param  label
+        The label to intern.
+
+    @return The interned copy of the label.
+
+    @throws std::bad_alloc if there is no memory left.
+    *//*********************************************************************************/
+    char* internLabel(const char* label);
+    /********************************************************************************//*!
+    @brief  Captures the call stack of an allocation and interns it.
+
+    @return The interned stack, or a nullptr if the platform can't capture one.
+
+    @throws std::bad_alloc if there is no memory left.
+    *//*********************************************************************************/
+    const std::vector<void*>* captureStack();
+    /********************************************************************************//*!
+    @brief  Hashes a call stack, so a captured one can be looked up before it is copied.
+
+    @param  frames
+        The return addresses of the stack.
+    @param  count
+        The number of frames.
+
+    @return The hash of the stack.
     *//*********************************************************************************/
-    void destroyHeader(unsigned char* block);
+    static size_t hashStack(void* const* frames, size_t count);
     /********************************************************************************//*!
     @brief  Increments the stats. Only to be called in Allocate.
+
+    @param  count
+        The number of objects allocated. Defaults to 1.
     *//*********************************************************************************/
-    void incrementStats();
+    void incrementStats(unsigned count = 1);
     /********************************************************************************//*!
     @brief  Decrements the stats. Only to be called in Free.
+
+    @param  count
+        The number of objects freed. Defaults to 1.
     *//*********************************************************************************/
-    void decrementStats();
+    void decrementStats(unsigned count = 1);
     /********************************************************************************//*!
     @brief  Computes the alignment for an offset with respect to an alignment value.
 
@@ -530,7 +1311,8 @@ private:
     *//*********************************************************************************/
     unsigned char* header(unsigned char* block) const;
     /********************************************************************************//*!
-    @brief  Checks if a page is empty.
+    @brief  Checks if a page is empty. Without PageFreeLists_, the free counts must have
+            been updated by countFreeBlocks first.
 
     @param  page
         The page to check.
@@ -539,6 +1321,17 @@ private:
     *//*********************************************************************************/
     bool isPageEmpty(GenericObject* page) const;
     /********************************************************************************//*!
+    @brief  Checks if an empty page is to be freed.
+
+    @param  page
+        The page to check.
+    @param  markedOnly
+        Only pages marked by ReclaimIdlePages are to be freed.
+
+    @return True if the page is empty and, if markedOnly, marked.
+    *//*********************************************************************************/
+    bool isPageToFree(GenericObject* page, bool markedOnly) const;
+    /********************************************************************************//*!
     @brief  Checks if a block is in a page.
 
     @param  page
@@ -550,14 +1343,16 @@ private:
     *//*********************************************************************************/
     bool isInPage(GenericObject* page, unsigned char* block) const;
     /********************************************************************************//*!
-    @brief  Checks if a block as been allocated.
+    @brief  Checks if a block as been allocated. Runs in constant time.
 
+    @param  page
+        The page the block is in.
     @param  block
         The block to check for.
 
     @return True if the block has been allocated.
     *//*********************************************************************************/
-    bool isBlockAllocated(unsigned char* block) const;
+    bool isBlockAllocated(GenericObject* page, unsigned char* block) const;
     /********************************************************************************//*!
     @brief  Sets a pattern for a block. For use in debug mode only.
 
@@ -587,9 +1382,11 @@ private:
     @param  data
         The data to check for.
 
+    @return The page the data is in, or a nullptr if debugging is off.
+
     @throws OAException, based on the type of invalid free.
     *//*********************************************************************************/
-    void checkForInvalidFree(void* data) const;
+    GenericObject* checkForInvalidFree(void* data) const;
     /********************************************************************************//*!
     @brief  Checks if the data is within any of the allocated pages. 
             For use in debug mode only.
@@ -617,6 +1414,40 @@ private:
     *//*********************************************************************************/
     void checkAlignment(void* currentPage, unsigned char* data) const;
     /********************************************************************************//*!
+    @brief  Checks a block the way ValidatePages does.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The block to check.
+    @param  checkFreed
+        Whether a free block is checked for writes since it was freed. Only pass
+        true while debugging.
+
+    @return True if corrupted.
+    *//*********************************************************************************/
+    bool isBlockCorrupted(GenericObject* page, unsigned char* block, bool checkFreed) const;
+    /********************************************************************************//*!
+    @brief  Finds blocks with worker threads and calls the callback for each one on
+            the calling thread, in page list order.
+
+    @param  threads
+        The number of threads to use, including the calling thread. 0 uses one per
+        hardware thread.
+    @param  match
+        Decides if a block is reported, given the page and block. Called from every
+        worker at once, so it may only read the allocator. Only instantiated in the
+        source file.
+    @param  fn
+        The callback function for each block found.
+
+    @return The number of blocks found.
+
+    @throws std::bad_alloc if there is no memory left for the buffers.
+    *//*********************************************************************************/
+    template <typename Match>
+    unsigned findBlocksParallel(unsigned threads, const Match& match, VALIDATECALLBACK fn) const;
+    /********************************************************************************//*!
     @brief  Checks if left or right padding has been corrupted.
 
     @param  block
@@ -635,14 +1466,40 @@ private:
     *//*********************************************************************************/
     bool checkPadding(unsigned char* padPtr) const;
     /********************************************************************************//*!
+    @brief  Checks if a free block has been written to since it was freed.
+
+    @param  block
+        The free block to check.
+
+    @return True if corrupted.
+    *//*********************************************************************************/
+    bool checkFreedBlock(unsigned char* block) const;
+    /********************************************************************************//*!
+    @brief  Checks if every byte in a range holds a pattern. Compares 32 or 16 bytes at
+            a time where AVX2 or SSE2 is available, and finishes the tail byte by byte.
+
+    @param  bytes
+        The start of the range.
+    @param  count
+        The number of bytes in the range.
+    @param  pattern
+        The pattern every byte should hold.
+
+    @return True if every byte matches.
+    *//*********************************************************************************/
+    static bool matchesPattern(const unsigned char* bytes, size_t count, unsigned char pattern);
+    /********************************************************************************//*!
     @brief  Checks if the block has already been freed.
+            MUST BE CALLED AFTER checkWithinPages
 
+    @param  currentPage
+        The page to be check in.
     @param  block
         The block to check for.
         
     @throws OAException for multiple frees.
     *//*********************************************************************************/
-    void checkMultipleFree(unsigned char* block) const;
+    void checkMultipleFree(void* currentPage, unsigned char* block) const;
 };
 
 #endif
@@ -0,0 +1,248 @@
+/************************************************************************************//*!
+\file           PageProvider.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the MappedPageProvider class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "PageProvider.h"
+// Standard Libraries
+#include <new>
+#include <cstdint>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Creates the MappedPageProvider. No memory is reserved until it is needed.
+
+ @param  ReserveSize
+    The size of each range of virtual memory. Defaults to 64 MiB.
+ @param  HugePages
+    Asks the OS to back the ranges with transparent huge pages. Defaults to false.
+*//*********************************************************************************/
+MappedPageProvider::MappedPageProvider(size_t ReserveSize, bool HugePages)
+: ranges        ()
+, released      ()
+, reserveSize   (ReserveSize)
+, osPageSize    (0)
+, committed     (0)
+, hugePages     (HugePages)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    osPageSize = info.dwPageSize;
+#else
+    osPageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+
+    reserveSize = spanOf(reserveSize);
+}
+
+/********************************************************************************//*!
+ @brief  Destructor for MappedPageProvider. Unmaps every range.
+
+ @throws Never does.
+*//*********************************************************************************/
+MappedPageProvider::~MappedPageProvider()
+{
+    for (const Range& range : ranges)
+    {
+#ifdef _WIN32
+        VirtualFree(range.base, 0, MEM_RELEASE);
+#else
+        munmap(range.base, range.size);
+#endif
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets the memory for a page, reusing a released page of the same span if there
+        is one.
+
+ @param  size
+    The number of bytes needed.
+ @param  alignment
+    The alignment of the memory. Always a power of two.
+
+ @return The memory for the page.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+void* MappedPageProvider::AllocatePage(size_t size, size_t alignment)
+{
+    const size_t span = spanOf(size);
+    unsigned char* page = nullptr;
+
+    auto reuse = released.equal_range(span);
+    for (auto it = reuse.first; it != reuse.second; ++it)
+    {
+        if (reinterpret_cast<uintptr_t>(it->second) % alignment == 0)
+        {
+            page = it->second;
+            released.erase(it);
+            break;
+        }
+    }
+
+    if (page == nullptr)
+    {
+        Range* range = ranges.empty() ? nullptr : &ranges.back();
+        uintptr_t start = 0;
+        if (range)
+        {
+            start = reinterpret_cast<uintptr_t>(range->base + range->used);
+            start = (start + alignment - 1) & ~(alignment - 1);
+        }
+
+        // Whatever is left at the end of a full range is never used
+        if (range == nullptr || start + span > reinterpret_cast<uintptr_t>(range->base + range->size))
+        {
+            reserveRange(span + alignment);
+            range = &ranges.back();
+            start = reinterpret_cast<uintptr_t>(range->base);
+            start = (start + alignment - 1) & ~(alignment - 1);
+        }
+
+        page = reinterpret_cast<unsigned char*>(start);
+        range->used = page + span - range->base;
+
+#ifndef _WIN32
+        if (mprotect(page, span, PROT_READ | PROT_WRITE) != 0)
+            throw std::bad_alloc{};
+#endif
+    }
+
+#ifdef _WIN32
+    // Released pages were decommitted, so they are committed again either way
+    if (VirtualAlloc(page, span, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+    {
+        released.emplace(span, page);
+        throw std::bad_alloc{};
+    }
+#endif
+
+    committed += span;
+    return page;
+}
+
+/********************************************************************************//*!
+ @brief  Gives the physical memory of a page back to the OS. The addresses stay
+        reserved for the next page of the same span.
+
+ @param  page
+    The memory returned by AllocatePage.
+ @param  size
+    The size that was passed to AllocatePage.
+ @param  alignment
+    The alignment that was passed to AllocatePage.
+*//*********************************************************************************/
+void MappedPageProvider::ReleasePage(void* page, size_t size, size_t)
+{
+    const size_t span = spanOf(size);
+
+#ifdef _WIN32
+    VirtualFree(page, span, MEM_DECOMMIT);
+#else
+    // The page stays readable and writable, and is zero-filled on the next touch
+    madvise(page, span, MADV_DONTNEED);
+#endif
+
+    released.emplace(span, static_cast<unsigned char*>(page));
+    committed -= span;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Gets the number of bytes of virtual memory reserved.
+
+ @return The number of bytes reserved.
+*//*********************************************************************************/
+size_t MappedPageProvider::GetReservedBytes() const
+{
+    size_t total = 0;
+    for (const Range& range : ranges)
+    {
+        total += range.size;
+    }
+    return total;
+}
+/********************************************************************************//*!
+ @brief  Gets the number of bytes handed out as pages and not yet released.
+
+ @return The number of bytes committed.
+*//*********************************************************************************/
+size_t MappedPageProvider::GetCommittedBytes() const
+{
+    return committed;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Reserves another range of virtual memory.
+
+ @param  minimum
+    The number of bytes the range must at least hold.
+
+ @throws std::bad_alloc if the range can't be reserved.
+*//*********************************************************************************/
+void MappedPageProvider::reserveRange(size_t minimum)
+{
+    const size_t size = minimum > reserveSize ? spanOf(minimum) : reserveSize;
+
+    // Reserve the vector first so a failed push_back can't leak the range
+    ranges.reserve(ranges.size() + 1);
+
+#ifdef _WIN32
+    void* base = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+    if (base == nullptr)
+        throw std::bad_alloc{};
+#else
+    void* base = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+        throw std::bad_alloc{};
+
+#ifdef MADV_HUGEPAGE
+    if (hugePages)
+    {
+        // Only advice, the range works without huge pages
+        madvise(base, size, MADV_HUGEPAGE);
+    }
+#endif
+#endif
+
+    ranges.push_back(Range{ static_cast<unsigned char*>(base), size, 0 });
+}
+/********************************************************************************//*!
+ @brief  Gets the number of bytes a page spans, which is its size rounded up to the
+        OS page size.
+
+ @param  size
+    The size of the page.
+
+ @return The span of the page.
+*//*********************************************************************************/
+size_t MappedPageProvider::spanOf(size_t size) const
+{
+    return (size + osPageSize - 1) / osPageSize * osPageSize;
+}
@@ -0,0 +1,188 @@
+/************************************************************************************//*!
+ \file           PageProvider.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the PageProvider classes, which supply the
+                 memory for the pages of an ObjectAllocator.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef PAGEPROVIDERH
+#define PAGEPROVIDERH
+
+// Standard Libraries
+#include <cstddef>
+#include <map>
+#include <vector>
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+// If the client doesn't specify it:
+
+static const size_t DEFAULT_RESERVE_SIZE = static_cast<size_t>(64) << 20;   // 64 MiB
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  Supplies the memory for pages. An ObjectAllocator uses operator new when no
+         provider is set in its OAConfig.
+
+         A provider is not owned by the allocators using it and must outlive them. It
+         is not thread-safe, but may be shared by allocators on the same thread.
+*//*************************************************************************************/
+class PageProvider
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    virtual ~PageProvider() = default;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the memory for a page.
+
+    @param  size
+        The number of bytes needed.
+    @param  alignment
+        The alignment of the memory. Always a power of two.
+
+    @return The memory for the page.
+
+    @throws std::bad_alloc if there is no memory left.
+    *//*********************************************************************************/
+    virtual void* AllocatePage(size_t size, size_t alignment) = 0;
+
+    /********************************************************************************//*!
+    @brief  Gives back the memory of a page.
+
+    @param  page
+        The memory returned by AllocatePage.
+    @param  size
+        The size that was passed to AllocatePage.
+    @param  alignment
+        The alignment that was passed to AllocatePage.
+    *//*********************************************************************************/
+    virtual void ReleasePage(void* page, size_t size, size_t alignment) = 0;
+};
+
+/************************************************************************************//*!
+ @brief  Supplies pages from a large range of virtual memory that is reserved up front.
+
+         Pages are committed from the front of the range as they are needed, so the
+         pages of an allocator sit next to each other. Released pages are handed back
+         to the OS but keep their addresses, and are reused before the range grows.
+         Another range is reserved when one runs out.
+
+         On Linux the range can be backed by transparent huge pages, which cuts TLB
+         misses when walking many pages. Windows only supports large pages that are
+         committed all at once, so the flag is ignored there.
+*//*************************************************************************************/
+class MappedPageProvider : public PageProvider
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the MappedPageProvider. No memory is reserved until it is needed.
+
+    @param  ReserveSize
+        The size of each range of virtual memory. Defaults to 64 MiB.
+    @param  HugePages
+        Asks the OS to back the ranges with transparent huge pages. Defaults to false.
+    *//*********************************************************************************/
+    MappedPageProvider(size_t ReserveSize = DEFAULT_RESERVE_SIZE, bool HugePages = false);
+
+    // Prevent copy construction and assignment
+    MappedPageProvider(const MappedPageProvider &mp) = delete;              //!< Do not implement!
+    MappedPageProvider &operator=(const MappedPageProvider &mp) = delete;   //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for MappedPageProvider. Unmaps every range.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~MappedPageProvider() override;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    void* AllocatePage(size_t size, size_t alignment) override;
+    void ReleasePage(void* page, size_t size, size_t alignment) override;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the number of bytes of virtual memory reserved.
+
+    @return The number of bytes reserved.
+    *//*********************************************************************************/
+    size_t GetReservedBytes() const;
+    /********************************************************************************//*!
+    @brief  Gets the number of bytes handed out as pages and not yet released.
+
+    @return The number of bytes committed.
+    *//*********************************************************************************/
+    size_t GetCommittedBytes() const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  A range of reserved virtual memory.
+    *//*********************************************************************************/
+    struct Range
+    {
+        unsigned char*  base;   //!< The start of the range
+        size_t          size;   //!< The number of bytes reserved
+        size_t          used;   //!< The number of bytes from the front given out so far
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    std::vector<Range>                          ranges;         //!< every range reserved, the last one is grown
+    std::multimap<size_t, unsigned char*>       released;       //!< released pages by the size they span
+    size_t                                      reserveSize;    //!< the size of each range
+    size_t                                      osPageSize;     //!< the granularity of commits and releases
+    size_t                                      committed;      //!< the bytes given out and not released
+    bool                                        hugePages;      //!< whether to ask for transparent huge pages
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Reserves another range of virtual memory.
+
+    @param  minimum
+        The number of bytes the range must at least hold.
+
+    @throws std::bad_alloc if the range can't be reserved.
+    *//*********************************************************************************/
+    void reserveRange(size_t minimum);
+    /********************************************************************************//*!
+    @brief  Gets the number of bytes a page spans, which is its size rounded up to the
+            OS page size.
+
+    @param  size
+        The size of the page.
+
+    @return The span of the page.
+    *//*********************************************************************************/
+    size_t spanOf(size_t size) const;
+};
+
+#endif
@@ -0,0 +1,458 @@
+/************************************************************************************//*!
+\file           PersistentObjectAllocator.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the PersistentObjectAllocator class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "PersistentObjectAllocator.h"
+// Standard Libraries
+#include <algorithm>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+#define PERSISTENT_MAGIC    "CS280OA"   //!< marks a file that holds a pool
+#define PERSISTENT_VERSION  1u          //!< the layout of the file
+
+/************************************************************************************//*!
+ @brief  The start of the file. Every link is an offset from the start of the file, with
+         0 as the end of a list, since the header is always there.
+*//*************************************************************************************/
+struct PersistentObjectAllocator::FileHeader
+{
+    char        magic[8];       //!< PERSISTENT_MAGIC
+    uint32_t    version;        //!< PERSISTENT_VERSION
+    uint32_t    clean;          //!< 1 while the file is closed, 0 while it is open
+    uint64_t    objectSize;     //!< size of each object
+    uint64_t    blockSize;      //!< size of each object rounded up for links and alignment
+    uint64_t    objectsPerPage; //!< number of blocks in each page
+    uint64_t    pageSize;       //!< size of each page, including its link
+    uint64_t    dataStart;      //!< offset of the first page
+    uint64_t    usedSize;       //!< offset of the end of the last page
+    uint64_t    pageList;       //!< offset of the newest page
+    uint64_t    freeList;       //!< offset of the first free block
+    uint64_t    root;           //!< offset of the root object
+    uint64_t    freeObjects;    //!< number of objects on the free list
+    uint64_t    objectsInUse;   //!< number of objects in use by client
+    uint64_t    pagesInUse;     //!< number of pages in the file
+    uint64_t    mostObjects;    //!< most objects in use by client at one time
+    uint64_t    allocations;    //!< total requests to allocate memory
+    uint64_t    deallocations;  //!< total requests to free memory
+};
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Rounds a size up to a multiple.
+
+ @param  size
+    The size to round up.
+ @param  multiple
+    The multiple to round up to.
+
+ @return The rounded size.
+*//*********************************************************************************/
+static uint64_t roundUp(uint64_t size, uint64_t multiple)
+{
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Opens the pool in a file, creating the file if it doesn't exist or is empty.
+
+ @param  Path
+    The file to keep the pool in.
+ @param  ObjectSize
+    The size of each object. Must match the size the file was created with.
+ @param  config
+    The configuration of the pool. ObjectsPerPage_ and Alignment_ must match the ones
+    the file was created with.
+ @param  MaxFileSize
+    The most the file can grow to, reserved in address space up front. Windows sizes
+    the file to this when it is mapped. Defaults to 256 MiB.
+
+ @throws An exception from OAException if the file can't be opened or mapped, or holds
+        a pool of another layout or one that wasn't closed cleanly.
+*//*********************************************************************************/
+PersistentObjectAllocator::PersistentObjectAllocator(const char* Path, size_t ObjectSize, const OAConfig& config, size_t MaxFileSize)
+: base      (nullptr)
+, header    (nullptr)
+, mapSize   (0)
+, file      (-1)
+, mapping   (nullptr)
+, config    (config)
+, resumed   (false)
+{
+    // Blocks hold an offset while free, and pages keep every block aligned
+    const uint64_t blockAlign     = std::max<uint64_t>(sizeof(uint64_t), config.Alignment_);
+    const uint64_t pageAlign      = std::max<uint64_t>(alignof(std::max_align_t), config.Alignment_);
+    const uint64_t blockSize      = roundUp(std::max<uint64_t>(ObjectSize, sizeof(uint64_t)), blockAlign);
+    const uint64_t objectsPerPage = std::max(config.ObjectsPerPage_, 1u);
+    const uint64_t pageSize       = roundUp(roundUp(sizeof(uint64_t), pageAlign) + objectsPerPage * blockSize, pageAlign);
+    const uint64_t dataStart      = roundUp(sizeof(FileHeader), pageAlign);
+
+    const uint64_t fileSize = mapFile(Path, MaxFileSize);
+    header = reinterpret_cast<FileHeader*>(base);
+
+    if (fileSize == 0)
+    {
+        std::memcpy(header->magic, PERSISTENT_MAGIC, sizeof(header->magic));
+        header->version         = PERSISTENT_VERSION;
+        header->objectSize      = ObjectSize;
+        header->blockSize       = blockSize;
+        header->objectsPerPage  = objectsPerPage;
+        header->pageSize        = pageSize;
+        header->dataStart       = dataStart;
+        header->usedSize        = dataStart;
+    }
+    else
+    {
+        const char* error = nullptr;
+
+        if (fileSize < sizeof(FileHeader) || std::memcmp(header->magic, PERSISTENT_MAGIC, sizeof(header->magic)) != 0
+            || header->version != PERSISTENT_VERSION)
+            error = "File does not hold a pool.";
+        else if (header->objectSize != ObjectSize || header->blockSize != blockSize
+                 || header->objectsPerPage != objectsPerPage || header->pageSize != pageSize)
+            error = "File holds a pool of another layout.";
+        else if (!header->clean)
+            error = "File was not closed cleanly.";
+        else if (header->usedSize > mapSize)
+            error = "File is larger than it can be mapped.";
+
+        if (error)
+        {
+            unmapFile();
+            throw OAException{OAException::E_CORRUPTED_BLOCK, error};
+        }
+
+        resumed = true;
+    }
+
+    // Anything that stops the process from here on leaves the file marked as open
+    header->clean = 0;
+}
+
+/********************************************************************************//*!
+ @brief  Destructor for PersistentObjectAllocator. Marks the file as closed cleanly,
+        writes it out and unmaps it. Objects still in use stay in the file.
+
+ @throws Never does.
+*//*********************************************************************************/
+PersistentObjectAllocator::~PersistentObjectAllocator()
+{
+    header->clean = 1;
+    Flush();
+    unmapFile();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Takes an object from the free list, growing the file by a page if it is empty.
+
+ @return Pointer to the allocated object.
+
+ @throws An exception from OAException if the maximum number of pages or the maximum
+        file size has been reached.
+*//*********************************************************************************/
+void* PersistentObjectAllocator::Allocate()
+{
+    if (!header->freeList)
+        createPage();
+
+    unsigned char* object = base + header->freeList;
+    std::memcpy(&header->freeList, object, sizeof(uint64_t));
+
+    --header->freeObjects;
+    ++header->allocations;
+    ++header->objectsInUse;
+    header->mostObjects = std::max(header->mostObjects, header->objectsInUse);
+
+    return object;
+}
+
+/********************************************************************************//*!
+ @brief  Returns an object to the free list.
+
+ @param  Object
+    The object to return.
+
+ @throws An exception from OAException if the object is not on a block boundary while
+        debugging.
+*//*********************************************************************************/
+void PersistentObjectAllocator::Free(void *Object)
+{
+    const uint64_t offset = ToOffset(Object);
+
+    if (config.DebugOn_)
+    {
+        const uint64_t firstBlock = header->pageSize - header->objectsPerPage * header->blockSize;
+        if (offset < header->dataStart || offset >= header->usedSize)
+            throw OAException{OAException::E_BAD_BOUNDARY, "Object address is not within a page."};
+
+        // The blocks are packed at the end of each page, after its link and padding
+        const uint64_t inPage = (offset - header->dataStart) % header->pageSize;
+        if (inPage < firstBlock || (inPage - firstBlock) % header->blockSize != 0)
+            throw OAException{OAException::E_BAD_BOUNDARY, "Object that is trying to be freed is misaligned."};
+    }
+
+    std::memcpy(Object, &header->freeList, sizeof(uint64_t));
+    header->freeList = offset;
+
+    ++header->freeObjects;
+    ++header->deallocations;
+    --header->objectsInUse;
+}
+
+/********************************************************************************//*!
+ @brief  Writes the file out to disk and waits for it.
+*//*********************************************************************************/
+void PersistentObjectAllocator::Flush()
+{
+#ifdef _WIN32
+    FlushViewOfFile(base, static_cast<SIZE_T>(header->usedSize));
+    FlushFileBuffers(reinterpret_cast<HANDLE>(file));
+#else
+    msync(base, static_cast<size_t>(header->usedSize), MS_SYNC);
+#endif
+}
+
+/********************************************************************************//*!
+ @brief  Converts an object to its offset in the file, which stays the same when the
+        file is reopened.
+
+ @param  Object
+    The object, or a nullptr.
+
+ @return The offset of the object, or 0 for a nullptr.
+*//*********************************************************************************/
+uint64_t PersistentObjectAllocator::ToOffset(const void* Object) const
+{
+    return Object ? static_cast<uint64_t>(static_cast<const unsigned char*>(Object) - base) : 0;
+}
+
+/********************************************************************************//*!
+ @brief  Converts an offset from ToOffset back to the object.
+
+ @param  Offset
+    The offset, or 0.
+
+ @return The object, or a nullptr for 0.
+*//*********************************************************************************/
+void* PersistentObjectAllocator::FromOffset(uint64_t Offset) const
+{
+    return Offset ? base + Offset : nullptr;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Setter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Sets the object to find the others from when the file is reopened.
+
+ @param  Object
+    The root object, or a nullptr for none.
+*//*********************************************************************************/
+void PersistentObjectAllocator::SetRoot(void* Object)
+{
+    header->root = ToOffset(Object);
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the root object.
+
+ @return The root object, or a nullptr if none was set.
+*//*********************************************************************************/
+void* PersistentObjectAllocator::GetRoot() const
+{
+    return FromOffset(header->root);
+}
+
+/********************************************************************************//*!
+ @brief  Checks if the pool was resumed from an existing file.
+
+ @return True if the file held a pool when it was opened.
+*//*********************************************************************************/
+bool PersistentObjectAllocator::WasResumed() const
+{
+    return resumed;
+}
+
+/********************************************************************************//*!
+ @brief  Gets the statistics of the pool, kept in the file across runs.
+
+ @return The statistics of the pool.
+*//*********************************************************************************/
+OAStats PersistentObjectAllocator::GetStats() const
+{
+    OAStats stats;
+    stats.ObjectSize_       = static_cast<size_t>(header->objectSize);
+    stats.PageSize_         = static_cast<size_t>(header->pageSize);
+    stats.FreeObjects_      = static_cast<unsigned>(header->freeObjects);
+    stats.ObjectsInUse_     = static_cast<unsigned>(header->objectsInUse);
+    stats.PagesInUse_       = static_cast<unsigned>(header->pagesInUse);
+    stats.MostObjects_      = static_cast<unsigned>(header->mostObjects);
+    stats.Allocations_      = static_cast<unsigned>(header->allocations);
+    stats.Deallocations_    = static_cast<unsigned>(header->deallocations);
+    return stats;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Opens and maps the file. The mapping covers the larger of the maximum size and
+        the file, so resuming a file never needs more than one mapping.
+
+ @param  Path
+    The file to map.
+ @param  MaxFileSize
+    The most the file can grow to.
+
+ @return The size of the file before it was mapped.
+
+ @throws OAException if the file can't be opened or mapped.
+*//*********************************************************************************/
+uint64_t PersistentObjectAllocator::mapFile(const char* Path, size_t MaxFileSize)
+{
+#ifdef _WIN32
+    HANDLE handle = CreateFileA(Path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        throw OAException{OAException::E_NO_MEMORY, "Unable to open the file."};
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(handle, &size);
+    const uint64_t fileSize = static_cast<uint64_t>(size.QuadPart);
+    mapSize = static_cast<size_t>(std::max<uint64_t>(fileSize, MaxFileSize));
+
+    // The mapping sizes the file to mapSize, with zeros past the old end
+    HANDLE view = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, static_cast<DWORD>(static_cast<uint64_t>(mapSize) >> 32),
+                                     static_cast<DWORD>(mapSize), nullptr);
+    if (view)
+        base = static_cast<unsigned char*>(MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, mapSize));
+
+    if (!base)
+    {
+        if (view)
+            CloseHandle(view);
+        CloseHandle(handle);
+        throw OAException{OAException::E_NO_MEMORY, "Unable to map the file."};
+    }
+
+    file    = reinterpret_cast<std::intptr_t>(handle);
+    mapping = view;
+#else
+    const int fd = open(Path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        throw OAException{OAException::E_NO_MEMORY, "Unable to open the file."};
+
+    struct stat status;
+    fstat(fd, &status);
+    const uint64_t fileSize = static_cast<uint64_t>(status.st_size);
+    mapSize = static_cast<size_t>(std::max<uint64_t>(fileSize, MaxFileSize));
+
+    // A new file holds just its header until the first page is needed
+    void* memory = MAP_FAILED;
+    if (fileSize != 0 || ftruncate(fd, static_cast<off_t>(roundUp(sizeof(FileHeader), alignof(std::max_align_t)))) == 0)
+        memory = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (memory == MAP_FAILED)
+    {
+        close(fd);
+        throw OAException{OAException::E_NO_MEMORY, "Unable to map the file."};
+    }
+
+    base = static_cast<unsigned char*>(memory);
+    file = fd;
+#endif
+
+    return fileSize;
+}
+
+/********************************************************************************//*!
+ @brief  Unmaps and closes the file.
+*//*********************************************************************************/
+void PersistentObjectAllocator::unmapFile()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    CloseHandle(reinterpret_cast<HANDLE>(file));
+#else
+    munmap(base, mapSize);
+    close(static_cast<int>(file));
+#endif
+
+    base    = nullptr;
+    header  = nullptr;
+}
+
+/********************************************************************************//*!
+ @brief  Grows the file by a page and puts its blocks on the free list, in address
+        order.
+
+ @throws OAException if the maximum number of pages or the maximum file size has been
+        reached, or the file can't grow.
+*//*********************************************************************************/
+void PersistentObjectAllocator::createPage()
+{
+    if (config.MaxPages_ && header->pagesInUse >= config.MaxPages_)
+        throw OAException{OAException::E_NO_PAGES, "Maximum number of pages have been reached."};
+
+    const uint64_t page = header->usedSize;
+    if (page + header->pageSize > mapSize)
+        throw OAException{OAException::E_NO_MEMORY, "Maximum file size has been reached."};
+
+#ifndef _WIN32
+    // Touching mapped memory past the end of the file raises SIGBUS
+    if (ftruncate(static_cast<int>(file), static_cast<off_t>(page + header->pageSize)) != 0)
+        throw OAException{OAException::E_NO_MEMORY, "Unable to grow the file."};
+#endif
+
+    std::memcpy(base + page, &header->pageList, sizeof(uint64_t));
+    header->pageList = page;
+
+    // Link the blocks back to front so the free list hands them out front to back
+    const uint64_t firstBlock = page + header->pageSize - header->objectsPerPage * header->blockSize;
+    for (uint64_t i = header->objectsPerPage; i-- > 0;)
+    {
+        const uint64_t block = firstBlock + i * header->blockSize;
+        std::memcpy(base + block, &header->freeList, sizeof(uint64_t));
+        header->freeList = block;
+    }
+
+    header->usedSize    += header->pageSize;
+    header->freeObjects += header->objectsPerPage;
+    ++header->pagesInUse;
+}
@@ -0,0 +1,227 @@
+/************************************************************************************//*!
+ \file           PersistentObjectAllocator.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the PersistentObjectAllocator class, a pool
+                 whose pages live in a memory-mapped file so its objects survive the
+                 process.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef PERSISTENTOBJECTALLOCATORH
+#define PERSISTENTOBJECTALLOCATORH
+
+// Standard Libraries
+#include <cstddef>
+#include <cstdint>
+// Project Headers
+#include "ObjectAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+// If the client doesn't specify it:
+
+static const size_t DEFAULT_PERSISTENT_SIZE = static_cast<size_t>(256) << 20;   // 256 MiB
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  A pool of fixed-size objects kept in a memory-mapped file. Reopening the file
+         resumes the pool with every object as it was, without rebuilding anything.
+
+         The page list and the free list are stored as offsets from the start of the
+         file, so they stay valid wherever the file is mapped. The whole file is mapped
+         at its maximum size up front, so objects never move while it is open, but
+         their addresses change between runs. Objects that refer to each other should
+         store offsets from ToOffset, and a root object can be kept in the file to
+         find the rest again.
+
+         The file is marked as in use while it is open. A file that wasn't closed
+         cleanly, such as after a crash, can't be trusted and is refused.
+
+         Only ObjectsPerPage_, MaxPages_, Alignment_ and DebugOn_ of the OAConfig are
+         used. Headers, padding and patterns aren't kept in the file. While
+         debugging, Free checks that an object is on a block boundary. Not
+         thread-safe.
+*//*************************************************************************************/
+class PersistentObjectAllocator
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Opens the pool in a file, creating the file if it doesn't exist or is
+            empty.
+
+    @param  Path
+        The file to keep the pool in.
+    @param  ObjectSize
+        The size of each object. Must match the size the file was created with.
+    @param  config
+        The configuration of the pool. ObjectsPerPage_ and Alignment_ must match the
+        ones the file was created with.
+    @param  MaxFileSize
+        The most the file can grow to, reserved in address space up front. Windows
+        sizes the file to this when it is mapped. Defaults to 256 MiB.
+
+    @throws An exception from OAException if the file can't be opened or mapped, or
+            holds a pool of another layout or one that wasn't closed cleanly.
+    *//*********************************************************************************/
+    PersistentObjectAllocator(const char* Path, size_t ObjectSize, const OAConfig& config = OAConfig{},
+                              size_t MaxFileSize = DEFAULT_PERSISTENT_SIZE);
+
+    // Prevent copy construction and assignment
+    PersistentObjectAllocator(const PersistentObjectAllocator &poa) = delete;            //!< Do not implement!
+    PersistentObjectAllocator &operator=(const PersistentObjectAllocator &poa) = delete; //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for PersistentObjectAllocator. Marks the file as closed
+            cleanly, writes it out and unmaps it. Objects still in use stay in the
+            file.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~PersistentObjectAllocator();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Takes an object from the free list, growing the file by a page if it is
+            empty.
+
+    @return Pointer to the allocated object.
+
+    @throws An exception from OAException if the maximum number of pages or the
+            maximum file size has been reached.
+    *//*********************************************************************************/
+    void* Allocate();
+
+    /********************************************************************************//*!
+    @brief  Returns an object to the free list.
+
+    @param  Object
+        The object to return.
+
+    @throws An exception from OAException if the object is not on a block boundary
+            while debugging.
+    *//*********************************************************************************/
+    void Free(void *Object);
+
+    /********************************************************************************//*!
+    @brief  Writes the file out to disk and waits for it.
+    *//*********************************************************************************/
+    void Flush();
+
+    /********************************************************************************//*!
+    @brief  Converts an object to its offset in the file, which stays the same when the
+            file is reopened.
+
+    @param  Object
+        The object, or a nullptr.
+
+    @return The offset of the object, or 0 for a nullptr.
+    *//*********************************************************************************/
+    uint64_t ToOffset(const void* Object) const;
+
+    /********************************************************************************//*!
+    @brief  Converts an offset from ToOffset back to the object.
+
+    @param  Offset
+        The offset, or 0.
+
+    @return The object, or a nullptr for 0.
+    *//*********************************************************************************/
+    void* FromOffset(uint64_t Offset) const;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Setter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Sets the object to find the others from when the file is reopened.
+
+    @param  Object
+        The root object, or a nullptr for none.
+    *//*********************************************************************************/
+    void SetRoot(void* Object);
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the root object.
+
+    @return The root object, or a nullptr if none was set.
+    *//*********************************************************************************/
+    void* GetRoot() const;
+
+    /********************************************************************************//*!
+    @brief  Checks if the pool was resumed from an existing file.
+
+    @return True if the file held a pool when it was opened.
+    *//*********************************************************************************/
+    bool WasResumed() const;
+
+    /********************************************************************************//*!
+    @brief  Gets the statistics of the pool, kept in the file across runs.
+
+    @return The statistics of the pool.
+    *//*********************************************************************************/
+    OAStats GetStats() const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    struct FileHeader;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    unsigned char   *base;      //!< where the file is mapped
+    FileHeader      *header;    //!< the layout, lists and stats at the start of the file
+    size_t          mapSize;    //!< the bytes of address space mapped
+    std::intptr_t   file;       //!< the open file, a HANDLE on Windows and a descriptor elsewhere
+    void            *mapping;   //!< the file mapping object (Windows only)
+    OAConfig        config;     //!< the properties of the pool
+    bool            resumed;    //!< whether the file held a pool when opened
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Opens and maps the file.
+
+    @param  Path
+        The file to map.
+    @param  MaxFileSize
+        The most the file can grow to.
+
+    @return The size of the file before it was mapped.
+
+    @throws OAException if the file can't be opened or mapped.
+    *//*********************************************************************************/
+    uint64_t mapFile(const char* Path, size_t MaxFileSize);
+    /********************************************************************************//*!
+    @brief  Unmaps and closes the file.
+    *//*********************************************************************************/
+    void unmapFile();
+    /********************************************************************************//*!
+    @brief  Grows the file by a page and puts its blocks on the free list.
+
+    @throws OAException if the maximum number of pages or the maximum file size has
+            been reached, or the file can't grow.
+    *//*********************************************************************************/
+    void createPage();
+};
+
+#endif
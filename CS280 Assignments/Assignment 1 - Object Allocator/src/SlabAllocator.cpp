@@ -0,0 +1,431 @@
+/************************************************************************************//*!
+\file           SlabAllocator.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the SlabAllocator class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "SlabAllocator.h"
+// Standard Libraries
+#include <new>
+#include <cstddef>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define PTR_SIZE sizeof(unsigned char*)
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Creates the SlabAllocator per the specified values
+
+ @param  config
+    The configuration of every pool. ObjectsPerPage_, MaxObjectsPerPage_,
+    AlignPages_ and GuardedSlots_ are ignored, Alignment_ is raised to the natural
+    alignment of each class, and pages are taken from PageProvider_ if one is set.
+ @param  MaxSize
+    The biggest request served from a pool. Defaults to 1024.
+ @param  ChunkSize
+    The size and alignment of the memory for each page, rounded up to a power of
+    two. Defaults to 64 KiB.
+
+ @throws An exception if the construction fails.
+*//*********************************************************************************/
+SlabAllocator::SlabAllocator(const OAConfig& c, size_t maxSize, size_t size)
+: config        (c)
+, chunkSize     (alignof(std::max_align_t))
+, classes       ()
+, classIndex    ()
+, chunkOwners   ()
+, largeObjects  ()
+, largeCount    (0)
+, objectsInUse  (0)
+, mostObjects   (0)
+{
+    while (chunkSize < size)
+    {
+        chunkSize <<= 1;
+    }
+
+    // Each step adds half of the largest power of two below the size, so every class
+    // after 16 is 1.5x or 1.33x the one before it
+    std::vector<size_t> sizes { PTR_SIZE };
+    while (sizes.back() < maxSize)
+    {
+        size_t step = 1;
+        while (step * 2 <= sizes.back())
+        {
+            step <<= 1;
+        }
+        step = step / 2 > PTR_SIZE ? step / 2 : PTR_SIZE;
+        sizes.push_back(sizes.back() + step);
+    }
+
+    // Pools point at their class' provider, so the classes can never move
+    classes.reserve(sizes.size());
+    for (size_t classSize : sizes)
+    {
+        // Natural alignment: the largest power of two that divides the size
+        size_t alignment = classSize & (~classSize + 1);
+        if (alignment > alignof(std::max_align_t))
+            alignment = alignof(std::max_align_t);
+
+        const unsigned index = static_cast<unsigned>(classes.size());
+        classes.push_back(SizeClass{ classSize, static_cast<unsigned>(alignment), ChunkProvider{ *this, index }, nullptr });
+    }
+
+    classIndex.resize(sizes.back() / PTR_SIZE + 1);
+    unsigned index = 0;
+    for (size_t i = 0; i < classIndex.size(); ++i)
+    {
+        while (classes[index].size < i * PTR_SIZE)
+        {
+            ++index;
+        }
+        classIndex[i] = static_cast<unsigned char>(index);
+    }
+}
+
+/********************************************************************************//*!
+ @brief  Destructor for SlabAllocator. Frees every pool and large allocation.
+
+ @throws Never does.
+*//*********************************************************************************/
+SlabAllocator::~SlabAllocator()
+{
+    for (void* obj : largeObjects)
+    {
+        ::operator delete(obj);
+    }
+
+    // Pools release their chunks through the providers, which still need chunkOwners
+    for (SizeClass& sizeClass : classes)
+    {
+        sizeClass.pool.reset();
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Allocates memory from the pool of the smallest class that fits.
+
+ @param  bytes
+    The number of bytes needed.
+ @param  label
+    Passed on to the pool for external headers.
+
+ @return Pointer to the allocated memory.
+
+ @throws An exception from OAException if the memory can't be allocated.
+*//*********************************************************************************/
+void* SlabAllocator::Allocate(size_t bytes, const char* label)
+{
+    void* obj = nullptr;
+
+    if (bytes <= classes.back().size && !config.UseCPPMemManager_)
+    {
+        const unsigned index = classIndex[(bytes + PTR_SIZE - 1) / PTR_SIZE];
+        obj = poolOf(index).Allocate(label);
+    }
+    else
+    {
+        try
+        {
+            obj = ::operator new(bytes);
+            largeObjects.insert(obj);
+        }
+        catch(const std::bad_alloc&)
+        {
+            ::operator delete(obj);
+            throw OAException{OAException::E_NO_MEMORY, "No physical memory left."};
+        }
+        ++largeCount;
+    }
+
+    if (++objectsInUse > mostObjects)
+        mostObjects = objectsInUse;
+
+    return obj;
+}
+
+/********************************************************************************//*!
+ @brief  Returns memory to the pool it came from.
+
+ @param  Object
+    The memory to free. Does nothing if it is a nullptr.
+
+ @throws An exception from OAException if the memory was not allocated by this
+        allocator, or if the pool finds an invalid free while debugging.
+*//*********************************************************************************/
+void SlabAllocator::Free(void* Object)
+{
+    if (Object == nullptr)
+        return;
+
+    const uintptr_t chunk = reinterpret_cast<uintptr_t>(Object) & ~(chunkSize - 1);
+    auto owner = chunkOwners.find(chunk);
+    if (owner != chunkOwners.end())
+    {
+        classes[owner->second].pool->Free(Object);
+    }
+    else if (largeObjects.erase(Object))
+    {
+        ::operator delete(Object);
+    }
+    else
+    {
+        throw OAException{OAException::E_BAD_BOUNDARY, "Object was not allocated by this allocator."};
+    }
+
+    --objectsInUse;
+}
+
+/********************************************************************************//*!
+ @brief  Frees the empty pages of every pool.
+
+ @return The number of pages that were freed.
+*//*********************************************************************************/
+unsigned SlabAllocator::FreeEmptyPages()
+{
+    unsigned freed = 0;
+    for (SizeClass& sizeClass : classes)
+    {
+        if (sizeClass.pool)
+            freed += sizeClass.pool->FreeEmptyPages();
+    }
+    return freed;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the statistics of all the pools together. ObjectSize_ is the biggest
+        class and PageSize_ is the chunk size. Large allocations count as objects
+        in use but not as pages.
+
+ @return The statistics for the allocator.
+*//*********************************************************************************/
+OAStats SlabAllocator::GetStats() const
+{
+    OAStats total;
+    total.ObjectSize_   = classes.back().size;
+    total.PageSize_     = chunkSize;
+
+    for (const SizeClass& sizeClass : classes)
+    {
+        if (!sizeClass.pool)
+            continue;
+
+        const OAStats stats = sizeClass.pool->GetStats();
+        total.FreeObjects_      += stats.FreeObjects_;
+        total.PagesInUse_       += stats.PagesInUse_;
+        total.Allocations_      += stats.Allocations_;
+        total.Deallocations_    += stats.Deallocations_;
+    }
+
+    total.ObjectsInUse_     = objectsInUse;
+    total.MostObjects_      = mostObjects;
+    total.Allocations_      += largeCount;
+    total.Deallocations_    += largeCount - static_cast<unsigned>(largeObjects.size());
+
+    return total;
+}
+
+/********************************************************************************//*!
+ @brief  Gets the size of the class that serves a request.
+
+ @param  bytes
+    The number of bytes requested.
+
+ @return The size of the class, or 0 if the request is too large for any class.
+*//*********************************************************************************/
+size_t SlabAllocator::GetClassSize(size_t bytes) const
+{
+    if (bytes > classes.back().size)
+        return 0;
+
+    return classes[classIndex[(bytes + PTR_SIZE - 1) / PTR_SIZE]].size;
+}
+
+/********************************************************************************//*!
+ @brief  Gets the pool of the class that serves a request.
+
+ @param  bytes
+    The number of bytes requested.
+
+ @return The pool, or nullptr if it hasn't been used yet or the request is too
+        large for any class.
+*//*********************************************************************************/
+const ObjectAllocator* SlabAllocator::GetPool(size_t bytes) const
+{
+    if (bytes > classes.back().size)
+        return nullptr;
+
+    return classes[classIndex[(bytes + PTR_SIZE - 1) / PTR_SIZE]].pool.get();
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the pool of a class, creating it if it doesn't exist yet.
+
+ @param  index
+    The index of the class.
+
+ @return The pool.
+
+ @throws An exception from OAException if the pool can't be created.
+*//*********************************************************************************/
+ObjectAllocator& SlabAllocator::poolOf(unsigned index)
+{
+    SizeClass& sizeClass = classes[index];
+    if (sizeClass.pool)
+        return *sizeClass.pool;
+
+    OAConfig c = config;
+    c.AlignPages_ = false;
+    c.MaxObjectsPerPage_ = 0;
+    c.GuardedSlots_ = 0;
+    c.PageProvider_ = &sizeClass.provider;
+    if (c.Alignment_ < sizeClass.alignment)
+        c.Alignment_ = sizeClass.alignment;
+
+    // Fill a chunk as far as possible: each block needs its bytes plus a bit in each of
+    // the two bitmaps, and the page needs a link, left alignment and its PageInfo
+    const size_t alignment = c.Alignment_ ? c.Alignment_ : 1;
+    size_t block = sizeClass.size + 2 * c.PadBytes_ + c.HBlockInfo_.size_;
+    block = (block + alignment - 1) / alignment * alignment;
+
+    const size_t overhead = PTR_SIZE + alignment + sizeof(PageInfo) + 2 * alignof(std::max_align_t);
+    size_t objects = chunkSize > overhead ? (chunkSize - overhead) * 8 / (block * 8 + 2) : 0;
+    c.ObjectsPerPage_ = objects ? static_cast<unsigned>(objects) : 1;
+
+    try
+    {
+        sizeClass.pool.reset(new ObjectAllocator{ sizeClass.size, c });
+    }
+    catch(const std::bad_alloc&)
+    {
+        throw OAException{OAException::E_NO_MEMORY, "No physical memory left."};
+    }
+
+    return *sizeClass.pool;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* ChunkProvider                                                                       */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Creates the provider for one class.
+
+ @param  slab
+    The allocator the class belongs to.
+ @param  index
+    The index of the class.
+*//*********************************************************************************/
+SlabAllocator::ChunkProvider::ChunkProvider(SlabAllocator& s, unsigned i)
+: slab  (s)
+, index (i)
+{}
+
+/********************************************************************************//*!
+ @brief  Gets chunk-aligned memory for a page and records the class as its owner.
+        Pages bigger than a chunk take several chunks, and each one is recorded.
+
+ @param  size
+    The number of bytes needed.
+
+ @return The memory for the page.
+
+ @throws std::bad_alloc if there is no memory left.
+*//*********************************************************************************/
+void* SlabAllocator::ChunkProvider::AllocatePage(size_t size, size_t)
+{
+    const size_t chunkSize = slab.chunkSize;
+    const size_t span = (size + chunkSize - 1) & ~(chunkSize - 1);
+
+    void* raw = nullptr;
+    if (slab.config.PageProvider_)
+    {
+        raw = slab.config.PageProvider_->AllocatePage(span, chunkSize);
+    }
+    else
+    {
+#ifdef _WIN32
+        raw = _aligned_malloc(span, chunkSize);
+#else
+        if (posix_memalign(&raw, chunkSize, span) != 0)
+        {
+            raw = nullptr;
+        }
+#endif
+        if (raw == nullptr)
+            throw std::bad_alloc{};
+    }
+
+    try
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(raw);
+        for (uintptr_t chunk = base; chunk < base + span; chunk += chunkSize)
+        {
+            slab.chunkOwners[chunk] = index;
+        }
+    }
+    catch(const std::bad_alloc&)
+    {
+        ReleasePage(raw, size, chunkSize);
+        throw;
+    }
+
+    return raw;
+}
+
+/********************************************************************************//*!
+ @brief  Forgets the owner of a page's chunks and gives back its memory.
+
+ @param  page
+    The memory returned by AllocatePage.
+ @param  size
+    The size that was passed to AllocatePage.
+*//*********************************************************************************/
+void SlabAllocator::ChunkProvider::ReleasePage(void* page, size_t size, size_t)
+{
+    const size_t chunkSize = slab.chunkSize;
+    const size_t span = (size + chunkSize - 1) & ~(chunkSize - 1);
+
+    const uintptr_t base = reinterpret_cast<uintptr_t>(page);
+    for (uintptr_t chunk = base; chunk < base + span; chunk += chunkSize)
+    {
+        slab.chunkOwners.erase(chunk);
+    }
+
+    if (slab.config.PageProvider_)
+    {
+        slab.config.PageProvider_->ReleasePage(page, span, chunkSize);
+        return;
+    }
+
+#ifdef _WIN32
+    _aligned_free(page);
+#else
+    free(page);
+#endif
+}
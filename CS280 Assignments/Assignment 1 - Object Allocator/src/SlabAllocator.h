@@ -0,0 +1,213 @@
+/************************************************************************************//*!
+ \file           SlabAllocator.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the SlabAllocator class, a general purpose
+                 front end over ObjectAllocators of different sizes.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef SLABALLOCATORH
+#define SLABALLOCATORH
+
+// Standard Libraries
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+// Project Headers
+#include "ObjectAllocator.h"
+#include "PageProvider.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Global Variables                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+// If the client doesn't specify these:
+
+static const size_t DEFAULT_MAX_SLAB_SIZE   = 1024;
+static const size_t DEFAULT_CHUNK_SIZE      = static_cast<size_t>(64) << 10;    // 64 KiB
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  Serves allocations of any size from a set of ObjectAllocators, one for each
+         size class. Classes are spaced geometrically (8, 16, 24, 32, 48, 64, 96, ...)
+         so rounding a request up wastes little, and every object is aligned like
+         malloc would align it.
+
+         The pages of every pool are carved from chunks aligned to their own size, so
+         the pool that owns a pointer is found by masking the pointer and a single
+         hash lookup. Requests larger than the biggest class go to operator new.
+
+         Pools are created on first use. Like ObjectAllocator, it is not thread-safe.
+*//*************************************************************************************/
+class SlabAllocator
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the SlabAllocator per the specified values
+
+    @param  config
+        The configuration of every pool. ObjectsPerPage_, MaxObjectsPerPage_,
+        AlignPages_ and GuardedSlots_ are ignored, Alignment_ is raised to the natural
+        alignment of each class, and pages are taken from PageProvider_ if one is set.
+    @param  MaxSize
+        The biggest request served from a pool. Defaults to 1024.
+    @param  ChunkSize
+        The size and alignment of the memory for each page, rounded up to a power of
+        two. Defaults to 64 KiB.
+
+    @throws An exception if the construction fails.
+    *//*********************************************************************************/
+    SlabAllocator(const OAConfig& config = OAConfig{ false, DEFAULT_OBJECTS_PER_PAGE, 0 }, size_t MaxSize = DEFAULT_MAX_SLAB_SIZE,
+                  size_t ChunkSize = DEFAULT_CHUNK_SIZE);
+
+    // Prevent copy construction and assignment
+    SlabAllocator(const SlabAllocator &sa) = delete;             //!< Do not implement!
+    SlabAllocator &operator=(const SlabAllocator &sa) = delete;  //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for SlabAllocator. Frees every pool and large allocation.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~SlabAllocator();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Allocates memory from the pool of the smallest class that fits.
+
+    @param  bytes
+        The number of bytes needed.
+    @param  label
+        Passed on to the pool for external headers.
+
+    @return Pointer to the allocated memory.
+
+    @throws An exception from OAException if the memory can't be allocated.
+    *//*********************************************************************************/
+    void* Allocate(size_t bytes, const char* label = 0);
+
+    /********************************************************************************//*!
+    @brief  Returns memory to the pool it came from.
+
+    @param  Object
+        The memory to free. Does nothing if it is a nullptr.
+
+    @throws An exception from OAException if the memory was not allocated by this
+            allocator, or if the pool finds an invalid free while debugging.
+    *//*********************************************************************************/
+    void Free(void *Object);
+
+    /********************************************************************************//*!
+    @brief  Frees the empty pages of every pool.
+
+    @return The number of pages that were freed.
+    *//*********************************************************************************/
+    unsigned FreeEmptyPages();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the statistics of all the pools together. ObjectSize_ is the biggest
+            class and PageSize_ is the chunk size. Large allocations count as objects
+            in use but not as pages.
+
+    @return The statistics for the allocator.
+    *//*********************************************************************************/
+    OAStats GetStats() const;
+    /********************************************************************************//*!
+    @brief  Gets the size of the class that serves a request.
+
+    @param  bytes
+        The number of bytes requested.
+
+    @return The size of the class, or 0 if the request is too large for any class.
+    *//*********************************************************************************/
+    size_t GetClassSize(size_t bytes) const;
+    /********************************************************************************//*!
+    @brief  Gets the pool of the class that serves a request.
+
+    @param  bytes
+        The number of bytes requested.
+
+    @return The pool, or nullptr if it hasn't been used yet or the request is too
+            large for any class.
+    *//*********************************************************************************/
+    const ObjectAllocator* GetPool(size_t bytes) const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Hands out chunk-aligned memory to the pool of one class and remembers which
+            class owns each chunk.
+    *//*********************************************************************************/
+    class ChunkProvider : public PageProvider
+    {
+    public:
+        ChunkProvider(SlabAllocator& slab, unsigned index);
+
+        void* AllocatePage(size_t size, size_t alignment) override;
+        void ReleasePage(void* page, size_t size, size_t alignment) override;
+
+    private:
+        SlabAllocator&  slab;   //!< the allocator the class belongs to
+        unsigned        index;  //!< the index of the class
+    };
+
+    /********************************************************************************//*!
+    @brief  A size class and its pool.
+    *//*********************************************************************************/
+    struct SizeClass
+    {
+        size_t                              size;       //!< the size of every object
+        unsigned                            alignment;  //!< the alignment of every object
+        ChunkProvider                       provider;   //!< where the pool gets its pages
+        std::unique_ptr<ObjectAllocator>    pool;       //!< the pool, created on first use
+    };
+
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    OAConfig                                config;         //!< the configuration of every pool
+    size_t                                  chunkSize;      //!< size and alignment of the memory for a page
+    std::vector<SizeClass>                  classes;        //!< every size class, smallest first
+    std::vector<unsigned char>              classIndex;     //!< the class for every multiple of 8 bytes
+    std::unordered_map<uintptr_t, unsigned> chunkOwners;    //!< the class of every chunk in use
+    std::unordered_set<void*>               largeObjects;   //!< requests too large for any class
+    unsigned                                largeCount;     //!< total requests too large for any class
+    unsigned                                objectsInUse;   //!< objects in use across every pool
+    unsigned                                mostObjects;    //!< most objects in use at one time
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the pool of a class, creating it if it doesn't exist yet.
+
+    @param  index
+        The index of the class.
+
+    @return The pool.
+
+    @throws An exception from OAException if the pool can't be created.
+    *//*********************************************************************************/
+    ObjectAllocator& poolOf(unsigned index);
+};
+
+#endif
@@ -0,0 +1,158 @@
+/************************************************************************************//*!
+\file           SlabResource.cpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the SlabMemoryResource class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "SlabResource.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Helper Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/********************************************************************************//*!
+ @brief  Checks if a request can be served from a pool of the slab.
+
+ @param  slab
+    The slab with the pools.
+ @param  bytes
+    The number of bytes requested, rounded up to a multiple of the alignment.
+ @param  alignment
+    The alignment requested.
+
+ @return True if the request fits a class whose blocks are aligned well enough, or
+        is large enough to come from operator new.
+*//*********************************************************************************/
+static bool servedBySlab(const SlabAllocator& slab, size_t bytes, size_t alignment)
+{
+    if (alignment > alignof(std::max_align_t))
+        return false;
+
+    // Every class is aligned to the largest power of two that divides its size
+    const size_t classSize = slab.GetClassSize(bytes);
+    return classSize == 0 || (classSize & (alignment - 1)) == 0;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Creates the SlabMemoryResource and the SlabAllocator it owns.
+
+ @param  config
+    The configuration of every pool, as for the SlabAllocator.
+ @param  MaxSize
+    The biggest request served from a pool. Defaults to 1024.
+ @param  ChunkSize
+    The size and alignment of the memory for each page. Defaults to 64 KiB.
+ @param  Upstream
+    Where over-aligned requests go. Defaults to the default resource.
+
+ @throws An exception if the construction fails.
+*//*********************************************************************************/
+SlabMemoryResource::SlabMemoryResource(const OAConfig& config, size_t MaxSize, size_t ChunkSize, std::pmr::memory_resource* Upstream)
+: slab      (config, MaxSize, ChunkSize)
+, upstream  (Upstream)
+{}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Gets the SlabAllocator the memory comes from.
+
+ @return The SlabAllocator.
+*//*********************************************************************************/
+SlabAllocator& SlabMemoryResource::GetSlab()
+{
+    return slab;
+}
+
+/********************************************************************************//*!
+ @brief  Gets where over-aligned requests go.
+
+ @return The upstream resource.
+*//*********************************************************************************/
+std::pmr::memory_resource* SlabMemoryResource::GetUpstream() const
+{
+    return upstream;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+
+/********************************************************************************//*!
+ @brief  Allocates memory from the pool of the smallest class that fits and is
+         aligned well enough.
+
+ @param  bytes
+    The number of bytes needed.
+ @param  alignment
+    The alignment needed.
+
+ @return Pointer to the allocated memory.
+
+ @throws std::bad_alloc if the memory can't be allocated.
+*//*********************************************************************************/
+void* SlabMemoryResource::do_allocate(size_t bytes, size_t alignment)
+{
+    // A size that is a multiple of the alignment only fits classes that are
+    bytes = (bytes + alignment - 1) & ~(alignment - 1);
+
+    if (!servedBySlab(slab, bytes, alignment))
+        return upstream->allocate(bytes, alignment);
+
+    try
+    {
+        return slab.Allocate(bytes);
+    }
+    catch(const OAException&)
+    {
+        throw std::bad_alloc{};
+    }
+}
+
+/********************************************************************************//*!
+ @brief  Returns memory to where it came from.
+
+ @param  p
+    The memory to free.
+ @param  bytes
+    The number of bytes it was allocated with.
+ @param  alignment
+    The alignment it was allocated with.
+
+ @throws An exception from OAException if the pool finds an invalid free while
+        debugging.
+*//*********************************************************************************/
+void SlabMemoryResource::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+    bytes = (bytes + alignment - 1) & ~(alignment - 1);
+
+    if (!servedBySlab(slab, bytes, alignment))
+        upstream->deallocate(p, bytes, alignment);
+    else
+        slab.Free(p);
+}
+
+/********************************************************************************//*!
+ @brief  Checks if memory from one resource can be freed by another.
+
+ @param  other
+    The other resource.
+
+ @return True only for the same resource, as each has its own pools.
+*//*********************************************************************************/
+bool SlabMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
@@ -0,0 +1,258 @@
+/************************************************************************************//*!
+ \file           SlabResource.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the adapters that let standard containers allocate from a
+                 SlabAllocator: a std::pmr::memory_resource and a typed allocator.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef SLABRESOURCEH
+#define SLABRESOURCEH
+
+// Standard Libraries
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+// Project Headers
+#include "SlabAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  A std::pmr::memory_resource over the size-class pools of a SlabAllocator,
+         for std::pmr containers.
+
+         A request goes to the class whose natural alignment covers the alignment
+         asked for. Alignments above std::max_align_t go to the upstream resource.
+         Pool errors are reported as std::bad_alloc, as containers expect. Like the
+         SlabAllocator, it is not thread-safe.
+*//*************************************************************************************/
+class SlabMemoryResource : public std::pmr::memory_resource
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the SlabMemoryResource and the SlabAllocator it owns.
+
+    @param  config
+        The configuration of every pool, as for the SlabAllocator.
+    @param  MaxSize
+        The biggest request served from a pool. Defaults to 1024.
+    @param  ChunkSize
+        The size and alignment of the memory for each page. Defaults to 64 KiB.
+    @param  Upstream
+        Where over-aligned requests go. Defaults to the default resource.
+
+    @throws An exception if the construction fails.
+    *//*********************************************************************************/
+    SlabMemoryResource(const OAConfig& config = OAConfig{ false, DEFAULT_OBJECTS_PER_PAGE, 0 }, size_t MaxSize = DEFAULT_MAX_SLAB_SIZE,
+                       size_t ChunkSize = DEFAULT_CHUNK_SIZE, std::pmr::memory_resource* Upstream = std::pmr::get_default_resource());
+
+    // Prevent copy construction and assignment
+    SlabMemoryResource(const SlabMemoryResource &smr) = delete;             //!< Do not implement!
+    SlabMemoryResource &operator=(const SlabMemoryResource &smr) = delete;  //!< Do not implement!
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the SlabAllocator the memory comes from.
+
+    @return The SlabAllocator.
+    *//*********************************************************************************/
+    SlabAllocator& GetSlab();
+    /********************************************************************************//*!
+    @brief  Gets where over-aligned requests go.
+
+    @return The upstream resource.
+    *//*********************************************************************************/
+    std::pmr::memory_resource* GetUpstream() const;
+
+protected:
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Allocates memory from the pool of the smallest class that fits and is
+            aligned well enough.
+
+    @param  bytes
+        The number of bytes needed.
+    @param  alignment
+        The alignment needed.
+
+    @return Pointer to the allocated memory.
+
+    @throws std::bad_alloc if the memory can't be allocated.
+    *//*********************************************************************************/
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    /********************************************************************************//*!
+    @brief  Returns memory to where it came from.
+
+    @param  p
+        The memory to free.
+    @param  bytes
+        The number of bytes it was allocated with.
+    @param  alignment
+        The alignment it was allocated with.
+
+    @throws An exception from OAException if the pool finds an invalid free while
+            debugging.
+    *//*********************************************************************************/
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    /********************************************************************************//*!
+    @brief  Checks if memory from one resource can be freed by another.
+
+    @param  other
+        The other resource.
+
+    @return True only for the same resource, as each has its own pools.
+    *//*********************************************************************************/
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    SlabAllocator               slab;       //!< the pools the memory comes from
+    std::pmr::memory_resource   *upstream;  //!< where over-aligned requests go
+};
+
+/************************************************************************************//*!
+ @brief  A typed allocator over a SlabAllocator, for containers that take an allocator
+         type rather than a memory resource. Copies and rebinds share the same
+         SlabAllocator, which must outlive them.
+
+ @tparam T
+    The type of object allocated. Its alignment may not exceed std::max_align_t.
+*//*************************************************************************************/
+template <typename T>
+class SlabStlAllocator
+{
+public:
+    static_assert(alignof(T) <= alignof(std::max_align_t), "SlabStlAllocator can't over-align objects.");
+
+    /*---------------------------------------------------------------------------------*/
+    /* Type  Definitions                                                               */
+    /*---------------------------------------------------------------------------------*/
+    using value_type = T;
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the SlabStlAllocator.
+
+    @param  Slab
+        The SlabAllocator the memory comes from.
+    *//*********************************************************************************/
+    explicit SlabStlAllocator(SlabAllocator& Slab) noexcept
+    : slab (&Slab)
+    {}
+
+    /********************************************************************************//*!
+    @brief  Creates the SlabStlAllocator from one for another type.
+
+    @param  other
+        The allocator to share the SlabAllocator of.
+    *//*********************************************************************************/
+    template <typename U>
+    SlabStlAllocator(const SlabStlAllocator<U>& other) noexcept
+    : slab (&other.GetSlab())
+    {}
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Allocates memory for a number of objects. sizeof(T) is a multiple of
+            alignof(T), so the class that fits is also aligned well enough.
+
+    @param  n
+        The number of objects.
+
+    @return Pointer to the allocated memory.
+
+    @throws std::bad_alloc if the memory can't be allocated.
+    *//*********************************************************************************/
+    T* allocate(size_t n)
+    {
+        if (n > static_cast<size_t>(-1) / sizeof(T))
+            throw std::bad_array_new_length{};
+
+        try
+        {
+            return static_cast<T*>(slab->Allocate(n * sizeof(T)));
+        }
+        catch(const OAException&)
+        {
+            throw std::bad_alloc{};
+        }
+    }
+
+    /********************************************************************************//*!
+    @brief  Frees memory from allocate.
+
+    @param  p
+        The memory to free.
+    @param  n
+        The number of objects it was allocated for.
+
+    @throws An exception from OAException if the pool finds an invalid free while
+            debugging, so it is not noexcept.
+    *//*********************************************************************************/
+    void deallocate(T* p, size_t n)
+    {
+        (void)n;
+        slab->Free(p);
+    }
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the SlabAllocator the memory comes from.
+
+    @return The SlabAllocator.
+    *//*********************************************************************************/
+    SlabAllocator& GetSlab() const noexcept { return *slab; }
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    SlabAllocator   *slab;  //!< the pools the memory comes from
+};
+
+/************************************************************************************//*!
+ @brief  Checks if two allocators can free each other's memory.
+
+ @return True if they share a SlabAllocator.
+*//*************************************************************************************/
+template <typename T, typename U>
+bool operator==(const SlabStlAllocator<T>& lhs, const SlabStlAllocator<U>& rhs) noexcept
+{
+    return &lhs.GetSlab() == &rhs.GetSlab();
+}
+
+/************************************************************************************//*!
+ @brief  Checks if two allocators can't free each other's memory.
+
+ @return True if they use different SlabAllocators.
+*//*************************************************************************************/
+template <typename T, typename U>
+bool operator!=(const SlabStlAllocator<T>& lhs, const SlabStlAllocator<U>& rhs) noexcept
+{
+    return !(lhs == rhs);
+}
+
+#endif
@@ -0,0 +1,264 @@
+/************************************************************************************//*!
+ \file           TypedObjectAllocator.h
+ \author         Diren D Bharwani, diren.dbharwani, 390002520
+ \par            email: diren.dbharwani\@digipen.edu
+ \date           Jan 19, 2022
+ \brief          Contains the interface for the TypedObjectAllocator class, an
+                 ObjectAllocator that is configured at compile time.
+
+ Copyright (C) 2022 DigiPen Institute of Technology.
+ Reproduction or disclosure of this file or its contents without the prior written
+ consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+#ifndef TYPEDOBJECTALLOCATORH
+#define TYPEDOBJECTALLOCATORH
+
+// Standard Libraries
+#include <cstddef>
+#include <vector>
+// Project Headers
+#include "ObjectAllocator.h"
+
+/*-------------------------------------------------------------------------------------*/
+/* Type  Definitions                                                                   */
+/*-------------------------------------------------------------------------------------*/
+
+/************************************************************************************//*!
+ @brief  Compile-time counterpart of OAConfig. The parameters follow the same order as
+         the constructor of OAConfig.
+
+ @tparam ObjectsPerPage
+    Number of objects for each page of memory. Defaults to 4.
+ @tparam MaxPages
+    Maximum number of pages before throwing an exception. 0 means unlimited.
+    Defaults to 3.
+ @tparam DebugOn
+    Enables patterns and checks on Free. Defaults to false.
+ @tparam PadBytes
+    The number of bytes to the left and right of a block to pad with. Defaults to 0.
+ @tparam HeaderType
+    The kind of header blocks in use. External headers are not supported.
+    Defaults to None.
+ @tparam HeaderAdditional
+    The number of user-defined bytes in an extended header. Defaults to 0.
+ @tparam Alignment
+    The number of bytes to align on. Blocks are always aligned for the object type.
+    Defaults to 0.
+*//*************************************************************************************/
+template <unsigned ObjectsPerPage = DEFAULT_OBJECTS_PER_PAGE, unsigned MaxPages = DEFAULT_MAX_PAGES, bool DebugOn = false,
+          unsigned PadBytes = 0, OAConfig::HBLOCK_TYPE HeaderType = OAConfig::hbNone, unsigned HeaderAdditional = 0,
+          unsigned Alignment = 0>
+struct OAStaticConfig
+{
+    /*---------------------------------------------------------------------------------*/
+    /* Static Data Members                                                             */
+    /*---------------------------------------------------------------------------------*/
+    static constexpr unsigned               OBJECTS_PER_PAGE    = ObjectsPerPage;   //!< number of objects on each page
+    static constexpr unsigned               MAX_PAGES           = MaxPages;         //!< maximum number of pages (0=unlimited)
+    static constexpr bool                   DEBUG_ON            = DebugOn;          //!< enable/disable debugging code
+    static constexpr unsigned               PAD_BYTES           = PadBytes;         //!< size of the left/right padding
+    static constexpr OAConfig::HBLOCK_TYPE  HEADER_TYPE         = HeaderType;       //!< which header to use
+    static constexpr unsigned               HEADER_ADDITIONAL   = HeaderAdditional; //!< user-defined bytes in extended headers
+    static constexpr unsigned               ALIGNMENT           = Alignment;        //!< address alignment of each block
+};
+
+/************************************************************************************//*!
+ @brief  An ObjectAllocator for a single type whose configuration is known at compile
+         time. Every size and offset is a constant and disabled features generate no
+         code.
+
+         Blocks are laid out in the same order as in ObjectAllocator (page link,
+         alignment, header, pads, object), but the sizes can differ from an
+         ObjectAllocator with the same OAConfig: blocks are always aligned for T, and
+         alignment bytes are only added where an offset isn't aligned yet, where
+         ObjectAllocator adds a whole Alignment_ to an offset that already is. While
+         debugging without headers, each page keeps a bitmap of its blocks in use
+         after its last block.
+
+ @tparam T
+    The type of the objects.
+ @tparam Config
+    An OAStaticConfig. Defaults to the same defaults as OAConfig.
+*//*************************************************************************************/
+template <typename T, typename Config = OAStaticConfig<>>
+class TypedObjectAllocator
+{
+public:
+    /*---------------------------------------------------------------------------------*/
+    /* Static Data Members                                                             */
+    /*---------------------------------------------------------------------------------*/
+    static constexpr size_t PTR_SIZE            = sizeof(GenericObject*);   //!< size of the link at the front of a page
+    static constexpr size_t OBJECT_SIZE         = sizeof(T) < PTR_SIZE ? PTR_SIZE : sizeof(T);  //!< free blocks must fit a link
+    static constexpr size_t HEADER_SIZE         = Config::HEADER_TYPE == OAConfig::hbBasic    ? OAConfig::BASIC_HEADER_SIZE
+                                                : Config::HEADER_TYPE == OAConfig::hbExtended ? sizeof(unsigned) + sizeof(unsigned short) + sizeof(char) + Config::HEADER_ADDITIONAL
+                                                : 0;    //!< size of the header of a block
+    static constexpr size_t ALIGNMENT           = Config::ALIGNMENT > alignof(T) && Config::ALIGNMENT > alignof(GenericObject) ? Config::ALIGNMENT
+                                                : alignof(T) > alignof(GenericObject) ? alignof(T) : alignof(GenericObject);    //!< actual alignment of each block
+    static constexpr size_t LEADING_SIZE        = HEADER_SIZE + Config::PAD_BYTES; //!< bytes in front of an object within a block
+    static constexpr size_t LEFT_ALIGN_SIZE     = (ALIGNMENT - (PTR_SIZE + LEADING_SIZE) % ALIGNMENT) % ALIGNMENT;  //!< alignment bytes for the first block
+    static constexpr size_t INTER_ALIGN_SIZE    = (ALIGNMENT - (LEADING_SIZE + OBJECT_SIZE + Config::PAD_BYTES) % ALIGNMENT) % ALIGNMENT; //!< alignment bytes between blocks
+    static constexpr size_t BLOCK_SIZE          = LEADING_SIZE + OBJECT_SIZE + Config::PAD_BYTES + INTER_ALIGN_SIZE;   //!< distance between objects
+    static constexpr size_t FIRST_OBJECT_OFFSET = PTR_SIZE + LEFT_ALIGN_SIZE + LEADING_SIZE;    //!< offset of the first object in a page
+    static constexpr size_t PAGE_SIZE           = PTR_SIZE + LEFT_ALIGN_SIZE + Config::OBJECTS_PER_PAGE * BLOCK_SIZE - INTER_ALIGN_SIZE; //!< size of a page
+    static constexpr size_t BITMAP_SIZE         = Config::DEBUG_ON && HEADER_SIZE == 0 ? (Config::OBJECTS_PER_PAGE + 7) / 8 : 0;    //!< bytes after a page marking its blocks in use
+
+    /*---------------------------------------------------------------------------------*/
+    /* Constructors & Destructors                                                      */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates the TypedObjectAllocator and its first page.
+
+    @throws An exception from OAException if the first page can't be created.
+    *//*********************************************************************************/
+    TypedObjectAllocator();
+
+    // Prevent copy construction and assignment
+    TypedObjectAllocator(const TypedObjectAllocator &oa) = delete;              //!< Do not implement!
+    TypedObjectAllocator &operator=(const TypedObjectAllocator &oa) = delete;   //!< Do not implement!
+
+    /********************************************************************************//*!
+    @brief  Destructor for TypedObjectAllocator. Objects still alive are not destroyed.
+
+    @throws Never does.
+    *//*********************************************************************************/
+    ~TypedObjectAllocator();
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Take an object from the free list and give it to the client.
+
+    @return Pointer to the allocated, unconstructed object.
+
+    @throws An exception from OAException if the object can't be allocated.
+    *//*********************************************************************************/
+    void* Allocate();
+
+    /********************************************************************************//*!
+    @brief  Returns an object to the free list for the client. Does not destroy it.
+
+    @param  Object
+        The object to return to the free list.
+
+    @throws An exception from OAException if the object can't be freed. Only checked
+            when debugging.
+    *//*********************************************************************************/
+    void Free(void *Object);
+
+    /********************************************************************************//*!
+    @brief  Allocates an object and constructs it in place.
+
+    @tparam Args
+        The types of the arguments of the constructor.
+    @param  args
+        The arguments to forward to the constructor.
+
+    @return Pointer to the constructed object.
+
+    @throws An exception from OAException if the object can't be allocated, or
+            whatever the constructor throws. Nothing is leaked either way.
+    *//*********************************************************************************/
+    template <typename... Args>
+    T* New(Args&&... args);
+
+    /********************************************************************************//*!
+    @brief  Destroys an object and returns it to the free list.
+
+    @param  Object
+        The object to delete. Does nothing if it is a nullptr.
+
+    @throws An exception from OAException if the object can't be freed.
+    *//*********************************************************************************/
+    void Delete(T *Object);
+
+    /*---------------------------------------------------------------------------------*/
+    /* Getter Functions                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Gets the free list.
+
+    @return A pointer to the free list.
+    *//*********************************************************************************/
+    const void* GetFreeList() const;
+    /********************************************************************************//*!
+    @brief  Gets the page list.
+
+    @return A pointer to the page list.
+    *//*********************************************************************************/
+    const void* GetPageList() const;
+    /********************************************************************************//*!
+    @brief  Gets the statistics of the allocator.
+
+    @return The statistics for the allocator.
+    *//*********************************************************************************/
+    OAStats GetStats() const;
+
+private:
+    /*---------------------------------------------------------------------------------*/
+    /* Data Members                                                                    */
+    /*---------------------------------------------------------------------------------*/
+    GenericObject               *PageList_; //!< the beginning of the list of pages
+    GenericObject               *FreeList_; //!< the beginning of the list of objects
+    OAStats                     stats;      //!< the statistics of the allocator
+    std::vector<unsigned char*> pageIndex;  //!< the pages sorted by address (debugging only)
+
+    /*---------------------------------------------------------------------------------*/
+    /* Function Members                                                                */
+    /*---------------------------------------------------------------------------------*/
+    /********************************************************************************//*!
+    @brief  Creates a new page and puts its blocks on the free list.
+
+    @throws OAException if the page can't be created.
+    *//*********************************************************************************/
+    void createPage();
+    /********************************************************************************//*!
+    @brief  Writes the header of a block. Only used with headers.
+
+    @param  block
+        The object of the block.
+    @param  inUse
+        True when allocating. False when freeing.
+    *//*********************************************************************************/
+    void writeHeader(unsigned char* block, bool inUse);
+    /********************************************************************************//*!
+    @brief  Finds the page a block is in. Runs in O(log pages). Only used when
+            debugging.
+
+    @param  block
+        The block to find the page of.
+
+    @return The page, or a nullptr if the block is on no page.
+    *//*********************************************************************************/
+    unsigned char* findPage(const unsigned char* block) const;
+    /********************************************************************************//*!
+    @brief  Marks a block as in use or free in the bitmap of its page. Only used when
+            debugging without headers.
+
+    @param  page
+        The page the block is in.
+    @param  block
+        The object of the block.
+    @param  inUse
+        True when allocating. False when freeing.
+    *//*********************************************************************************/
+    void setAllocated(unsigned char* page, const unsigned char* block, bool inUse);
+    /********************************************************************************//*!
+    @brief  Checks for an invalid free. Only used when debugging.
+
+    @param  block
+        The object being freed.
+
+    @throws OAException, based on the type of invalid free.
+    *//*********************************************************************************/
+    void checkForInvalidFree(unsigned char* block) const;
+
+    static_assert(Config::HEADER_TYPE != OAConfig::hbExternal, "External headers need labels, use ObjectAllocator instead.");
+    static_assert(Config::OBJECTS_PER_PAGE > 0, "A page must hold at least one object.");
+    static_assert(ALIGNMENT <= alignof(std::max_align_t), "Pages are only aligned to std::max_align_t.");
+};
+
+#include "TypedObjectAllocator.hpp"
+
+#endif
@@ -0,0 +1,372 @@
+/************************************************************************************//*!
+\file           TypedObjectAllocator.hpp
+\author         Diren D Bharwani, diren.dbharwani, 390002520
+\par            email: diren.dbharwani\@digipen.edu
+\date           Jan 19, 2022
+\brief          Contains the implementation of the TypedObjectAllocator class.
+
+Copyright (C) 2022 DigiPen Institute of Technology.
+Reproduction or disclosure of this file or its contents without the prior written
+consent of DigiPen Institute of Technology is prohibited.
+*//*************************************************************************************/
+
+// Primary Header
+#include "TypedObjectAllocator.h"
+// Standard Libraries
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <utility>
+
+/*-------------------------------------------------------------------------------------*/
+/* Constructors & Destructors                                                          */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Creates the TypedObjectAllocator and its first page.
+
+ @throws An exception from OAException if the first page can't be created.
+*//*************************************************************************************/
+template <typename T, typename Config>
+TypedObjectAllocator<T, Config>::TypedObjectAllocator()
+: PageList_ { nullptr }
+, FreeList_ { nullptr }
+, stats     {}
+, pageIndex {}
+{
+    stats.ObjectSize_ = OBJECT_SIZE;
+    stats.PageSize_   = PAGE_SIZE;
+
+    createPage();
+}
+/************************************************************************************//*!
+ @brief  Destructor for TypedObjectAllocator. Objects still alive are not destroyed.
+
+ @throws Never does.
+*//*************************************************************************************/
+template <typename T, typename Config>
+TypedObjectAllocator<T, Config>::~TypedObjectAllocator()
+{
+    while (PageList_)
+    {
+        GenericObject* next = PageList_->Next;
+        delete [] reinterpret_cast<unsigned char*>(PageList_);
+        PageList_ = next;
+    }
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Function Members                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Take an object from the free list and give it to the client.
+
+ @return Pointer to the allocated, unconstructed object.
+
+ @throws An exception from OAException if the object can't be allocated.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void* TypedObjectAllocator<T, Config>::Allocate()
+{
+    if (FreeList_ == nullptr)
+    {
+        createPage();
+    }
+
+    unsigned char* obj = reinterpret_cast<unsigned char*>(FreeList_);
+    FreeList_ = FreeList_->Next;
+
+    ++stats.Allocations_;
+    ++stats.ObjectsInUse_;
+    --stats.FreeObjects_;
+    if (stats.ObjectsInUse_ > stats.MostObjects_)
+        stats.MostObjects_ = stats.ObjectsInUse_;
+
+    // Every condition below is a constant, so disabled features compile away
+    if (Config::DEBUG_ON)
+        memset(obj, ObjectAllocator::ALLOCATED_PATTERN, OBJECT_SIZE);
+    if (HEADER_SIZE)
+        writeHeader(obj, true);
+    else if (BITMAP_SIZE)
+        setAllocated(findPage(obj), obj, true);
+
+    return obj;
+}
+/************************************************************************************//*!
+ @brief  Returns an object to the free list for the client. Does not destroy it.
+
+ @param  Object
+    The object to return to the free list.
+
+ @throws An exception from OAException if the object can't be freed. Only checked
+         when debugging.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::Free(void* Object)
+{
+    unsigned char* block = reinterpret_cast<unsigned char*>(Object);
+
+    if (Config::DEBUG_ON)
+        checkForInvalidFree(block);
+    if (HEADER_SIZE)
+        writeHeader(block, false);
+    else if (BITMAP_SIZE)
+        setAllocated(findPage(block), block, false);
+    if (Config::DEBUG_ON)
+        memset(block + PTR_SIZE, ObjectAllocator::FREED_PATTERN, OBJECT_SIZE - PTR_SIZE);
+
+    GenericObject* obj = reinterpret_cast<GenericObject*>(block);
+    obj->Next = FreeList_;
+    FreeList_ = obj;
+
+    ++stats.Deallocations_;
+    --stats.ObjectsInUse_;
+    ++stats.FreeObjects_;
+}
+/************************************************************************************//*!
+ @brief  Allocates an object and constructs it in place.
+
+ @tparam Args
+    The types of the arguments of the constructor.
+ @param  args
+    The arguments to forward to the constructor.
+
+ @return Pointer to the constructed object.
+
+ @throws An exception from OAException if the object can't be allocated, or
+         whatever the constructor throws. Nothing is leaked either way.
+*//*************************************************************************************/
+template <typename T, typename Config>
+template <typename... Args>
+T* TypedObjectAllocator<T, Config>::New(Args&&... args)
+{
+    void* obj = Allocate();
+    try
+    {
+        return new (obj) T(std::forward<Args>(args)...);
+    }
+    catch(...)
+    {
+        Free(obj);
+        throw;
+    }
+}
+/************************************************************************************//*!
+ @brief  Destroys an object and returns it to the free list.
+
+ @param  Object
+    The object to delete. Does nothing if it is a nullptr.
+
+ @throws An exception from OAException if the object can't be freed.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::Delete(T* Object)
+{
+    if (Object == nullptr)
+        return;
+
+    Object->~T();
+    Free(Object);
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Getter Functions                                                                    */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Gets the free list.
+
+ @return A pointer to the free list.
+*//*************************************************************************************/
+template <typename T, typename Config>
+const void* TypedObjectAllocator<T, Config>::GetFreeList() const
+{
+    return FreeList_;
+}
+/************************************************************************************//*!
+ @brief  Gets the page list.
+
+ @return A pointer to the page list.
+*//*************************************************************************************/
+template <typename T, typename Config>
+const void* TypedObjectAllocator<T, Config>::GetPageList() const
+{
+    return PageList_;
+}
+/************************************************************************************//*!
+ @brief  Gets the statistics of the allocator.
+
+ @return The statistics for the allocator.
+*//*************************************************************************************/
+template <typename T, typename Config>
+OAStats TypedObjectAllocator<T, Config>::GetStats() const
+{
+    return stats;
+}
+
+/*-------------------------------------------------------------------------------------*/
+/* Private Function Members                                                            */
+/*-------------------------------------------------------------------------------------*/
+/************************************************************************************//*!
+ @brief  Creates a new page and puts its blocks on the free list.
+
+ @throws OAException if the page can't be created.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::createPage()
+{
+    if (Config::MAX_PAGES != 0 && stats.PagesInUse_ >= Config::MAX_PAGES)
+        throw OAException {OAException::E_NO_PAGES, "Maximum number of pages have been reached."};
+
+    unsigned char* page = nullptr;
+    try
+    {
+        page = new unsigned char[PAGE_SIZE + BITMAP_SIZE];
+
+        // Kept sorted so the page of a freed block is found by binary search
+        if (Config::DEBUG_ON)
+        {
+            pageIndex.insert(std::upper_bound(pageIndex.begin(), pageIndex.end(), page), page);
+        }
+    }
+    catch(const std::bad_alloc&)
+    {
+        delete [] page;
+        throw OAException {OAException::E_NO_MEMORY, "No system memory available."};
+    }
+
+    if (BITMAP_SIZE)
+        memset(page + PAGE_SIZE, 0, BITMAP_SIZE);
+
+    GenericObject* pageObj = reinterpret_cast<GenericObject*>(page);
+    pageObj->Next = PageList_;
+    PageList_ = pageObj;
+
+    if (Config::DEBUG_ON)
+        memset(page + PTR_SIZE, ObjectAllocator::ALIGN_PATTERN, LEFT_ALIGN_SIZE);
+
+    for (unsigned i = 0; i < Config::OBJECTS_PER_PAGE; ++i)
+    {
+        unsigned char* block = page + FIRST_OBJECT_OFFSET + i * BLOCK_SIZE;
+
+        if (HEADER_SIZE)
+            memset(block - LEADING_SIZE, 0, HEADER_SIZE);
+
+        if (Config::DEBUG_ON)
+        {
+            memset(block - Config::PAD_BYTES, ObjectAllocator::PAD_PATTERN, Config::PAD_BYTES);
+            memset(block, ObjectAllocator::UNALLOCATED_PATTERN, OBJECT_SIZE);
+            memset(block + OBJECT_SIZE, ObjectAllocator::PAD_PATTERN, Config::PAD_BYTES);
+
+            // The last block has no inter-alignment bytes
+            if (i + 1 < Config::OBJECTS_PER_PAGE)
+                memset(block + OBJECT_SIZE + Config::PAD_BYTES, ObjectAllocator::ALIGN_PATTERN, INTER_ALIGN_SIZE);
+        }
+
+        GenericObject* obj = reinterpret_cast<GenericObject*>(block);
+        obj->Next = FreeList_;
+        FreeList_ = obj;
+    }
+
+    ++stats.PagesInUse_;
+    stats.FreeObjects_ += Config::OBJECTS_PER_PAGE;
+}
+/************************************************************************************//*!
+ @brief  Writes the header of a block. Only used with headers.
+
+ @param  block
+    The object of the block.
+ @param  inUse
+    True when allocating. False when freeing.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::writeHeader(unsigned char* block, bool inUse)
+{
+    // Both header types end with [alloc #][flag] right before the padding
+    unsigned char* flag = block - Config::PAD_BYTES - 1;
+    unsigned char* allocNum = flag - sizeof(unsigned);
+
+    *flag = inUse ? 1 : 0;
+
+    const unsigned num = inUse ? stats.Allocations_ : 0;
+    memcpy(allocNum, &num, sizeof(unsigned));
+
+    if (Config::HEADER_TYPE == OAConfig::hbExtended && inUse)
+    {
+        unsigned char* useCount = allocNum - sizeof(unsigned short);
+
+        unsigned short count = 0;
+        memcpy(&count, useCount, sizeof(unsigned short));
+        ++count;
+        memcpy(useCount, &count, sizeof(unsigned short));
+    }
+}
+/************************************************************************************//*!
+ @brief  Checks for an invalid free. Only used when debugging.
+
+ @param  block
+    The object being freed.
+
+ @throws OAException, based on the type of invalid free.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::checkForInvalidFree(unsigned char* block) const
+{
+    const unsigned char* page = findPage(block);
+    if (page == nullptr)
+        throw OAException{OAException::E_BAD_BOUNDARY, "Object address is not within a page."};
+
+    const unsigned char* first = page + FIRST_OBJECT_OFFSET;
+    if (block < first || static_cast<size_t>(block - first) % BLOCK_SIZE != 0)
+        throw OAException{OAException::E_BAD_BOUNDARY, "Object that is trying to be freed is misaligned."};
+
+    // Without a header, the bitmap after the page says if the block is in use
+    const size_t index = static_cast<size_t>(block - first) / BLOCK_SIZE;
+    const bool inUse = HEADER_SIZE ? *(block - Config::PAD_BYTES - 1) != 0
+                                   : ((page[PAGE_SIZE + index / 8] >> (index % 8)) & 1u) != 0;
+    if (!inUse)
+        throw OAException{OAException::E_MULTIPLE_FREE, "Object has already been freed."};
+
+    for (unsigned i = 0; i < Config::PAD_BYTES; ++i)
+    {
+        if (*(block - Config::PAD_BYTES + i) != ObjectAllocator::PAD_PATTERN || *(block + OBJECT_SIZE + i) != ObjectAllocator::PAD_PATTERN)
+            throw OAException{OAException::E_CORRUPTED_BLOCK, "Pad bytes have been overwritten."};
+    }
+}
+/************************************************************************************//*!
+ @brief  Finds the page a block is in. Runs in O(log pages). Only used when debugging.
+
+ @param  block
+    The block to find the page of.
+
+ @return The page, or a nullptr if the block is on no page.
+*//*************************************************************************************/
+template <typename T, typename Config>
+unsigned char* TypedObjectAllocator<T, Config>::findPage(const unsigned char* block) const
+{
+    // Only the last page starting at or before the block can hold it
+    auto next = std::upper_bound(pageIndex.begin(), pageIndex.end(), block);
+    if (next == pageIndex.begin())
+        return nullptr;
+
+    unsigned char* page = *(next - 1);
+    return block < page + PAGE_SIZE ? page : nullptr;
+}
+/************************************************************************************//*!
+ @brief  Marks a block as in use or free in the bitmap of its page. Only used when
+         debugging without headers.
+
+ @param  page
+    The page the block is in.
+ @param  block
+    The object of the block.
+ @param  inUse
+    True when allocating. False when freeing.
+*//*************************************************************************************/
+template <typename T, typename Config>
+void TypedObjectAllocator<T, Config>::setAllocated(unsigned char* page, const unsigned char* block, bool inUse)
+{
+    const size_t index = static_cast<size_t>(block - (page + FIRST_OBJECT_OFFSET)) / BLOCK_SIZE;
+    const unsigned char mask = static_cast<unsigned char>(1u << (index % 8));
+
+    unsigned char& bits = page[PAGE_SIZE + index / 8];
+    bits = static_cast<unsigned char>(inUse ? bits | mask : bits & ~mask);
+}